@@ -13,6 +13,8 @@ namespace AccelDrum.Game.Accel;
 
 public class AccelCollection : IDisposable
 {
+    private const int LinkBaudRate = 1_000_000;
+
     public bool Connected => serial.Connected;
 
     private string[] portNames = [];
@@ -25,15 +27,33 @@ public class AccelCollection : IDisposable
     private List<string> stringsFromAccel = new();
     private string stringsFromAccelFull = "";
     private List<byte> sbFromAccel = new();
+    private LogDictionary logDictionary = LogDictionary.Load("logdict.json");
     private bool showPacketTime = true;
     private bool packetTimePlotHovered = false;
     private bool showAccelSettings = false;
     private bool showPacketBytes = false;
     private bool showLatestAccelPacket = false;
+    private bool showTaskStats = false;
+    private bool showSensorConfig = false;
+    private bool showTelemetry = false;
+    private bool liveTaskStats = false;
+    private TaskStatsPacket[] taskStats = [];
+    private TelemetryPacket? telemetry = null;
+    private LinkStatsPacket? linkStats = null;
 
     private AccelPart[]? accelDevices = null;
-    private Timer2 accelPollTimer = new(750);
+    private StreamSubscriptions subscriptions = new();
+    private Timer2 subscriptionTimer = new(StreamSubscriptions.RenewMillis);
+    private int sensorRateHz = 100;
     private AccelSettings? accelSettings = null;
+    private HelloPacket? deviceHello = null;
+    private bool deviceRefused = false;
+    private ConfigurePacket.SensorConfigs? sensorConfigs = null;
+    private byte streamConfigGeneration = 0;
+    private int editAccelRange = (int)AccelFullScale.A8G;
+    private int editGyroRange = (int)GyroFullScale.G1000DPS;
+    private int editDlpfMode = (int)DlpfMode.Bw256;
+    private int editRateDivider = 0;
 
     public AccelCollection()
     {
@@ -45,12 +65,14 @@ public class AccelCollection : IDisposable
 
         if (Connected)
         {
-            if (accelPollTimer.CheckAndResetIfElapsed())
+            if (subscriptionTimer.CheckAndResetIfElapsed() || subscriptions.Changed)
             {
-                serial.SendPacket(PacketType.Configure, new ConfigurePacket(
-                    ConfigurePacket.Typ.PollForData, ConfigurePacket.Val.None));
+                serial.SendPacket(PacketType.Configure, subscriptions.BuildRenewal());
+                subscriptionTimer.Restart();
             }
             ReceivePackets();
+            if (deviceRefused)
+                Disconnect();
         }
     }
 
@@ -81,6 +103,24 @@ public class AccelCollection : IDisposable
                 case PacketType.Configure:
                     HandlePacketConfigure(native.GetInnerAs<ConfigurePacket>());
                     break;
+                case PacketType.TaskStats:
+                    HandlePacketTaskStats(native.GetInnerAs<TaskStatsPacket>());
+                    break;
+                case PacketType.Log:
+                    HandlePacketLog(native.GetInnerAs<LogPacket>());
+                    break;
+                case PacketType.Hello:
+                    HandlePacketHello(native.GetInnerAs<HelloPacket>());
+                    break;
+                case PacketType.BootProfile:
+                    HandlePacketBootProfile(native.GetInnerAs<BootProfilePacket>());
+                    break;
+                case PacketType.Telemetry:
+                    telemetry = native.GetInnerAs<TelemetryPacket>();
+                    break;
+                case PacketType.LinkStats:
+                    linkStats = native.GetInnerAs<LinkStatsPacket>();
+                    break;
                 default:
                     Log.Warning($"Unknown packet type {native.Type}");
                     break;
@@ -94,16 +134,24 @@ public class AccelCollection : IDisposable
 
     private void HandlePacketRawAccel(RawAccelPacket p)
     {
+        streamConfigGeneration = p.ConfigGeneration;
         int i = 0;
         foreach (RawAccelPacket.Pack packNat in p.Packs)
         {
+            if ((p.SensorMask & (1 << i)) == 0)
+            {
+                i++;
+                continue;
+            }
             var pack = packNat with
             {
                 Accel = ConvertAxesv(packNat.Accel),
                 Gyro = ConvertAxesv(packNat.Gyro),
             };
             dataArrived = true;
-            if (pack.DeltaMicros <= 1_000_000 / 100 * 2)
+            // A longer gap means samples were lost, integrating over it would jump
+            ushort rate = subscriptions.GetGrantedRate((StreamId)((int)StreamId.RawSensor0 + i));
+            if (rate != 0 && pack.DeltaMicros <= 1_000_000 / rate * 2)
             {
                 accelDevices![i].PushData(pack.DeltaMicros / 1_000_000.0f, pack.Accel, pack.Gyro);
             }
@@ -136,21 +184,33 @@ public class AccelCollection : IDisposable
                 {
                     sbFromAccel.AddRange(span);
                     string str = Encoding.UTF8.GetString(sbFromAccel.ToArray()).Replace('\0', ' ');
-                    stringsFromAccel.Add(str);
+                    AddStringFromAccel(str);
                     sbFromAccel.Clear();
                 }
                 else
                 {
-                    string str = Encoding.UTF8.GetString(sbFromAccel.ToArray()).Replace('\0', ' ');
-                    stringsFromAccel.Add(str);
+                    string str = Encoding.UTF8.GetString(span).Replace('\0', ' ');
+                    AddStringFromAccel(str);
                 }
-                if (stringsFromAccel.Count > 5)
-                    stringsFromAccel.RemoveAt(0);
-                stringsFromAccelFull = string.Join("", stringsFromAccel);
             }
         }
     }
 
+    private void HandlePacketLog(LogPacket p)
+    {
+        ReadOnlySpan<byte> records = p.Records;
+        foreach (string line in logDictionary.Render(records[..Math.Min((int)p.Length, records.Length)]))
+            AddStringFromAccel(line);
+    }
+
+    private void AddStringFromAccel(string str)
+    {
+        stringsFromAccel.Add(str);
+        if (stringsFromAccel.Count > 5)
+            stringsFromAccel.RemoveAt(0);
+        stringsFromAccelFull = string.Join("", stringsFromAccel);
+    }
+
     private void HandlePacketConfigure(ConfigurePacket p)
     {
         if (p.Type == ConfigurePacket.Typ.Reset &&
@@ -174,6 +234,54 @@ public class AccelCollection : IDisposable
                 GyroFactoryTrims = a2,
             };
         }
+        else if (p.Type == ConfigurePacket.Typ.Subscribe &&
+            p.Value == ConfigurePacket.Val.SubscribeResult)
+        {
+            subscriptions.HandleResult(p.GetDataAs<ConfigurePacket.Subscriptions>());
+        }
+        else if (p.Type == ConfigurePacket.Typ.SensorConfig)
+        {
+            if (p.Value == ConfigurePacket.Val.SensorConfigResult)
+                sensorConfigs = p.GetDataAs<ConfigurePacket.SensorConfigs>();
+            else if (p.Value == ConfigurePacket.Val.SensorConfigRejected)
+                Log.Warning("Sensor config was rejected by the device");
+        }
+    }
+
+    private void HandlePacketTaskStats(TaskStatsPacket p)
+    {
+        if (taskStats.Length != p.Count)
+            taskStats = new TaskStatsPacket[p.Count];
+        if (p.Index < taskStats.Length)
+            taskStats[p.Index] = p;
+    }
+
+    private void HandlePacketHello(HelloPacket p)
+    {
+        string version = $"{p.FirmwareVersion >> 16}.{p.FirmwareVersion & 0xFFFF}";
+        if (p.LayoutHash != PacketLayout.Hash || !p.Accepted)
+        {
+            // Every packet after this would be read as garbage
+            Log.Error($"Device firmware {version} has packet layout {p.LayoutHash:x8}, ours is {PacketLayout.Hash:x8}, disconnecting");
+            deviceRefused = true;
+            return;
+        }
+        deviceHello = p;
+        Log.Information($"Device firmware {version} at {p.BaudRate:n0} baud, " +
+            $"shared capabilities: {p.Capabilities & HelloPacket.HostCapabilities}");
+    }
+
+    private void HandlePacketBootProfile(BootProfilePacket p)
+    {
+        ReadOnlySpan<BootProfilePacket.Phase> phases = p.Phases;
+        foreach (BootProfilePacket.Phase phase in phases[..Math.Min((int)p.Count, phases.Length)])
+        {
+            if (phase.EndMicros == 0)
+                Log.Information($"Boot {phase.Id} on core {phase.Core}: {phase.StartMicros / 1000.0:n1} ms, not ended");
+            else
+                Log.Information($"Boot {phase.Id} on core {phase.Core}: {phase.StartMicros / 1000.0:n1} - {phase.EndMicros / 1000.0:n1} ms, " +
+                    $"took {(phase.EndMicros - phase.StartMicros) / 1000.0:n1} ms");
+        }
     }
 
     public void Draw()
@@ -192,13 +300,26 @@ public class AccelCollection : IDisposable
         using (new Timer2(
             time => Log.Information($"Connection took {time.TotalMicroseconds:n0} us")))
         {
-            serial.Connect(name, 1_000_000);
+            serial.Connect(name, LinkBaudRate);
         }
         packetTimeHistory.Clear();
         packetTimer.Restart();
 
+        // Answered with the device's hello, a device with other packet layouts is dropped right away
+        serial.SendPacket(PacketType.Hello, new HelloPacket
+        {
+            LayoutHash = PacketLayout.Hash,
+            Capabilities = HelloPacket.HostCapabilities,
+            BaudRate = LinkBaudRate,
+        });
         serial.SendPacket(PacketType.Configure, new ConfigurePacket(
             ConfigurePacket.Typ.Reset, ConfigurePacket.Val.None)); // Retrieve the settings at start
+        serial.SendPacket(PacketType.Configure, new ConfigurePacket(
+            ConfigurePacket.Typ.BootProfile, ConfigurePacket.Val.BootProfileGet)); // The boot may have finished before connecting
+        serial.SendPacket(PacketType.Configure, new ConfigurePacket(
+            ConfigurePacket.Typ.SensorConfig, ConfigurePacket.Val.SensorConfigGet));
+        subscriptions.Reset();
+        WantSensors();
 
         accelDevices = new[]
         {
@@ -221,6 +342,11 @@ public class AccelCollection : IDisposable
             dev.Dispose(); // Dispose OpenGL buffers in the main thread
         accelDevices = null;
         accelSettings = null;
+        sensorConfigs = null;
+        deviceHello = null;
+        telemetry = null;
+        linkStats = null;
+        deviceRefused = false;
         dataArrived = false;
     }
 
@@ -293,7 +419,16 @@ public class AccelCollection : IDisposable
                 ImGui.EndTable();
             }
 
+            if (deviceHello is HelloPacket hello)
+            {
+                ImGui.Text($"firmware {hello.FirmwareVersion >> 16}.{hello.FirmwareVersion & 0xFFFF} " +
+                    $"layout {hello.LayoutHash:x8} capabilities: {hello.Capabilities & HelloPacket.HostCapabilities}");
+            }
             ImGui.Text($"corrupted count: {serial.CorruptedPacketCount}");
+            ImGui.Text($"lost: {serial.LostPacketCount} late: {serial.LatePacketCount} " +
+                $"duplicate: {serial.DuplicatePacketCount}");
+            ImGui.Text($"retransmits: {serial.RetransmitCount} dropped reliable: {serial.ReliableDropCount} " +
+                $"awaiting ack: {serial.PendingReliableCount}");
 
             if (Connected && dataArrived)
             {
@@ -352,6 +487,49 @@ public class AccelCollection : IDisposable
                     ImGui.Unindent();
                 }
 
+                if (ImGui.SliderInt("sensor rate", ref sensorRateHz, 1, 1000))
+                    WantSensors();
+                ImGui.SameLine();
+                ImGui.Text($"granted: {subscriptions.GetGrantedRate(StreamId.RawSensor0)} Hz");
+
+                ImGui.Checkbox("sensor config", ref showSensorConfig);
+                if (showSensorConfig)
+                {
+                    ImGui.Indent();
+                    SensorConfigGui();
+                    ImGui.Unindent();
+                }
+
+                ImGui.Checkbox("task stats", ref showTaskStats);
+                if (showTaskStats)
+                {
+                    ImGui.SameLine();
+                    if (ImGui.Button("refresh##taskStats"))
+                    {
+                        serial.SendPacket(PacketType.Configure, new ConfigurePacket(
+                            ConfigurePacket.Typ.TaskStats, ConfigurePacket.Val.TaskStatsGet));
+                    }
+                    ImGui.SameLine();
+                    if (ImGui.Button("reset##taskStats"))
+                    {
+                        serial.SendPacket(PacketType.Configure, new ConfigurePacket(
+                            ConfigurePacket.Typ.TaskStats, ConfigurePacket.Val.TaskStatsReset));
+                    }
+                    ImGui.SameLine();
+                    if (ImGui.Checkbox("live##taskStats", ref liveTaskStats))
+                        subscriptions.Want("taskStats", StreamId.TaskStats, (ushort)(liveTaskStats ? 2 : 0));
+                    TaskStatsTable();
+                }
+
+                if (ImGui.Checkbox("telemetry", ref showTelemetry))
+                    subscriptions.Want("telemetry", StreamId.Telemetry, (ushort)(showTelemetry ? 1 : 0));
+                if (showTelemetry)
+                {
+                    ImGui.Indent();
+                    TelemetryGui();
+                    ImGui.Unindent();
+                }
+
                 ImGui.Checkbox("packet delay", ref showPacketTime);
                 if (showPacketTime)
                 {
@@ -453,6 +631,166 @@ public class AccelCollection : IDisposable
         }
     }
 
+    private void WantSensors()
+    {
+        for (StreamId stream = StreamId.RawSensor0; stream <= StreamId.RawSensor3; stream++)
+            subscriptions.Want("view", stream, (ushort)sensorRateHz);
+    }
+
+    private void SensorConfigGui()
+    {
+        ImGui.Combo("accel range", ref editAccelRange, Enum.GetNames<AccelFullScale>(), 4);
+        ImGui.Combo("gyro range", ref editGyroRange, Enum.GetNames<GyroFullScale>(), 4);
+        ImGui.Combo("low-pass filter", ref editDlpfMode, Enum.GetNames<DlpfMode>(), 7);
+        ImGui.SliderInt("rate divider", ref editRateDivider, 0, 255);
+        if (ImGui.Button("apply to all"))
+        {
+            var packet = new ConfigurePacket(ConfigurePacket.Typ.SensorConfig, ConfigurePacket.Val.SensorConfigSet);
+            ref var configs = ref packet.GetDataAs<ConfigurePacket.SensorConfigs>();
+            configs.SensorMask = 0b1111;
+            for (int i = 0; i < 4; i++)
+            {
+                configs.Sensors[i] = new()
+                {
+                    AccelRange = (AccelFullScale)editAccelRange,
+                    GyroRange = (GyroFullScale)editGyroRange,
+                    DlpfMode = (DlpfMode)editDlpfMode,
+                    RateDivider = (byte)editRateDivider,
+                };
+            }
+            serial.SendPacket(PacketType.Configure, packet);
+        }
+
+        if (sensorConfigs is not ConfigurePacket.SensorConfigs applied)
+            return;
+        // The stream catches up with the result once the device sampled with the new config
+        ImGui.Text($"applied generation: {applied.Generation} stream generation: {streamConfigGeneration}");
+        if (!ImGui.BeginTable("tableSensorConfig", 5, ImGuiTableFlags.Borders | ImGuiTableFlags.RowBg))
+            return;
+        ImGui.TableSetupColumn("sensor");
+        ImGui.TableSetupColumn("accel");
+        ImGui.TableSetupColumn("gyro");
+        ImGui.TableSetupColumn("filter");
+        ImGui.TableSetupColumn("divider");
+        ImGui.TableHeadersRow();
+        for (int i = 0; i < 4; i++)
+        {
+            ConfigurePacket.SensorConfig config = applied.Sensors[i];
+            ImGui.TableNextColumn();
+            ImGui.Text($"{i + 1}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{config.AccelRange}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{config.GyroRange}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{config.DlpfMode}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{config.RateDivider}");
+        }
+        ImGui.EndTable();
+    }
+
+    private void TelemetryGui()
+    {
+        if (telemetry is not TelemetryPacket t)
+        {
+            ImGui.Text("waiting for the device");
+            return;
+        }
+        ImGui.Text($"uptime: {TimeSpan.FromMilliseconds(t.UptimeMillis):d\\.hh\\:mm\\:ss}");
+        ImGui.Text($"core 0 busy: {t.CoreBusyPermille[0] / 10f:n1}%, core 1 busy: {t.CoreBusyPermille[1] / 10f:n1}%");
+        ImGui.Text($"heap free: {t.FreeHeap:n0} B, min: {t.MinFreeHeap:n0} B, largest block: {t.LargestFreeBlock:n0} B");
+        ImGui.Text($"sample sets: {t.SampleSetsMilliHz / 1000f:n1} Hz");
+        ImGui.Text($"lcd: {t.LcdFrames:n0} frames, last {t.LcdLastFrameBytes:n0} B, avg {t.LcdAvgFrameBytes:n0} B, max {t.LcdMaxFrameBytes:n0} B");
+        ReadOnlySpan<TelemetryPacket.Task> tasks = t.Tasks;
+        foreach (TelemetryPacket.Task task in tasks[..Math.Min((int)t.TaskCount, tasks.Length)])
+            ImGui.Text($"{task.GetName()}: {task.StackFreeMinBytes:n0} B stack never used");
+        if (linkStats is not LinkStatsPacket l)
+            return;
+        ImGui.Text($"rx: {l.RxBytes:n0} B, {l.RxPackets:n0} packets, {l.RxCorrupt:n0} corrupt, {l.RxLost:n0} lost, {l.RxOverflow:n0} overflowed");
+        ImGui.Text($"rx dispatch: {l.RxUnknown:n0} unknown types, {l.RxUnregistered:n0} without a handler");
+        ImGui.Text($"rx budget: read cut short {l.RxBudgetExhausted:n0} times, handling cut short {l.DrainBudgetExhausted:n0} times");
+        ImGui.Text($"rx queue: {l.InboundHighWaterMark:n0} waiting at most, {l.MaxDrainBatch:n0} handled at once at most");
+        ImGui.Text($"tx: {l.TxBytes:n0} B, {l.ReliableDropped:n0} reliable dropped, {l.Retransmits:n0} retransmits");
+        if (!ImGui.BeginTable("tableTxClasses", 5, ImGuiTableFlags.Borders | ImGuiTableFlags.RowBg))
+            return;
+        ImGui.TableSetupColumn("class");
+        ImGui.TableSetupColumn("sent");
+        ImGui.TableSetupColumn("dropped");
+        ImGui.TableSetupColumn("avg wait (us)");
+        ImGui.TableSetupColumn("max wait (us)");
+        ImGui.TableHeadersRow();
+        for (int i = 0; i < LinkStatsPacket.TxClassCount; i++)
+        {
+            LinkStatsPacket.TxClassStats stats = l.TxClasses[i];
+            ImGui.TableNextColumn();
+            ImGui.Text(LinkStatsPacket.TxClassNames[i]);
+            ImGui.TableNextColumn();
+            ImGui.Text($"{stats.Sent:n0}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{stats.Dropped:n0}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{stats.AvgWaitMicros:n0}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{stats.MaxWaitMicros:n0}");
+        }
+        ImGui.EndTable();
+    }
+
+    private void TaskStatsTable()
+    {
+        // Every packet carries its core's load, show it once per core
+        int shownCores = 0;
+        foreach (TaskStatsPacket stats in taskStats)
+        {
+            if ((shownCores & (1 << stats.Core)) != 0)
+                continue;
+            shownCores |= 1 << stats.Core;
+            ImGui.Text($"core {stats.Core}: busy {stats.CoreBusyPermille / 10f:n1}% idle {stats.CoreIdlePermille / 10f:n1}%");
+        }
+        if (!ImGui.BeginTable("tableTaskStats", 10, ImGuiTableFlags.Borders | ImGuiTableFlags.RowBg))
+            return;
+        ImGui.TableSetupColumn("task");
+        ImGui.TableSetupColumn("core");
+        ImGui.TableSetupColumn("runs");
+        ImGui.TableSetupColumn("min us");
+        ImGui.TableSetupColumn("avg us");
+        ImGui.TableSetupColumn("max us");
+        ImGui.TableSetupColumn("avg jitter us");
+        ImGui.TableSetupColumn("max jitter us");
+        ImGui.TableSetupColumn("overruns");
+        ImGui.TableSetupColumn("run time histogram");
+        ImGui.TableHeadersRow();
+        foreach (TaskStatsPacket stats in taskStats)
+        {
+            ImGui.TableNextColumn();
+            ImGui.Text(stats.GetName());
+            ImGui.TableNextColumn();
+            ImGui.Text(stats.Core.ToString());
+            ImGui.TableNextColumn();
+            ImGui.Text($"{stats.RunCount:n0}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{stats.MinRunMicros:n0}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{stats.AvgRunMicros:n0}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{stats.MaxRunMicros:n0}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{stats.AvgJitterMicros:n0}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{stats.MaxJitterMicros:n0}");
+            ImGui.TableNextColumn();
+            ImGui.Text($"{stats.OverrunCount:n0}");
+            ImGui.TableNextColumn();
+            float[] buckets = new float[TaskStatsPacket.HistogramBuckets];
+            for (int i = 0; i < buckets.Length; i++)
+                buckets[i] = stats.RunHistogram[i];
+            ImGui.PlotHistogram($"##runHistogram{stats.Index}", ref buckets[0], buckets.Length, 0, null,
+                0, float.MaxValue, new(-1, 20));
+        }
+        ImGui.EndTable();
+    }
+
     ~AccelCollection()
     {
         Dispose();
@@ -1,21 +1,63 @@
 ﻿using AccelDrum.Game.Serial;
 using OpenTK.Mathematics;
+using System;
 using System.Diagnostics;
 using System.Runtime.CompilerServices;
 using System.Runtime.InteropServices;
+using System.Text;
 
 namespace AccelDrum.Game.Accel;
 
-public enum PacketType
+public enum PacketType : byte
 {
     None,
     Accel,
     RawAccel,
     Text,
     Configure,
+    Ack,
+    TaskStats,
+    Log,
+    BootProfile,
+    Hello,
+    Telemetry,
+    LinkStats,
     Count
 }
 
+/// <summary>
+/// Streams the host subscribes to, each is sent at its own rate while its lease is renewed
+/// </summary>
+public enum StreamId : byte
+{
+    /// <summary>
+    /// Packs of sensor 0 in RawAccel packets
+    /// </summary>
+    RawSensor0,
+    RawSensor1,
+    RawSensor2,
+    RawSensor3,
+    /// <summary>
+    /// A TaskStats dump
+    /// </summary>
+    TaskStats,
+    Telemetry,
+    Count
+}
+
+public static class PacketTypeExtensions
+{
+    /// <summary>
+    /// Reliable streams are acked by the receiver and retransmitted by the sender,
+    /// the rest are best-effort and only have their losses counted
+    /// </summary>
+    public static bool IsReliableStream(this PacketType type)
+    {
+        return type == PacketType.Text || type == PacketType.Configure || type == PacketType.Log ||
+            type == PacketType.BootProfile || type == PacketType.Hello;
+    }
+}
+
 [StructLayout(LayoutKind.Sequential, Pack = 1)]
 public struct AccelPacket
 {
@@ -39,12 +81,25 @@ public struct RawAccelPacket
         public Vector3 Gyro;
     }
     public PackArray Packs;
+    /// <summary>
+    /// Packs read in this set, bit i for Packs[i], the others are zeroed
+    /// </summary>
+    public byte SensorMask;
+    /// <summary>
+    /// Scale the packs were converted with, changes together with the SensorConfigResult of the same generation
+    /// </summary>
+    public byte ConfigGeneration;
+    public RangeArray AccelRanges;
+    public RangeArray GyroRanges;
     private Padding padding;
 
     [InlineArray(4)]
     public struct PackArray { private Pack element0; }
 
-    [InlineArray(16)]
+    [InlineArray(4)]
+    public struct RangeArray { private byte element0; }
+
+    [InlineArray(16 - sizeof(byte) * 2 - sizeof(byte) * 4 * 2)]
     private struct Padding { private byte element0; }
 }
 
@@ -59,15 +114,51 @@ public struct TextPacket
     public struct TextPacketStr { private byte element0; }
 }
 
+/// <summary>
+/// Deferred log records packed back to back, rendered by <see cref="LogDictionary"/>
+/// </summary>
+[StructLayout(LayoutKind.Sequential, Pack = 1)]
+public struct LogPacket
+{
+    /// <summary>
+    /// Bytes of records used
+    /// </summary>
+    public byte Length;
+    public RecordBytes Records;
+
+    [InlineArray(SerialPacket.SizeInner - sizeof(byte))]
+    public struct RecordBytes { private byte element0; }
+}
+
+[StructLayout(LayoutKind.Sequential, Pack = 1)]
+public struct AckPacket
+{
+    public PacketType Type;
+    public ushort Seq;
+    private Padding padding;
+
+    public AckPacket(PacketType type, ushort seq)
+    {
+        Type = type;
+        Seq = seq;
+    }
+
+    [InlineArray(SerialPacket.SizeInner - sizeof(PacketType) - sizeof(ushort))]
+    private struct Padding { private byte element0; }
+}
+
 [StructLayout(LayoutKind.Sequential, Pack = 1)]
 public struct ConfigurePacket
 {
     public enum Typ
     {
         None,
-        PollForData,
+        Subscribe,
         Backlight,
         Reset,
+        TaskStats,
+        BootProfile,
+        SensorConfig,
         Count
     }
     public enum Val
@@ -82,6 +173,29 @@ public struct ConfigurePacket
         BacklightSetToggle,
         ResetAck,
         ResetResultSettings,
+        TaskStatsGet,
+        TaskStatsReset,
+        TaskStatsAck,
+        BootProfileGet,
+        /// <summary>
+        /// Replied with a SensorConfigResult
+        /// </summary>
+        SensorConfigGet,
+        /// <summary>
+        /// SensorConfigs in data, replied with a SensorConfigResult once applied
+        /// </summary>
+        SensorConfigSet,
+        SensorConfigResult,
+        /// <summary>
+        /// A value in the set was out of range, nothing was changed
+        /// </summary>
+        SensorConfigRejected,
+        /// <summary>
+        /// Subscriptions in data, replied with a SubscribeResult of the granted rates
+        /// </summary>
+        SubscribeSet,
+        SubscribeResult,
+        Count
     }
     [StructLayout(LayoutKind.Sequential, Pack = 1)]
     public struct Settings
@@ -94,6 +208,57 @@ public struct ConfigurePacket
         [InlineArray(12)]
         public struct ByteArray { private byte element0; }
     };
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public struct Subscription
+    {
+        public StreamId Stream;
+        /// <summary>
+        /// 0 unsubscribes, capped to the max rate of the stream
+        /// </summary>
+        public ushort RateHz;
+        /// <summary>
+        /// Dropped unless subscribed again within this
+        /// </summary>
+        public ushort LeaseMillis;
+    }
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public struct Subscriptions
+    {
+        public const int MaxCount = 8;
+
+        public byte Count;
+        public SubscriptionArray Entries;
+
+        [InlineArray(MaxCount)]
+        public struct SubscriptionArray { private Subscription element0; }
+    }
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public struct SensorConfig
+    {
+        public AccelFullScale AccelRange;
+        public GyroFullScale GyroRange;
+        public DlpfMode DlpfMode;
+        /// <summary>
+        /// Output rate is 1 kHz (8 kHz without the filter) / (1 + RateDivider)
+        /// </summary>
+        public byte RateDivider;
+    }
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public struct SensorConfigs
+    {
+        /// <summary>
+        /// Bit i for sensor i, the sensors a set applies to
+        /// </summary>
+        public byte SensorMask;
+        /// <summary>
+        /// Of the configs in a result, see <see cref="RawAccelPacket.ConfigGeneration"/>
+        /// </summary>
+        public byte Generation;
+        public SensorConfigArray Sensors;
+
+        [InlineArray(4)]
+        public struct SensorConfigArray { private SensorConfig element0; }
+    }
 
     public Typ Type;
     public Val Value;
@@ -116,3 +281,326 @@ public struct ConfigurePacket
     [InlineArray(SerialPacket.SizeInner - sizeof(Typ) - sizeof(Val))]
     public struct ExtraData { private byte element0; }
 }
+
+/// <summary>
+/// Scheduler statistics of one task, a dump sends one per task
+/// </summary>
+[StructLayout(LayoutKind.Sequential, Pack = 1)]
+public struct TaskStatsPacket
+{
+    public const int SizeName = 16;
+    public const int HistogramBuckets = 16;
+
+    public byte Index;
+    /// <summary>
+    /// Packets in this dump
+    /// </summary>
+    public byte Count;
+    /// <summary>
+    /// Core of the scheduler running the task
+    /// </summary>
+    public byte Core;
+    /// <summary>
+    /// Time that scheduler spent running tasks over the last second
+    /// </summary>
+    public ushort CoreBusyPermille;
+    /// <summary>
+    /// Time it spent blocked waiting for the next task
+    /// </summary>
+    public ushort CoreIdlePermille;
+    public NameStr Name;
+    public uint RunCount;
+    public uint MinRunMicros;
+    public uint AvgRunMicros;
+    public uint MaxRunMicros;
+    /// <summary>
+    /// Actual start minus scheduled start
+    /// </summary>
+    public uint AvgJitterMicros;
+    public uint MaxJitterMicros;
+    public uint OverrunCount;
+    /// <summary>
+    /// Bucket i counts values in [2^(i - 1), 2^i) micros, the last one also counts everything above
+    /// </summary>
+    public Histogram RunHistogram;
+    public Histogram JitterHistogram;
+    private Padding padding;
+
+    public readonly string GetName()
+    {
+        ReadOnlySpan<byte> span = Name;
+        int length = span.IndexOf((byte)0);
+        return Encoding.UTF8.GetString(length < 0 ? span : span[..length]);
+    }
+
+    [InlineArray(SizeName)]
+    public struct NameStr { private byte element0; }
+
+    [InlineArray(HistogramBuckets)]
+    public struct Histogram { private ushort element0; }
+
+    [InlineArray(SerialPacket.SizeInner - sizeof(byte) * 3 - sizeof(ushort) * 2 - SizeName - sizeof(uint) * 7 - sizeof(ushort) * HistogramBuckets * 2)]
+    private struct Padding { private byte element0; }
+}
+
+public enum BootPhase : byte
+{
+    /// <summary>
+    /// From setup() until sampling starts
+    /// </summary>
+    Boot,
+    Setup,
+    Serial,
+    Lcd,
+    SensorsWire,
+    SensorsWire1,
+    CalibrateWire,
+    CalibrateWire1,
+    Pins,
+    Count
+}
+
+/// <summary>
+/// Start and end of every boot phase, sent once boot is done or on request,
+/// the lcd and the two sensor buses are brought up in parallel so phases overlap
+/// </summary>
+[StructLayout(LayoutKind.Sequential, Pack = 1)]
+public struct BootProfilePacket
+{
+    public const int MaxPhases = 12;
+
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public struct Phase
+    {
+        public BootPhase Id;
+        public byte Core;
+        public uint StartMicros;
+        /// <summary>
+        /// 0 if the phase hasn't ended yet
+        /// </summary>
+        public uint EndMicros;
+    }
+
+    public byte Count;
+    public PhaseArray Phases;
+    private Padding padding;
+
+    [InlineArray(MaxPhases)]
+    public struct PhaseArray { private Phase element0; }
+
+    [InlineArray(SerialPacket.SizeInner - sizeof(byte) - (sizeof(byte) * 2 + sizeof(uint) * 2) * MaxPhases)]
+    private struct Padding { private byte element0; }
+}
+
+/// <summary>
+/// Exchanged on connect, the host sends its own and the device replies with its own,
+/// a peer built with different packet layouts is refused, so this layout and the Hello type must never change
+/// </summary>
+[StructLayout(LayoutKind.Sequential, Pack = 1)]
+public struct HelloPacket
+{
+    [Flags]
+    public enum Capability : uint
+    {
+        None = 0,
+        /// <summary>
+        /// Acks and retransmits of the <see cref="PacketTypeExtensions.IsReliableStream"/> types
+        /// </summary>
+        ReliableStreams = 1 << 0,
+        /// <summary>
+        /// Log packets rendered from logdict.json
+        /// </summary>
+        DeferredLog = 1 << 1,
+        Subscriptions = 1 << 2,
+        SensorConfig = 1 << 3,
+        BootProfile = 1 << 4,
+        Telemetry = 1 << 5,
+    }
+
+    /// <summary>
+    /// Everything this host understands
+    /// </summary>
+    public const Capability HostCapabilities = Capability.ReliableStreams | Capability.DeferredLog |
+        Capability.Subscriptions | Capability.SensorConfig | Capability.BootProfile |
+        Capability.Telemetry;
+
+    /// <summary>
+    /// major &lt;&lt; 16 | minor, 0 from the host
+    /// </summary>
+    public uint FirmwareVersion;
+    /// <summary>
+    /// See <see cref="PacketLayout"/>
+    /// </summary>
+    public uint LayoutHash;
+    /// <summary>
+    /// Capabilities of the sender
+    /// </summary>
+    public Capability Capabilities;
+    /// <summary>
+    /// Of the link
+    /// </summary>
+    public uint BaudRate;
+    /// <summary>
+    /// In the device's reply, false if the host's LayoutHash differs
+    /// </summary>
+    public bool Accepted;
+    private Padding padding;
+
+    [InlineArray(SerialPacket.SizeInner - sizeof(uint) * 4 - sizeof(bool))]
+    private struct Padding { private byte element0; }
+}
+
+/// <summary>
+/// Health of the device, streamed at a low rate so degradation shows up over long sessions,
+/// rates and loads are over the time since the previous packet, followed by a <see cref="LinkStatsPacket"/>
+/// </summary>
+[StructLayout(LayoutKind.Sequential, Pack = 1)]
+public struct TelemetryPacket
+{
+    public const int MaxTasks = 5;
+
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public struct Task
+    {
+        public const int SizeName = 12;
+
+        public NameStr Name;
+        /// <summary>
+        /// High-water mark, the least stack left since the task started
+        /// </summary>
+        public ushort StackFreeMinBytes;
+
+        public readonly string GetName()
+        {
+            ReadOnlySpan<byte> span = Name;
+            int length = span.IndexOf((byte)0);
+            return Encoding.UTF8.GetString(length < 0 ? span : span[..length]);
+        }
+
+        [InlineArray(SizeName)]
+        public struct NameStr { private byte element0; }
+    }
+
+    public uint UptimeMillis;
+    /// <summary>
+    /// Per core, of the scheduler running there
+    /// </summary>
+    public CoreArray CoreBusyPermille;
+    public uint FreeHeap;
+    /// <summary>
+    /// Least free heap since boot
+    /// </summary>
+    public uint MinFreeHeap;
+    public uint LargestFreeBlock;
+    /// <summary>
+    /// RawAccel packets actually sent per 1000 seconds
+    /// </summary>
+    public uint SampleSetsMilliHz;
+    /// <summary>
+    /// Frames sent to the lcd since boot
+    /// </summary>
+    public uint LcdFrames;
+    /// <summary>
+    /// Bytes written over i2c for the last frame
+    /// </summary>
+    public uint LcdLastFrameBytes;
+    public uint LcdMaxFrameBytes;
+    public uint LcdAvgFrameBytes;
+    public byte TaskCount;
+    public TaskArray Tasks;
+    private Padding padding;
+
+    [InlineArray(2)]
+    public struct CoreArray { private ushort element0; }
+
+    [InlineArray(MaxTasks)]
+    public struct TaskArray { private Task element0; }
+
+    [InlineArray(SerialPacket.SizeInner - sizeof(uint) * 9 - sizeof(ushort) * 2 - sizeof(byte) - (Task.SizeName + sizeof(ushort)) * MaxTasks)]
+    private struct Padding { private byte element0; }
+}
+
+/// <summary>
+/// Counters of the serial link since boot, sent on the telemetry stream right after each <see cref="TelemetryPacket"/>
+/// </summary>
+[StructLayout(LayoutKind.Sequential, Pack = 1)]
+public struct LinkStatsPacket
+{
+    public const int TxClassCount = 4;
+
+    /// <summary>
+    /// Of a tx class of the device, in <see cref="TxClassNames"/> order
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential, Pack = 1)]
+    public struct TxClassStats
+    {
+        public uint Sent;
+        /// <summary>
+        /// Tx queue full
+        /// </summary>
+        public uint Dropped;
+        /// <summary>
+        /// From enqueue to the uart
+        /// </summary>
+        public uint AvgWaitMicros;
+        public uint MaxWaitMicros;
+    }
+
+    /// <summary>
+    /// Nothing detects hits on the device yet, so Realtime stays empty
+    /// </summary>
+    public static readonly string[] TxClassNames = ["realtime", "sensor", "control", "bulk"];
+
+    public uint RxBytes;
+    public uint RxPackets;
+    public uint RxCorrupt;
+    /// <summary>
+    /// Skipped over by sequence gaps
+    /// </summary>
+    public uint RxLost;
+    /// <summary>
+    /// Dropped because the inbound queue was full, a reliable one is sent again by the host
+    /// </summary>
+    public uint RxOverflow;
+    /// <summary>
+    /// None or a type outside of <see cref="PacketType"/> when dispatched
+    /// </summary>
+    public uint RxUnknown;
+    /// <summary>
+    /// Valid type without a handler on the device
+    /// </summary>
+    public uint RxUnregistered;
+    /// <summary>
+    /// Times reading stopped with bytes still in the uart
+    /// </summary>
+    public uint RxBudgetExhausted;
+    /// <summary>
+    /// Times handling stopped with packets still queued
+    /// </summary>
+    public uint DrainBudgetExhausted;
+    /// <summary>
+    /// Most packets handled in one go
+    /// </summary>
+    public uint MaxDrainBatch;
+    /// <summary>
+    /// Most packets waiting in the inbound queue
+    /// </summary>
+    public uint InboundHighWaterMark;
+    /// <summary>
+    /// Written to the uart, including the packets that bypass the tx scheduler
+    /// </summary>
+    public uint TxBytes;
+    /// <summary>
+    /// Given up on after the retransmits or refused by a full window
+    /// </summary>
+    public uint ReliableDropped;
+    public uint Retransmits;
+    public TxClassArray TxClasses;
+    private Padding padding;
+
+    [InlineArray(TxClassCount)]
+    public struct TxClassArray { private TxClassStats element0; }
+
+    [InlineArray(SerialPacket.SizeInner - sizeof(uint) * 14 - sizeof(uint) * 4 * TxClassCount)]
+    private struct Padding { private byte element0; }
+}
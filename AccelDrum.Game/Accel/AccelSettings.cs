@@ -10,7 +10,7 @@ public class AccelSettings
     public required Vector3i[] GyroFactoryTrims { get; set; }
 }
 
-public enum AccelFullScale
+public enum AccelFullScale : byte
 {
     A2G,
     A4G,
@@ -18,10 +18,24 @@ public enum AccelFullScale
     A16G
 }
 
-public enum GyroFullScale
+public enum GyroFullScale : byte
 {
     G250DPS,
     G500DPS,
     G1000DPS,
     G2000DPS
 }
+
+/// <summary>
+/// Bandwidth of the digital low-pass filter in Hz, Bw256 turns it off
+/// </summary>
+public enum DlpfMode : byte
+{
+    Bw256,
+    Bw188,
+    Bw98,
+    Bw42,
+    Bw20,
+    Bw10,
+    Bw5
+}
@@ -0,0 +1,262 @@
+﻿using Serilog;
+using System;
+using System.Buffers.Binary;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+using System.Text;
+using System.Text.Json;
+
+namespace AccelDrum.Game.Accel;
+
+/// <summary>
+/// Turns the deferred log records of Log packets back into text,
+/// with the logdict.json that the firmware build generates from its LOG_* calls
+/// </summary>
+public class LogDictionary
+{
+    public enum Level : byte
+    {
+        Debug,
+        Info,
+        Warn,
+        Error
+    }
+
+    private enum Tag : byte
+    {
+        Bool,
+        Char,
+        I32,
+        U32,
+        I64,
+        U64,
+        F32,
+        Fixed,
+        String
+    }
+
+    public record Entry(string Level, string Format, string File, int Line);
+
+    private const int SizeRecordHeader = sizeof(byte) + sizeof(uint) * 2 + sizeof(byte) * 2;
+
+    private readonly Dictionary<uint, Entry> entries = new();
+
+    public int Count => entries.Count;
+
+    /// <summary>
+    /// Empty if the file doesn't exist or can't be read, records are then shown by id
+    /// </summary>
+    public static LogDictionary Load(string path)
+    {
+        LogDictionary dict = new();
+        if (!File.Exists(path))
+        {
+            Log.Warning($"{path} not found, device logs will only show format ids");
+            return dict;
+        }
+        try
+        {
+            using JsonDocument doc = JsonDocument.Parse(File.ReadAllText(path));
+            foreach (JsonProperty prop in doc.RootElement.GetProperty("entries").EnumerateObject())
+            {
+                uint id = uint.Parse(prop.Name, NumberStyles.HexNumber);
+                JsonElement e = prop.Value;
+                dict.entries[id] = new Entry(
+                    e.GetProperty("level").GetString() ?? "",
+                    e.GetProperty("format").GetString() ?? "",
+                    e.GetProperty("file").GetString() ?? "",
+                    e.GetProperty("line").GetInt32());
+            }
+        }
+        catch (Exception ex) when (ex is JsonException or IOException or KeyNotFoundException or FormatException)
+        {
+            Log.Error(ex, $"Failed to load {path}");
+        }
+        return dict;
+    }
+
+    /// <summary>
+    /// Renders every record in the records of a Log packet, one line each
+    /// </summary>
+    public List<string> Render(ReadOnlySpan<byte> records)
+    {
+        List<string> lines = new();
+        while (records.Length >= SizeRecordHeader)
+        {
+            int length = records[0];
+            if (length < SizeRecordHeader || length > records.Length)
+                break;
+            lines.Add(RenderRecord(records[..length]));
+            records = records[length..];
+        }
+        return lines;
+    }
+
+    private string RenderRecord(ReadOnlySpan<byte> record)
+    {
+        uint id = BinaryPrimitives.ReadUInt32LittleEndian(record[1..]);
+        uint millis = BinaryPrimitives.ReadUInt32LittleEndian(record[5..]);
+        Level level = (Level)record[9];
+        byte dropped = record[10];
+        List<object> args = ReadArgs(record[SizeRecordHeader..]);
+
+        StringBuilder sb = new();
+        sb.Append($"[{millis / 1000.0:0.000} {level.ToString()[0]}] ");
+        if (entries.TryGetValue(id, out Entry? entry))
+            Format(sb, entry.Format, args);
+        else
+            sb.Append($"<{id:x8}> {string.Join(", ", args)}");
+        if (dropped > 0)
+            sb.Append($" ({dropped}{(dropped == byte.MaxValue ? "+" : "")} dropped)");
+        sb.Append('\n');
+        return sb.ToString();
+    }
+
+    private static List<object> ReadArgs(ReadOnlySpan<byte> span)
+    {
+        List<object> args = new();
+        while (span.Length > 0)
+        {
+            Tag tag = (Tag)span[0];
+            span = span[1..];
+            int size = tag switch
+            {
+                Tag.Bool or Tag.Char => 1,
+                Tag.I32 or Tag.U32 or Tag.F32 => 4,
+                Tag.Fixed => 5,
+                Tag.I64 or Tag.U64 => 8,
+                Tag.String => span.Length > 0 ? 1 + span[0] : 1,
+                _ => int.MaxValue
+            };
+            if (size > span.Length)
+                break;
+            args.Add(tag switch
+            {
+                Tag.Bool => span[0] != 0,
+                Tag.Char => (char)span[0],
+                Tag.I32 => BinaryPrimitives.ReadInt32LittleEndian(span),
+                Tag.U32 => BinaryPrimitives.ReadUInt32LittleEndian(span),
+                Tag.I64 => BinaryPrimitives.ReadInt64LittleEndian(span),
+                Tag.U64 => BinaryPrimitives.ReadUInt64LittleEndian(span),
+                Tag.F32 => BinaryPrimitives.ReadSingleLittleEndian(span),
+                Tag.Fixed => new FixedArg(BinaryPrimitives.ReadSingleLittleEndian(span), span[4]),
+                _ => Encoding.UTF8.GetString(span.Slice(1, span[0]))
+            });
+            span = span[size..];
+        }
+        return args;
+    }
+
+    private readonly record struct FixedArg(float Value, int Precision);
+
+    /// <summary>
+    /// Same syntax as Fmt on the device, "{}" or "{:[0][width][.precision][type]}", "{{" and "}}" are braces,
+    /// arguments that didn't fit the record show as "?"
+    /// </summary>
+    private static void Format(StringBuilder sb, string format, List<object> args)
+    {
+        int arg = 0;
+        for (int i = 0; i < format.Length; i++)
+        {
+            char c = format[i];
+            if ((c == '{' || c == '}') && i + 1 < format.Length && format[i + 1] == c)
+            {
+                sb.Append(c);
+                i++;
+                continue;
+            }
+            if (c != '{')
+            {
+                sb.Append(c);
+                continue;
+            }
+            int end = format.IndexOf('}', i);
+            if (end < 0)
+            {
+                sb.Append(format, i, format.Length - i);
+                break;
+            }
+            string spec = format[(i + 1)..end];
+            i = end;
+            if (arg < args.Count)
+                sb.Append(FormatArg(args[arg], spec.StartsWith(':') ? spec[1..] : ""));
+            else
+                sb.Append('?');
+            arg++;
+        }
+    }
+
+    private static string FormatArg(object value, string spec)
+    {
+        int i = 0;
+        bool zeroPad = i < spec.Length && spec[i] == '0';
+        if (zeroPad)
+            i++;
+        int width = 0;
+        while (i < spec.Length && char.IsAsciiDigit(spec[i]))
+            width = width * 10 + (spec[i++] - '0');
+        int precision = -1;
+        if (i < spec.Length && spec[i] == '.')
+        {
+            i++;
+            precision = 0;
+            while (i < spec.Length && char.IsAsciiDigit(spec[i]))
+                precision = precision * 10 + (spec[i++] - '0');
+            precision = Math.Min(precision, 9);
+        }
+        char type = i < spec.Length ? spec[i] : '\0';
+
+        string s = value switch
+        {
+            bool b => type == 'd' ? (b ? "1" : "0") : (b ? "true" : "false"),
+            char ch => type is 'd' or 'x' or 'X' ? FormatInteger((ulong)ch, type) : ch.ToString(),
+            int v => FormatSigned(v, type),
+            long v => FormatSigned(v, type),
+            uint v => type == 'c' ? ((char)v).ToString() : FormatInteger(v, type),
+            ulong v => type == 'c' ? ((char)v).ToString() : FormatInteger(v, type),
+            float v => FormatFloat(v, precision < 0 ? 2 : precision),
+            FixedArg f => FormatFloat(f.Value, precision < 0 ? Math.Min((int)f.Precision, 9) : precision),
+            string str => precision >= 0 && str.Length > precision ? str[..precision] : str,
+            _ => value.ToString() ?? ""
+        };
+        if (s.Length >= width)
+            return s;
+        if (zeroPad && value is not (string or bool))
+        {
+            bool negative = s.StartsWith('-');
+            return negative
+                ? "-" + s[1..].PadLeft(width - 1, '0')
+                : s.PadLeft(width, '0');
+        }
+        return s.PadLeft(width);
+    }
+
+    private static string FormatSigned(long v, char type)
+    {
+        if (type == 'c')
+            return ((char)v).ToString();
+        if (type is 'x' or 'X')
+            return FormatInteger(v >= int.MinValue && v <= int.MaxValue ? (uint)(int)v : (ulong)v, type);
+        return v.ToString(CultureInfo.InvariantCulture);
+    }
+
+    private static string FormatInteger(ulong v, char type)
+    {
+        return type switch
+        {
+            'x' => v.ToString("x"),
+            'X' => v.ToString("X"),
+            _ => v.ToString(CultureInfo.InvariantCulture)
+        };
+    }
+
+    private static string FormatFloat(float v, int precision)
+    {
+        if (float.IsNaN(v))
+            return "nan";
+        if (float.IsInfinity(v))
+            return v > 0 ? "inf" : "-inf";
+        return ((double)v).ToString("F" + precision, CultureInfo.InvariantCulture);
+    }
+}
@@ -0,0 +1,113 @@
+﻿using AccelDrum.Game.Serial;
+using System;
+using System.Linq;
+using System.Reflection;
+using System.Runtime.CompilerServices;
+
+namespace AccelDrum.Game.Accel;
+
+/// <summary>
+/// FNV-1a over the layout of every packet struct, hashed the same way as Serial/PacketLayout.h in the firmware,
+/// so the hello handshake refuses a device with other packet definitions:
+/// the enum counts, then every struct as its size followed by its leaves in declaration order,
+/// a scalar leaf is (offset, size, 1), an inline array of scalars is (offset, element size, length),
+/// nested structs and inline arrays of structs are walked element by element,
+/// the structs are found by reflection so no field can be left out
+/// </summary>
+public static class PacketLayout
+{
+    /// <summary>
+    /// Inner struct of every packet type, in <see cref="PacketType"/> order from Accel
+    /// </summary>
+    private static readonly Type[] packetStructs =
+    [
+        typeof(AccelPacket),
+        typeof(RawAccelPacket),
+        typeof(TextPacket),
+        typeof(ConfigurePacket),
+        typeof(AckPacket),
+        typeof(TaskStatsPacket),
+        typeof(LogPacket),
+        typeof(BootProfilePacket),
+        typeof(HelloPacket),
+        typeof(TelemetryPacket),
+        typeof(LinkStatsPacket),
+    ];
+
+    /// <summary>
+    /// Carried in <see cref="ConfigurePacket.Data"/>
+    /// </summary>
+    private static readonly Type[] configureDataStructs =
+    [
+        typeof(ConfigurePacket.Settings),
+        typeof(ConfigurePacket.SensorConfigs),
+        typeof(ConfigurePacket.Subscriptions),
+    ];
+
+    private static readonly MethodInfo sizeOfMethod = typeof(Unsafe).GetMethod(nameof(Unsafe.SizeOf))!;
+
+    public static readonly uint Hash = Compute();
+
+    private static uint Compute()
+    {
+        if (packetStructs.Length != (int)PacketType.Count - 1)
+            throw new InvalidOperationException("Every packet type needs its struct in PacketLayout");
+        uint hash = 2166136261;
+        foreach (int count in new[] { (int)PacketType.Count, (int)ConfigurePacket.Typ.Count,
+            (int)ConfigurePacket.Val.Count, (int)StreamId.Count })
+            hash = Fnv1a(hash, (uint)count);
+        foreach (Type type in packetStructs.Prepend(typeof(SerialPacket)).Concat(configureDataStructs))
+            hash = HashOf(type, Fnv1a(hash, (uint)SizeOf(type)), 0);
+        return hash;
+    }
+
+    private static uint HashOf(Type type, uint hash, int offset)
+    {
+        if (IsScalar(type))
+            return Fnv1a(Fnv1a(Fnv1a(hash, (uint)offset), (uint)SizeOf(type)), 1);
+        FieldInfo[] fields = type
+            .GetFields(BindingFlags.Instance | BindingFlags.Public | BindingFlags.NonPublic)
+            .OrderBy(f => f.MetadataToken)
+            .ToArray();
+        if (type.GetCustomAttribute<InlineArrayAttribute>() is InlineArrayAttribute inlineArray)
+        {
+            Type element = fields[0].FieldType;
+            int elementSize = SizeOf(element);
+            if (IsScalar(element))
+                return Fnv1a(Fnv1a(Fnv1a(hash, (uint)offset), (uint)elementSize), (uint)inlineArray.Length);
+            for (int i = 0; i < inlineArray.Length; i++)
+                hash = HashOf(element, hash, offset + i * elementSize);
+            return hash;
+        }
+        // The firmware's structs are packed, so every field starts where the previous one ends
+        int next = 0;
+        foreach (FieldInfo field in fields)
+        {
+            hash = HashOf(field.FieldType, hash, offset + next);
+            next += SizeOf(field.FieldType);
+        }
+        if (next != SizeOf(type))
+            throw new InvalidOperationException($"{type} has gaps between its fields, it should be Pack = 1");
+        return hash;
+    }
+
+    private static bool IsScalar(Type type)
+    {
+        return type.IsPrimitive || type.IsEnum;
+    }
+
+    private static int SizeOf(Type type)
+    {
+        return (int)sizeOfMethod.MakeGenericMethod(type).Invoke(null, null)!;
+    }
+
+    private static uint Fnv1a(uint hash, uint value)
+    {
+        for (int i = 0; i < sizeof(uint); i++)
+        {
+            hash ^= (value >> (i * 8)) & 0xFF;
+            hash *= 16777619;
+        }
+        return hash;
+    }
+}
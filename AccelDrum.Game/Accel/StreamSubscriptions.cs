@@ -0,0 +1,97 @@
+﻿using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace AccelDrum.Game.Accel;
+
+/// <summary>
+/// Rates the host's clients want per device stream, the device serves each stream at the fastest rate
+/// any client wants, so a 60 Hz view and a 1 kHz recorder share one subscription,
+/// subscriptions are leased and have to be renewed before <see cref="LeaseMillis"/> runs out
+/// </summary>
+public class StreamSubscriptions
+{
+    public const ushort LeaseMillis = 1500;
+    public const long RenewMillis = LeaseMillis / 2;
+
+    private readonly Dictionary<(string Client, StreamId Stream), ushort> wants = new();
+    /// <summary>
+    /// Rates last sent, a stream no one wants anymore is sent once with rate 0
+    /// </summary>
+    private readonly Dictionary<StreamId, ushort> sent = new();
+    private readonly Dictionary<StreamId, ushort> granted = new();
+    private bool changed = false;
+
+    /// <summary>
+    /// Sets the rate a client wants of a stream, 0 to stop wanting it
+    /// </summary>
+    public void Want(string client, StreamId stream, ushort rateHz)
+    {
+        ushort before = GetWantedRate(stream);
+        if (rateHz == 0)
+            wants.Remove((client, stream));
+        else
+            wants[(client, stream)] = rateHz;
+        changed |= GetWantedRate(stream) != before;
+    }
+
+    public ushort GetWantedRate(StreamId stream)
+    {
+        return wants.Where(w => w.Key.Stream == stream).Select(w => w.Value).DefaultIfEmpty().Max();
+    }
+
+    /// <summary>
+    /// Rate the device granted in its last reply, 0 if not subscribed
+    /// </summary>
+    public ushort GetGrantedRate(StreamId stream)
+    {
+        return granted.GetValueOrDefault(stream);
+    }
+
+    /// <summary>
+    /// True if the wanted rates changed since the last <see cref="BuildRenewal"/>
+    /// </summary>
+    public bool Changed => changed;
+
+    /// <summary>
+    /// Subscribes every wanted stream again and unsubscribes the ones no longer wanted
+    /// </summary>
+    public ConfigurePacket BuildRenewal()
+    {
+        var packet = new ConfigurePacket(ConfigurePacket.Typ.Subscribe, ConfigurePacket.Val.SubscribeSet);
+        ref var subs = ref packet.GetDataAs<ConfigurePacket.Subscriptions>();
+        foreach (StreamId stream in Enum.GetValues<StreamId>())
+        {
+            if (stream == StreamId.Count)
+                continue;
+            ushort rate = GetWantedRate(stream);
+            if (rate == 0 && sent.GetValueOrDefault(stream) == 0)
+                continue;
+            subs.Entries[subs.Count++] = new()
+            {
+                Stream = stream,
+                RateHz = rate,
+                LeaseMillis = LeaseMillis,
+            };
+            sent[stream] = rate;
+        }
+        changed = false;
+        return packet;
+    }
+
+    public void HandleResult(ConfigurePacket.Subscriptions result)
+    {
+        for (int i = 0; i < Math.Min((int)result.Count, ConfigurePacket.Subscriptions.MaxCount); i++)
+            granted[result.Entries[i].Stream] = result.Entries[i].RateHz;
+    }
+
+    /// <summary>
+    /// The device dropped everything, e.g. after a reconnect
+    /// </summary>
+    public void Reset()
+    {
+        sent.Clear();
+        granted.Clear();
+        changed = true;
+    }
+}
@@ -0,0 +1,83 @@
+﻿namespace AccelDrum.Game.Serial;
+
+/// <summary>
+/// Tracks the sequence numbers of one inbound stream,
+/// remembers the last <see cref="WindowSize"/> sequence numbers to tell late packets from duplicates
+/// </summary>
+public class SequenceTracker
+{
+    public const int WindowSize = 32;
+
+    public enum Result
+    {
+        InOrder,
+        /// <summary>
+        /// Some packets before this one are missing
+        /// </summary>
+        Gap,
+        /// <summary>
+        /// Arrived after a newer one, was counted as missing before
+        /// </summary>
+        Late,
+        /// <summary>
+        /// Was already received
+        /// </summary>
+        Duplicate,
+        /// <summary>
+        /// Too far behind to be late, the peer has likely restarted the stream
+        /// </summary>
+        Resync,
+    }
+
+    private uint received = 0;
+    private ushort expected = 0;
+    private bool synced = false;
+
+    /// <summary>
+    /// Sets <paramref name="missing"/> to the number of packets skipped over by a gap
+    /// </summary>
+    public Result Track(ushort seq, out int missing)
+    {
+        missing = 0;
+        if (!synced)
+        {
+            Resync(seq);
+            return Result.InOrder;
+        }
+        short diff = unchecked((short)(seq - expected));
+        if (diff >= 0)
+        {
+            missing = diff;
+            received = diff + 1 >= WindowSize ? 0 : received << (diff + 1);
+            received |= 1;
+            expected = unchecked((ushort)(seq + 1));
+            return diff == 0 ? Result.InOrder : Result.Gap;
+        }
+        // Bit n of received is set when (expected - 1 - n) was received
+        int age = unchecked((ushort)(expected - 1 - seq));
+        if (age >= WindowSize)
+        {
+            Resync(seq);
+            return Result.Resync;
+        }
+        uint bit = 1u << age;
+        if ((received & bit) != 0)
+            return Result.Duplicate;
+        received |= bit;
+        return Result.Late;
+    }
+
+    public void Reset()
+    {
+        synced = false;
+        expected = 0;
+        received = 0;
+    }
+
+    private void Resync(ushort seq)
+    {
+        synced = true;
+        expected = unchecked((ushort)(seq + 1));
+        received = 1;
+    }
+}
@@ -4,6 +4,7 @@ using Serilog;
 using System;
 using System.Collections.Concurrent;
 using System.Collections.Generic;
+using System.Diagnostics;
 using System.IO.Ports;
 using System.Runtime.CompilerServices;
 using System.Threading;
@@ -17,7 +18,24 @@ public class SerialManager : IDisposable
     public ulong Magic => SerialPacket.MagicExpected;
     public int PacketCount { get; private set; } = 0;
     public int CorruptedPacketCount { get; private set; } = 0;
+    /// <summary>
+    /// Inbound packets skipped over by sequence gaps, minus the ones that arrived late
+    /// </summary>
+    public int LostPacketCount { get; private set; } = 0;
+    public int LatePacketCount { get; private set; } = 0;
+    public int DuplicatePacketCount { get; private set; } = 0;
+    /// <summary>
+    /// Outbound reliable packets sent again because their ack didn't arrive in time
+    /// </summary>
+    public int RetransmitCount { get; private set; } = 0;
+    /// <summary>
+    /// Outbound reliable packets given up on after <see cref="MaxAttempts"/>
+    /// </summary>
+    public int ReliableDropCount { get; private set; } = 0;
+    public int PendingReliableCount => pendingReliable.Count;
     public int BytesRead => bytesRead;
+    public const int RetransmitTimeoutMs = 100;
+    public const int MaxAttempts = 5;
     private SerialPort serial = new();
     private Queue<byte> parsingQueue = new();
     private ConcurrentQueue<SerialPacket> inboundQueue = new();
@@ -25,6 +43,10 @@ public class SerialManager : IDisposable
     //private ConcurrentQueue<SerialPacket> outboundPackets = new(); // Outbound queue?
     private volatile int bytesRead = 0;
     private byte[] outboundBuffer = new byte[SerialPacket.Size];
+    private readonly object outboundLock = new();
+    private ushort[] outboundSeqs = new ushort[(int)PacketType.Count];
+    private SequenceTracker[] inboundSeqs = CreateTrackers();
+    private List<PendingPacket> pendingReliable = new();
     private Thread? receiverThread = null;
     private CancellationTokenSource receiverCancellationSource = new();
 
@@ -37,8 +59,51 @@ public class SerialManager : IDisposable
         serial.ErrorReceived += OnSerialErrorReceived;
     }
 
+    private class PendingPacket
+    {
+        public SerialPacket Packet;
+        public long SentTimestamp;
+        public int Attempts;
+    }
+
+    private static SequenceTracker[] CreateTrackers()
+    {
+        var trackers = new SequenceTracker[(int)PacketType.Count];
+        for (int i = 0; i < trackers.Length; i++)
+            trackers[i] = new();
+        return trackers;
+    }
+
     public void Update()
     {
+        if (Connected)
+            RetransmitExpired();
+    }
+
+    private void RetransmitExpired()
+    {
+        lock (outboundLock)
+        {
+            for (int i = pendingReliable.Count - 1; i >= 0; i--)
+            {
+                PendingPacket pending = pendingReliable[i];
+                if (Stopwatch.GetElapsedTime(pending.SentTimestamp).TotalMilliseconds < RetransmitTimeoutMs)
+                    continue;
+                if (pending.Attempts >= MaxAttempts)
+                {
+                    pendingReliable.RemoveAt(i);
+                    ReliableDropCount++;
+                    Log.Warning($"Gave up on reliable packet {(PacketType)pending.Packet.Type} #{pending.Packet.Seq}");
+                    continue;
+                }
+                pending.Packet.Flags |= PacketFlags.Retransmit;
+                pending.Packet.Crc32 = pending.Packet.GetCrc32();
+                WriteNative(ref pending.Packet);
+                pending.SentTimestamp = Stopwatch.GetTimestamp();
+                pending.Attempts++;
+                RetransmitCount++;
+            }
+        }
     }
 
     public void Connect(string name, int baud)
@@ -70,6 +135,18 @@ public class SerialManager : IDisposable
         inboundQueue.Clear();
         PacketCount = 0;
         CorruptedPacketCount = 0;
+        LostPacketCount = 0;
+        LatePacketCount = 0;
+        DuplicatePacketCount = 0;
+        RetransmitCount = 0;
+        ReliableDropCount = 0;
+        lock (outboundLock)
+        {
+            pendingReliable.Clear();
+            Array.Clear(outboundSeqs);
+        }
+        foreach (SequenceTracker tracker in inboundSeqs)
+            tracker.Reset();
         bytesRead = 0;
     }
 
@@ -148,11 +225,59 @@ public class SerialManager : IDisposable
             Log.Warning($"Crc32 doesn't match: 0x{crc:X} and 0x{p.Crc32:X}");
             return false;
         }
-        inboundQueue.Enqueue(p);
+        PacketType type = (PacketType)p.Type;
+        if (!(type > PacketType.None && type < PacketType.Count))
+        {
+            Log.Warning($"Unknown packet type {p.Type}");
+            return false;
+        }
         PacketCount++;
+        if (!TrackInbound(ref p))
+            return false;
+        if (type == PacketType.Ack)
+        {
+            HandleAck(p.GetInnerAs<AckPacket>());
+            return true;
+        }
+        inboundQueue.Enqueue(p);
+        return true;
+    }
+
+    /// <summary>
+    /// Returns false if the packet is a duplicate and shouldn't be processed again
+    /// </summary>
+    private bool TrackInbound(ref SerialPacket p)
+    {
+        PacketType type = (PacketType)p.Type;
+        // Acked even when it's a duplicate, the previous ack might have been the one lost
+        if (p.Flags.HasFlag(PacketFlags.Reliable))
+            SendPacket(PacketType.Ack, new AckPacket(type, p.Seq));
+        switch (inboundSeqs[(int)type].Track(p.Seq, out int missing))
+        {
+            case SequenceTracker.Result.Gap:
+                LostPacketCount += missing;
+                break;
+            case SequenceTracker.Result.Late:
+                LatePacketCount++;
+                if (LostPacketCount > 0)
+                    LostPacketCount--;
+                break;
+            case SequenceTracker.Result.Duplicate:
+                DuplicatePacketCount++;
+                return false;
+        }
         return true;
     }
 
+    private void HandleAck(AckPacket ack)
+    {
+        lock (outboundLock)
+        {
+            pendingReliable.RemoveAll(pending =>
+                pending.Packet.Type == (byte)ack.Type && pending.Packet.Seq == ack.Seq);
+        }
+    }
+
     public bool TryDequeueInbound<T>(out T outPacket) where T : struct
     {
         SerialPacket.CheckInnerSize<T>();
@@ -196,19 +321,46 @@ public class SerialManager : IDisposable
         if (!Connected)
             throw new InvalidOperationException("Serial is not connected");
 
-        ref SerialPacket<T> packet = ref Unsafe.As<byte, SerialPacket<T>>(ref outboundBuffer[0]);
-        packet.Type = (uint)type;
-        packet.Inner = inner;
-        packet.Crc32 = packet.GetCrc32();
-        packet.Magic = SerialPacket.MagicExpected;
-        using (new Timer2(
-            time => Log.Information($"Packet of type {typeof(T).Name} sent in {time.TotalMicroseconds:n0} us " +
-                $"(eff. {SerialPacket.Size * 8 / time.TotalSeconds:n0} bit/s)")))
+        lock (outboundLock)
         {
-            serial.Write(outboundBuffer, 0, SerialPacket.Size);
+            bool reliable = type.IsReliableStream();
+            SerialPacket<T> packet = new()
+            {
+                Type = (byte)type,
+                Flags = reliable ? PacketFlags.Reliable : PacketFlags.None,
+                Seq = outboundSeqs[(int)type]++,
+                Inner = inner,
+                Magic = SerialPacket.MagicExpected,
+            };
+            packet.Crc32 = packet.GetCrc32();
+            ref SerialPacket native = ref SerialPacket.RefFromTyped(ref packet);
+            if (reliable)
+            {
+                pendingReliable.Add(new PendingPacket()
+                {
+                    Packet = native,
+                    SentTimestamp = Stopwatch.GetTimestamp(),
+                    Attempts = 1,
+                });
+            }
+            using (new Timer2(
+                time => Log.Information($"Packet of type {typeof(T).Name} sent in {time.TotalMicroseconds:n0} us " +
+                    $"(eff. {SerialPacket.Size * 8 / time.TotalSeconds:n0} bit/s)")))
+            {
+                WriteNative(ref native);
+            }
         }
     }
 
+    /// <summary>
+    /// Writes a complete packet, should be called with <see cref="outboundLock"/> held
+    /// </summary>
+    private void WriteNative(ref SerialPacket packet)
+    {
+        Unsafe.As<byte, SerialPacket>(ref outboundBuffer[0]) = packet;
+        serial.Write(outboundBuffer, 0, SerialPacket.Size);
+    }
+
     ~SerialManager()
     {
         Dispose();
@@ -7,16 +7,36 @@ using System.Text;
 
 namespace AccelDrum.Game.Serial;
 
+[Flags]
+public enum PacketFlags : byte
+{
+    None = 0,
+    /// <summary>
+    /// Receiver should reply with an ack
+    /// </summary>
+    Reliable = 1 << 0,
+    /// <summary>
+    /// Sent again because the ack didn't arrive in time
+    /// </summary>
+    Retransmit = 1 << 1,
+}
+
 [StructLayout(LayoutKind.Sequential, Pack = 1)]
 public struct SerialPacket
 {
     public static readonly int Size = Unsafe.SizeOf<SerialPacket>();
     public const int SizeExpected = 144;
-    public const int SizeInner = SizeExpected - sizeof(uint) - sizeof(uint) - sizeof(ulong);
+    public const int SizeHeader = sizeof(byte) + sizeof(byte) + sizeof(ushort);
+    public const int SizeInner = SizeExpected - SizeHeader - sizeof(uint) - sizeof(ulong);
     public const ulong MagicExpected = 0xDEADBEEF80085069;
     public static readonly ulong MagicExpectedReversed = BinaryPrimitives.ReverseEndianness(MagicExpected);
 
-    public uint Type;
+    public byte Type;
+    public PacketFlags Flags;
+    /// <summary>
+    /// Counted separately for every packet type
+    /// </summary>
+    public ushort Seq;
     public InnerData Inner;
     public uint Crc32;
     public ulong Magic;
@@ -38,14 +58,14 @@ public struct SerialPacket
     }
 
     /// <summary>
-    /// Gets the crc32 of <see cref="Type"/> + <see cref="Inner"/>
+    /// Gets the crc32 of the header + <see cref="Inner"/>
     /// </summary>
     public uint GetCrc32()
     {
         return System.IO.Hashing.Crc32.HashToUInt32(
             MemoryMarshal.CreateReadOnlySpan(
-                ref Unsafe.As<uint, byte>(ref Type),
-                sizeof(uint) + SerialPacket.SizeInner)
+                ref Type,
+                SerialPacket.SizeHeader + SerialPacket.SizeInner)
         );
     }
 
@@ -96,7 +116,9 @@ public struct SerialPacket
 [StructLayout(LayoutKind.Sequential, Pack = 1)]
 public struct SerialPacket<T> where T : struct
 {
-    public uint Type;
+    public byte Type;
+    public PacketFlags Flags;
+    public ushort Seq;
     public T Inner;
     public uint Crc32;
     public ulong Magic;
@@ -106,8 +128,8 @@ public struct SerialPacket<T> where T : struct
     {
         return System.IO.Hashing.Crc32.HashToUInt32(
             MemoryMarshal.CreateReadOnlySpan(
-                ref Unsafe.As<uint, byte>(ref Type),
-                sizeof(uint) + SerialPacket.SizeInner)
+                ref Type,
+                SerialPacket.SizeHeader + SerialPacket.SizeInner)
         );
     }
 
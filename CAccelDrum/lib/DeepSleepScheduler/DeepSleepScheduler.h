@@ -27,6 +27,11 @@
     from the watchdog interrupt. This means that e.g. delay() does not work.
   - #define SUPERVISION_CALLBACK_TIMEOUT: Specify the timeout of the callback on AVR until the watchdog resets the CPU. Defaults to WDTO_1S.
   - #define AWAKE_INDICATION_PIN: Show on a LED if the CPU is active or in sleep mode. HIGH = active, LOW = sleeping.
+  - #define TASK_POOL_SIZE: Number of tasks preallocated by the scheduler, tasks beyond it fall back to the heap. Defaults to 32.
+  - #define TASK_STATS: Record run time, start jitter and overruns per callback or Runnable, see getTaskStats().
+    Changes the layout of Scheduler so it must be defined for every include, e.g. as a build flag.
+  - #define TASK_STATS_SIZE: Number of distinct callbacks and Runnables tracked by TASK_STATS. Defaults to 16.
+  - #define POST_QUEUE_SIZE: Capacity of the queue of post(), a power of 2. Defaults to 16. ESP32 only.
 */
 
 #ifndef DEEP_SLEEP_SCHEDULER_H
@@ -36,12 +41,29 @@
 // Definition (usually in H file)
 // -------------------------------------------------------------------------------------------------
 #include <Arduino.h>
+#include <new> // MODIFIED for placement new in the task pool
 #if defined(ESP32) || defined(ESP8266)
 #include "DeepSleepScheduler_esp_includes.h"
 #endif
 
 #define BUFFER_TIME 2
 #define NOT_USED 255
+// MODIFIED added the task pool
+#ifndef TASK_POOL_SIZE
+#define TASK_POOL_SIZE 32
+#endif
+// MODIFIED added per task statistics
+#ifndef TASK_STATS_SIZE
+#define TASK_STATS_SIZE 16
+#endif
+#define TASK_STATS_BUCKETS 16
+// MODIFIED added cross core posting
+#ifndef POST_QUEUE_SIZE
+#define POST_QUEUE_SIZE 16
+#endif
+#ifdef ESP32
+#include <atomic>
+#endif
 
 enum TaskTimeout {
   TIMEOUT_15Ms,
@@ -57,28 +79,88 @@ enum TaskTimeout {
   NO_SUPERVISION
 };
 
+// MODIFIED added periodic tasks
+/**
+  What a periodic task does when it finishes after its next run was already due.
+*/
+enum OverrunPolicy {
+  // Drop the missed runs and continue at the next period boundary that is still ahead
+  OVERRUN_SKIP,
+  // Run the missed runs back to back until the task is on time again
+  OVERRUN_CATCH_UP
+};
+
+#ifdef TASK_STATS
+// MODIFIED added per task statistics
+/**
+  Statistics of every run of one callback or Runnable.
+  Histogram bucket i counts values in [2^(i - 1), 2^i) microseconds, the last bucket also counts everything above.
+  Counts saturate instead of wrapping.
+*/
+struct TaskStats {
+  const char *name;
+  unsigned long runCount;
+  uint32_t minRunCycles;
+  uint32_t maxRunCycles;
+  uint64_t totalRunCycles;
+  // Actual start minus scheduled start
+  uint32_t maxJitterMicros;
+  uint64_t totalJitterMicros;
+  unsigned long overrunCount;
+  uint16_t runHistogram[TASK_STATS_BUCKETS];
+  uint16_t jitterHistogram[TASK_STATS_BUCKETS];
+};
+#endif
+
 /**
   Extend from Runnable in order to have the run() method run by the scheduler.
 */
 class Runnable {
   public:
     virtual void run() = 0;
+
+    // MODIFIED added so short lived Runnables can share one TASK_STATS entry
+    /**
+      return: The Runnable whose statistics and name runs of this one are counted under, this by default.
+      Called right before run(), the returned Runnable must outlive this one.
+    */
+    virtual Runnable *getStatsRunnable() {
+      return this;
+    }
+};
+
+// MODIFIED added task handles
+/**
+  Identifies a single scheduled task so it can be cancelled or rescheduled without searching the queue.
+  A default constructed handle or one whose task already ran or was removed refers to nothing.
+*/
+class TaskHandle {
+  public:
+    TaskHandle() : task(NULL), id(0) {
+    }
+  private:
+    friend class Scheduler;
+    TaskHandle(void *task, unsigned long id) : task(task), id(id) {
+    }
+    void *task;
+    unsigned long id;
 };
 
 class Scheduler {
   public:
+    // MODIFIED all schedule methods return a handle to the new task
     /**
       Schedule the callback method as soon as possible but after other tasks
       that are to be scheduled immediately and are in the queue already.
       @param callback: the method to be called on the main thread
     */
-    void schedule(void (*callback)());
+    TaskHandle schedule(void (*callback)());
     /**
       Schedule the Runnable as soon as possible but after other tasks
       that are to be scheduled immediately and are in the queue already.
       @param runnable: the Runnable on which the run() method will be called on the main thread
     */
-    void schedule(Runnable *runnable);
+    TaskHandle schedule(Runnable *runnable);
 
     /**
       Schedule the callback method as soon as possible and remove all other
@@ -87,7 +169,7 @@ class Scheduler {
       multiple times.
       @param callback: the method to be called on the main thread
     */
-    void scheduleOnce(void (*callback)());
+    TaskHandle scheduleOnce(void (*callback)());
     /**
       Schedule the Runnable as soon as possible and remove all other
       tasks with the same Runnable. This is useful if you call it
@@ -95,20 +177,74 @@ class Scheduler {
       multiple times.
       @param runnable: the Runnable on which the run() method will be called on the main thread
     */
-    void scheduleOnce(Runnable *runnable);
+    TaskHandle scheduleOnce(Runnable *runnable);
 
     /**
       Schedule the callback after delayMillis milliseconds.
       @param callback: the method to be called on the main thread
       @param delayMillis: the time to wait in milliseconds until the callback shall be made
     */
-    void scheduleDelayed(void (*callback)(), unsigned long delayMillis);
+    TaskHandle scheduleDelayed(void (*callback)(), unsigned long delayMillis);
     /**
       Schedule the callback after delayMillis milliseconds.
       @param runnable: the Runnable on which the run() method will be called on the main thread
       @param delayMillis: the time to wait in milliseconds until the callback shall be made
     */
-    void scheduleDelayed(Runnable *runnable, unsigned long delayMillis);
+    TaskHandle scheduleDelayed(Runnable *runnable, unsigned long delayMillis);
+
+    // MODIFIED added microsecond and periodic scheduling
+    /**
+      Schedule the callback after delayMicros microseconds.
+      @param callback: the method to be called on the main thread
+      @param delayMicros: the time to wait in microseconds until the callback shall be made
+    */
+    TaskHandle scheduleDelayedMicros(void (*callback)(), unsigned long delayMicros);
+    /**
+      Schedule the callback after delayMicros microseconds.
+      @param runnable: the Runnable on which the run() method will be called on the main thread
+      @param delayMicros: the time to wait in microseconds until the callback shall be made
+    */
+    TaskHandle scheduleDelayedMicros(Runnable *runnable, unsigned long delayMicros);
+
+    /**
+      Schedule the callback every periodMicros microseconds, starting one period from now.
+      Runs are anchored to the ideal timeline (start + n * period) instead of to the end of the
+      previous run, so the cadence does not drift with the run time of the task.
+      The task stays scheduled until cancelled through its handle or removeCallbacks().
+      @param callback: the method to be called on the main thread
+      @param periodMicros: the period in microseconds, must not be 0
+      @param overrunPolicy: what to do when a run finishes after the next one was due
+    */
+    TaskHandle schedulePeriodic(void (*callback)(), unsigned long periodMicros, OverrunPolicy overrunPolicy = OVERRUN_SKIP);
+    /**
+      Schedule the Runnable every periodMicros microseconds, starting one period from now.
+      See schedulePeriodic(void (*callback)(), unsigned long, OverrunPolicy).
+      @param runnable: the Runnable on which the run() method will be called on the main thread
+      @param periodMicros: the period in microseconds, must not be 0
+      @param overrunPolicy: what to do when a run finishes after the next one was due
+    */
+    TaskHandle schedulePeriodic(Runnable *runnable, unsigned long periodMicros, OverrunPolicy overrunPolicy = OVERRUN_SKIP);
+
+    /**
+      Change the period of a periodic task, takes effect from its next run.
+      Can be called from the task itself.
+      @param handle: handle returned by schedulePeriodic()
+      @param periodMicros: the new period in microseconds, must not be 0
+      return: false if the task is not scheduled anymore or not periodic
+    */
+    bool setPeriod(const TaskHandle &handle, unsigned long periodMicros);
+
+    // MODIFIED added
+    /**
+      Run a periodic task next at an absolute time instead of one period after its scheduled time,
+      the period applies again after that run. A time already passed runs it right away
+      and isn't counted as an overrun, the task asked for it.
+      Must be called from the task itself.
+      @param handle: handle returned by schedulePeriodic()
+      @param uptimeMicros: the time of the next run, on the getMicros() time base
+      return: false if the handle isn't the running periodic task
+    */
+    bool setNextRun(const TaskHandle &handle, uint64_t uptimeMicros);
 
     /**
       Schedule the callback uptimeMillis milliseconds after the device was started.
@@ -118,7 +254,7 @@ class Scheduler {
       @param uptimeMillis: the time in milliseconds since the device was started
                            to schedule the callback.
     */
-    void scheduleAt(void (*callback)(), unsigned long uptimeMillis);
+    TaskHandle scheduleAt(void (*callback)(), unsigned long uptimeMillis);
     /**
       Schedule the callback uptimeMillis milliseconds after the device was started.
       Please be aware that uptimeMillis is stopped when no task is pending. In this case,
@@ -127,18 +263,41 @@ class Scheduler {
       @param uptimeMillis: the time in milliseconds since the device was started
                            to schedule the callback.
     */
-    void scheduleAt(Runnable *runnable, unsigned long uptimeMillis);
+    TaskHandle scheduleAt(Runnable *runnable, unsigned long uptimeMillis);
 
     /**
       Schedule the callback method as next task even if other tasks are in the queue already.
       @param callback: the method to be called on the main thread
     */
-    void scheduleAtFrontOfQueue(void (*callback)());
+    TaskHandle scheduleAtFrontOfQueue(void (*callback)());
     /**
       Schedule the callback method as next task even if other tasks are in the queue already.
       @param runnable: the Runnable on which the run() method will be called on the main thread
     */
-    void scheduleAtFrontOfQueue(Runnable *runnable);
+    TaskHandle scheduleAtFrontOfQueue(Runnable *runnable);
+
+    // MODIFIED added handle based methods
+    /**
+      Remove the single task referred to by the handle, runs in O(log n).
+      A periodic task can cancel itself while it runs, it's then not scheduled again.
+      @param handle: handle returned when the task was scheduled
+      return: false if the task already ran or was removed
+    */
+    bool cancel(const TaskHandle &handle);
+
+    /**
+      Move the task referred to by the handle to uptimeMillis, runs in O(log n).
+      @param handle: handle returned when the task was scheduled
+      @param uptimeMillis: the new time in milliseconds since the device was started
+      return: false if the task already ran or was removed
+    */
+    bool reschedule(const TaskHandle &handle, unsigned long uptimeMillis);
+
+    /**
+      Check if the task referred to by the handle is still waiting to run.
+      @param handle: handle returned when the task was scheduled
+    */
+    bool isScheduled(const TaskHandle &handle) const;
 
     /**
       Check if this callback is scheduled at least once already.
@@ -213,6 +372,12 @@ class Scheduler {
     */
     unsigned long getMillis() const;
 
+    // MODIFIED added the microsecond time base, all tasks are scheduled on it
+    /**
+      return: The microseconds since startup of the device, including the time spent in light sleep.
+    */
+    uint64_t getMicros() const;
+
 #ifdef SUPERVISION_CALLBACK
 #ifdef ESP8266
 #error "SUPERVISION_CALLBACK not supported for ESP8266"
@@ -232,21 +397,173 @@ class Scheduler {
     }
 #endif
 
+    // MODIFIED added task pool counters
+    /**
+      return: The number of tasks currently taken from the task pool.
+    */
+    unsigned int getTaskPoolUsed() const;
+
+    /**
+      return: The most tasks ever taken from the task pool at the same time.
+    */
+    unsigned int getTaskPoolHighWaterMark() const;
+
+    /**
+      return: The number of tasks allocated on the heap because the task pool was exhausted.
+    */
+    unsigned long getTaskHeapFallbackCount() const;
+
+    /**
+      return: The number of tasks waiting in the run queue.
+    */
+    unsigned int getQueuedTaskCount() const;
+
+    /**
+      return: The number of times a periodic task finished after its next run was already due.
+    */
+    unsigned long getPeriodicOverrunCount() const;
+
+    /**
+      return: The number of periodic runs dropped by OVERRUN_SKIP.
+    */
+    unsigned long getPeriodicSkippedCount() const;
+
+    /**
+      return: The number of overruns of a single periodic task, 0 if the task is not scheduled anymore.
+      @param handle: handle returned by schedulePeriodic()
+    */
+    unsigned long getOverrunCount(const TaskHandle &handle) const;
+
+#ifdef TASK_STATS
+    /**
+      Name the statistics of a callback, the string must outlive the scheduler.
+      @param callback: the callback to name
+      @param name: the name to report
+    */
+    void setTaskName(void (*callback)(), const char *name);
+    /**
+      Name the statistics of a Runnable, the string must outlive the scheduler.
+      @param runnable: the Runnable to name
+      @param name: the name to report
+    */
+    void setTaskName(Runnable *runnable, const char *name);
+
+    /**
+      Can be called from the supervision callback.
+      return: The name of the running task, NULL if no task is running or it's not named.
+    */
+    const char *getCurrentTaskName() const;
+
+    /**
+      return: The number of callbacks and Runnables that have statistics.
+    */
+    unsigned int getTaskStatsCount() const;
+
+    /**
+      Copy the statistics of one callback or Runnable.
+      @param index: index below getTaskStatsCount()
+      @param stats: receives the statistics
+      return: false if index is out of range
+    */
+    bool getTaskStats(unsigned int index, TaskStats &stats) const;
+
+    /**
+      Clear all statistics, names are kept.
+    */
+    void resetTaskStats();
+
+    /**
+      return: The number of cycles per microsecond, divides the run cycles of TaskStats.
+    */
+    uint32_t getCyclesPerMicro() const;
+
+    /**
+      return: Runs of callbacks or Runnables not recorded because all TASK_STATS_SIZE entries are taken.
+    */
+    unsigned long getUntrackedRunCount() const;
+#endif
+
+    // MODIFIED added utilization
+    /**
+      return: Permille of the last completed second spent running tasks.
+    */
+    unsigned int getUtilizationPermille() const;
+
+    // MODIFIED added idle time
+    /**
+      return: Permille of the last completed second spent blocked waiting for a task, always 0 on AVR and ESP8266.
+    */
+    unsigned int getIdlePermille() const;
+
     /**
       This method needs to be called from your loop() method and does not return.
     */
     void execute();
 
+#ifdef ESP32
+    // MODIFIED added one scheduler per core, each instance must only be used from the core executing it
+    // except for post()
+    /**
+      Run execute() in a new FreeRTOS task pinned to core, returns right away.
+      @param core: the core to run on
+      @param stackSize: stack size of the task in bytes
+      @param priority: FreeRTOS priority of the task
+    */
+    void executeOnCore(BaseType_t core, uint32_t stackSize, UBaseType_t priority);
+
+    /**
+      return: The scheduler executing on core, NULL if there is none.
+      @param core: the core
+    */
+    static Scheduler *forCore(BaseType_t core);
+
+    /**
+      return: The scheduler executing on the calling core, the global scheduler if there is none yet.
+    */
+    static Scheduler &forCurrentCore();
+
+    /**
+      Schedule the callback as soon as possible, safe to call from any core, task or interrupt.
+      The callback is moved to the run queue by the core executing this scheduler.
+      Unlike schedule(), this also wakes the scheduler if it is blocked waiting for the next task.
+      @param callback: the method to be called on the core of this scheduler
+      return: false if the post queue is full
+    */
+    bool post(void (*callback)());
+    /**
+      Schedule the Runnable as soon as possible, safe to call from any core, task or interrupt.
+      @param runnable: the Runnable on which the run() method will be called on the core of this scheduler
+      return: false if the post queue is full
+    */
+    bool post(Runnable *runnable);
+
+    /**
+      return: The number of post() calls rejected because the post queue was full.
+    */
+    unsigned long getPostOverflowCount() const;
+
+    /**
+      Can be called from the supervision callback.
+      return: The scheduler whose task timed out, NULL if none did.
+    */
+    static Scheduler *getTimedOutScheduler();
+#endif
+
     /**
       Constructor of the scheduler. Do not all this method as there is only one instance of Scheduler supported.
+      MODIFIED on ESP32 one more instance can be created for the other core, see executeOnCore().
     */
     Scheduler();
 
   private:
     class Task {
       public:
-        Task(const unsigned long scheduledUptimeMillis, const bool isCallbackTask)
-          : scheduledUptimeMillis(scheduledUptimeMillis), isCallbackTask(isCallbackTask), next(NULL) {
+        // MODIFIED from next(NULL), scheduled in micros
+        Task(const uint64_t scheduledUptimeMicros, const bool isCallbackTask)
+          : scheduledUptimeMicros(scheduledUptimeMicros), isCallbackTask(isCallbackTask),
+            atFront(false), heapIndex(NOT_IN_HEAP), id(0),
+            periodMicros(0), overrunPolicy(OVERRUN_SKIP), overrunCount(0),
+            hasNextRun(false), nextRunMicros(0) {
         }
         void execute() {
           // do in base class to prevent virtual method
@@ -264,23 +581,36 @@ class Scheduler {
             return !task->isCallbackTask && ((RunnableTask*)task)->runnable == ((RunnableTask*)this)->runnable;
           }
         }
-        const unsigned long scheduledUptimeMillis;
+        // MODIFIED from const unsigned long scheduledUptimeMillis; to allow rescheduling in micros
+        uint64_t scheduledUptimeMicros;
         // dynamic_cast is not supported by default as it compiles with -fno-rtti
         // Therefore, we use this variable to detect which Task type it is.
         const bool isCallbackTask;
-        Task *next;
+        // MODIFIED replaced Task *next; with the position in the heap
+        // Scheduled by scheduleAtFrontOfQueue(), runs before every other task regardless of its time
+        bool atFront;
+        unsigned int heapIndex;
+        // Order of insertion, breaks ties between equal times and identifies the task for TaskHandle
+        unsigned long id;
+        // 0 for tasks that run once
+        unsigned long periodMicros;
+        OverrunPolicy overrunPolicy;
+        unsigned long overrunCount;
+        // Set by setNextRun(), replaces the period once
+        bool hasNextRun;
+        uint64_t nextRunMicros;
     };
     class CallbackTask: public Task {
       public:
-        CallbackTask(void (*callback)(), const unsigned long scheduledUptimeMillis)
-          : Task(scheduledUptimeMillis, true), callback(callback) {
+        CallbackTask(void (*callback)(), const uint64_t scheduledUptimeMicros)
+          : Task(scheduledUptimeMicros, true), callback(callback) {
         }
         void (* const callback)();
     };
     class RunnableTask: public Task {
       public:
-        RunnableTask(Runnable *runnable, const unsigned long scheduledUptimeMillis)
-          : Task(scheduledUptimeMillis, false), runnable(runnable) {
+        RunnableTask(Runnable *runnable, const uint64_t scheduledUptimeMicros)
+          : Task(scheduledUptimeMicros, false), runnable(runnable) {
         }
         Runnable * const runnable;
     };
@@ -290,9 +620,107 @@ class Scheduler {
     */
     byte noSleepLocksCount;
 
-    void insertTask(Task *task);
-    void insertTaskAndRemoveExisting(Task *newTask);
-    void deleteTask(Task *taskToDelete, Task *previousTask);
+    // MODIFIED added the task pool, tasks are taken from a fixed slab
+    // and only fall back to the heap when it's exhausted
+    union TaskSlot {
+      TaskSlot *nextFree;
+      alignas(CallbackTask) byte callbackTask[sizeof(CallbackTask)];
+      alignas(RunnableTask) byte runnableTask[sizeof(RunnableTask)];
+    };
+    TaskSlot taskPool[TASK_POOL_SIZE];
+    TaskSlot *freeTaskSlots;
+    unsigned int taskPoolUsed;
+    unsigned int taskPoolHighWaterMark;
+    unsigned long taskHeapFallbackCount;
+
+    // Takes a slot from the pool or returns NULL, must be called with interrupts disabled
+    void *allocateTaskSlot();
+    Task *newCallbackTask(void (*callback)(), const uint64_t scheduledUptimeMicros);
+    Task *newRunnableTask(Runnable *runnable, const uint64_t scheduledUptimeMicros);
+    // Returns the task to the pool or the heap, must be called with interrupts disabled
+    void freeTask(Task *task);
+
+    // MODIFIED replaced the sorted linked list with a binary min heap ordered by (time, insertion order),
+    // the heap functions must be called with interrupts disabled
+    static const unsigned int NOT_IN_HEAP = (unsigned int)-1;
+    Task **heap;
+    unsigned int heapSize;
+    unsigned int heapCapacity;
+    unsigned long nextTaskId;
+
+    bool runsBefore(const Task *a, const Task *b) const;
+    void siftUp(unsigned int index);
+    void siftDown(unsigned int index);
+    void restoreHeap(unsigned int index);
+    void heapPush(Task *task);
+    Task *heapRemoveAt(unsigned int index);
+    // Removes every task for the same callback as task in O(n)
+    void removeMatching(const Task *task);
+    // Also finds the running task, which is not in the heap
+    Task *findTask(const TaskHandle &handle) const;
+    // Moves a periodic task to its next run on the ideal timeline, returns true if it overran
+    bool advancePeriodic(Task *task, uint64_t nowMicros);
+    unsigned long periodicOverrunCount;
+    unsigned long periodicSkippedCount;
+
+    // MODIFIED added utilization
+    uint64_t busyMicros;
+    uint64_t idleMicros;
+    uint64_t utilizationWindowStartMicros;
+    unsigned int utilizationPermille;
+    unsigned int idlePermille;
+    void updateUtilization();
+
+#ifdef ESP32
+    // MODIFIED added one scheduler per core
+    static Scheduler *coreSchedulers[portNUM_PROCESSORS];
+    static Scheduler *timedOutScheduler;
+    // The FreeRTOS task running execute(), notified by post() from the other core
+    std::atomic<TaskHandle_t> executingTask;
+    // Blocks on a task notification until the next task is due
+    void idleUntilNextTask();
+
+    // Bounded multiple producer single consumer ring (Vyukov's sequenced cells)
+    static_assert(POST_QUEUE_SIZE >= 2 && (POST_QUEUE_SIZE & (POST_QUEUE_SIZE - 1)) == 0, "POST_QUEUE_SIZE must be a power of 2");
+    struct PostCell {
+      std::atomic<uint32_t> seq;
+      void *target;
+      bool isCallbackTask;
+    };
+    PostCell postQueue[POST_QUEUE_SIZE];
+    std::atomic<uint32_t> postEnqueuePos;
+    uint32_t postDequeuePos;
+    std::atomic<uint32_t> postOverflowCount;
+
+    bool postTask(void *target, bool isCallbackTask);
+    // Moves posted tasks to the run queue, only called by the executing core
+    void drainPosted();
+#endif
+
+#ifdef TASK_STATS
+    // MODIFIED added per task statistics, keyed by the callback or Runnable
+    struct TaskStatsEntry {
+      const void *key;
+      bool isCallbackTask;
+      TaskStats stats;
+    };
+    TaskStatsEntry taskStats[TASK_STATS_SIZE];
+    unsigned int taskStatsCount;
+    unsigned long untrackedRunCount;
+
+    // Finds or adds the entry, returns NULL when the table is full, must be called with interrupts disabled
+    TaskStatsEntry *getTaskStatsEntry(const void *key, bool isCallbackTask, bool add);
+    // The callback or the stats Runnable, a Runnable may be gone once it ran so this is taken before
+    static const void *getTaskStatsKey(const Task *task);
+    void recordTaskRun(const void *key, bool isCallbackTask, uint32_t runCycles, uint32_t jitterMicros, bool overran);
+    static void addToHistogram(uint16_t *histogram, uint32_t micros);
+    // Defined by the platform implementation
+    uint32_t getCycleCount() const;
+#endif
+    bool isPoolTask(const Task *task) const;
+
+    TaskHandle insertTask(Task *task);
+    TaskHandle insertTaskAndRemoveExisting(Task *newTask);
 
   private:
     enum SleepMode {
@@ -309,10 +737,7 @@ class Scheduler {
       currently set task timeout
     */
     TaskTimeout taskTimeout;
-    /**
-      first element in the run queue
-    */
-    Task *first;
+    // MODIFIED removed Task *first; the run queue is the heap
     /*
       the task currently running or null if none running
     */
@@ -361,6 +786,11 @@ Scheduler scheduler;
 #ifdef SUPERVISION_CALLBACK
 Runnable *Scheduler::supervisionCallbackRunnable;
 #endif
+#ifdef ESP32
+// MODIFIED added one scheduler per core
+Scheduler *Scheduler::coreSchedulers[portNUM_PROCESSORS];
+Scheduler *Scheduler::timedOutScheduler;
+#endif
 
 Scheduler::Scheduler() {
 #ifdef AWAKE_INDICATION_PIN
@@ -368,79 +798,281 @@ Scheduler::Scheduler() {
 #endif
   taskTimeout = TIMEOUT_8S;
 
-  first = NULL;
+  // MODIFIED from first = NULL;
+  heapCapacity = TASK_POOL_SIZE;
+  heap = (Task **)malloc(heapCapacity * sizeof(Task *));
+  heapSize = 0;
+  nextTaskId = 1;
+  periodicOverrunCount = 0;
+  periodicSkippedCount = 0;
+#ifdef TASK_STATS
+  taskStatsCount = 0;
+  untrackedRunCount = 0;
+#endif
+  busyMicros = 0;
+  idleMicros = 0;
+  utilizationWindowStartMicros = 0;
+  utilizationPermille = 0;
+  idlePermille = 0;
+#ifdef ESP32
+  executingTask.store(NULL);
+  for (uint32_t i = 0; i < POST_QUEUE_SIZE; i++) {
+    postQueue[i].seq.store(i, std::memory_order_relaxed);
+  }
+  postEnqueuePos.store(0, std::memory_order_relaxed);
+  postDequeuePos = 0;
+  postOverflowCount.store(0, std::memory_order_relaxed);
+#endif
   current = NULL;
   noSleepLocksCount = 0;
 
+  // MODIFIED added the task pool
+  freeTaskSlots = NULL;
+  for (int i = TASK_POOL_SIZE - 1; i >= 0; i--) {
+    taskPool[i].nextFree = freeTaskSlots;
+    freeTaskSlots = &taskPool[i];
+  }
+  taskPoolUsed = 0;
+  taskPoolHighWaterMark = 0;
+  taskHeapFallbackCount = 0;
+
   init();
 }
 
-void Scheduler::schedule(void (*callback)()) {
-  Task *newTask = new CallbackTask(callback, getMillis());
-  insertTask(newTask);
+void *Scheduler::allocateTaskSlot() {
+  TaskSlot *slot = freeTaskSlots;
+  if (slot == NULL) {
+    taskHeapFallbackCount++;
+    return NULL;
+  }
+  freeTaskSlots = slot->nextFree;
+  taskPoolUsed++;
+  if (taskPoolUsed > taskPoolHighWaterMark) {
+    taskPoolHighWaterMark = taskPoolUsed;
+  }
+  return slot;
+}
+
+Scheduler::Task *Scheduler::newCallbackTask(void (*callback)(), const uint64_t scheduledUptimeMicros) {
+  noInterrupts();
+  void *slot = allocateTaskSlot();
+  interrupts();
+  if (slot == NULL) {
+    return new CallbackTask(callback, scheduledUptimeMicros);
+  }
+  return new (slot) CallbackTask(callback, scheduledUptimeMicros);
+}
+
+Scheduler::Task *Scheduler::newRunnableTask(Runnable *runnable, const uint64_t scheduledUptimeMicros) {
+  noInterrupts();
+  void *slot = allocateTaskSlot();
+  interrupts();
+  if (slot == NULL) {
+    return new RunnableTask(runnable, scheduledUptimeMicros);
+  }
+  return new (slot) RunnableTask(runnable, scheduledUptimeMicros);
+}
+
+void Scheduler::freeTask(Task *task) {
+  if (isPoolTask(task)) {
+    TaskSlot *slot = reinterpret_cast<TaskSlot *>(task);
+    // Tasks are trivially destructible, the slot is reused as is
+    slot->nextFree = freeTaskSlots;
+    freeTaskSlots = slot;
+    taskPoolUsed--;
+  } else if (task->isCallbackTask) {
+    delete (CallbackTask*)task;
+  } else {
+    delete (RunnableTask*)task;
+  }
+}
+
+unsigned int Scheduler::getTaskPoolUsed() const {
+  return taskPoolUsed;
+}
+
+unsigned int Scheduler::getTaskPoolHighWaterMark() const {
+  return taskPoolHighWaterMark;
+}
+
+unsigned long Scheduler::getTaskHeapFallbackCount() const {
+  return taskHeapFallbackCount;
+}
+
+unsigned int Scheduler::getQueuedTaskCount() const {
+  return heapSize;
+}
+
+unsigned long Scheduler::getPeriodicOverrunCount() const {
+  return periodicOverrunCount;
+}
+
+unsigned long Scheduler::getPeriodicSkippedCount() const {
+  return periodicSkippedCount;
+}
+
+TaskHandle Scheduler::schedule(void (*callback)()) {
+  Task *newTask = newCallbackTask(callback, getMicros());
+  return insertTask(newTask);
+}
+
+TaskHandle Scheduler::schedule(Runnable *runnable) {
+  Task *newTask = newRunnableTask(runnable, getMicros());
+  return insertTask(newTask);
+}
+
+TaskHandle Scheduler::scheduleOnce(void (*callback)()) {
+  Task *newTask = newCallbackTask(callback, getMicros());
+  return insertTaskAndRemoveExisting(newTask);
+}
+
+TaskHandle Scheduler::scheduleOnce(Runnable *runnable) {
+  Task *newTask = newRunnableTask(runnable, getMicros());
+  return insertTaskAndRemoveExisting(newTask);
 }
 
-void Scheduler::schedule(Runnable *runnable) {
-  Task *newTask = new RunnableTask(runnable, getMillis());
-  insertTask(newTask);
+TaskHandle Scheduler::scheduleDelayed(void (*callback)(), unsigned long delayMillis) {
+  Task *newTask = newCallbackTask(callback, getMicros() + (uint64_t)delayMillis * 1000);
+  return insertTask(newTask);
 }
 
-void Scheduler::scheduleOnce(void (*callback)()) {
-  Task *newTask = new CallbackTask(callback, getMillis());
-  insertTaskAndRemoveExisting(newTask);
+TaskHandle Scheduler::scheduleDelayed(Runnable *runnable, unsigned long delayMillis) {
+  Task *newTask = newRunnableTask(runnable, getMicros() + (uint64_t)delayMillis * 1000);
+  return insertTask(newTask);
 }
 
-void Scheduler::scheduleOnce(Runnable *runnable) {
-  Task *newTask = new RunnableTask(runnable, getMillis());
-  insertTaskAndRemoveExisting(newTask);
+TaskHandle Scheduler::scheduleDelayedMicros(void (*callback)(), unsigned long delayMicros) {
+  Task *newTask = newCallbackTask(callback, getMicros() + delayMicros);
+  return insertTask(newTask);
 }
 
-void Scheduler::scheduleDelayed(void (*callback)(), unsigned long delayMillis) {
-  Task *newTask = new CallbackTask(callback, getMillis() + delayMillis);
-  insertTask(newTask);
+TaskHandle Scheduler::scheduleDelayedMicros(Runnable *runnable, unsigned long delayMicros) {
+  Task *newTask = newRunnableTask(runnable, getMicros() + delayMicros);
+  return insertTask(newTask);
 }
 
-void Scheduler::scheduleDelayed(Runnable *runnable, unsigned long delayMillis) {
-  Task *newTask = new RunnableTask(runnable, getMillis() + delayMillis);
-  insertTask(newTask);
+TaskHandle Scheduler::schedulePeriodic(void (*callback)(), unsigned long periodMicros, OverrunPolicy overrunPolicy) {
+  Task *newTask = newCallbackTask(callback, getMicros() + periodMicros);
+  newTask->periodMicros = periodMicros;
+  newTask->overrunPolicy = overrunPolicy;
+  return insertTask(newTask);
 }
 
-void Scheduler::scheduleAt(void (*callback)(), unsigned long uptimeMillis) {
-  Task *newTask = new CallbackTask(callback, uptimeMillis);
-  insertTask(newTask);
+TaskHandle Scheduler::schedulePeriodic(Runnable *runnable, unsigned long periodMicros, OverrunPolicy overrunPolicy) {
+  Task *newTask = newRunnableTask(runnable, getMicros() + periodMicros);
+  newTask->periodMicros = periodMicros;
+  newTask->overrunPolicy = overrunPolicy;
+  return insertTask(newTask);
 }
 
-void Scheduler::scheduleAt(Runnable *runnable, unsigned long uptimeMillis) {
-  Task *newTask = new RunnableTask(runnable, uptimeMillis);
-  insertTask(newTask);
+TaskHandle Scheduler::scheduleAt(void (*callback)(), unsigned long uptimeMillis) {
+  Task *newTask = newCallbackTask(callback, (uint64_t)uptimeMillis * 1000);
+  return insertTask(newTask);
 }
 
-void Scheduler::scheduleAtFrontOfQueue(void (*callback)()) {
-  Task *newTask = new CallbackTask(callback, getMillis());
+TaskHandle Scheduler::scheduleAt(Runnable *runnable, unsigned long uptimeMillis) {
+  Task *newTask = newRunnableTask(runnable, (uint64_t)uptimeMillis * 1000);
+  return insertTask(newTask);
+}
+
+TaskHandle Scheduler::scheduleAtFrontOfQueue(void (*callback)()) {
+  Task *newTask = newCallbackTask(callback, getMicros());
+  newTask->atFront = true;
+  return insertTask(newTask);
+}
+
+TaskHandle Scheduler::scheduleAtFrontOfQueue(Runnable *runnable) {
+  Task *newTask = newRunnableTask(runnable, getMicros());
+  newTask->atFront = true;
+  return insertTask(newTask);
+}
+
+bool Scheduler::cancel(const TaskHandle &handle) {
   noInterrupts();
-  newTask->next = first;
-  first = newTask;
+  Task *task = findTask(handle);
+  if (task == current) {
+    // the running task is freed by executeNextIfTime() once it's not periodic anymore
+    if (task != NULL && task->periodMicros == 0) {
+      task = NULL;
+    } else if (task != NULL) {
+      task->periodMicros = 0;
+    }
+  } else if (task != NULL) {
+    freeTask(heapRemoveAt(task->heapIndex));
+  }
   interrupts();
+  return task != NULL;
 }
 
-void Scheduler::scheduleAtFrontOfQueue(Runnable *runnable) {
-  Task *newTask = new RunnableTask(runnable, getMillis());
+bool Scheduler::reschedule(const TaskHandle &handle, unsigned long uptimeMillis) {
   noInterrupts();
-  newTask->next = first;
-  first = newTask;
+  Task *task = findTask(handle);
+  if (task != NULL) {
+    if (task == current) {
+      // only tasks waiting in the heap can be moved
+      task = NULL;
+    } else {
+      task->scheduledUptimeMicros = (uint64_t)uptimeMillis * 1000;
+      task->atFront = false;
+      restoreHeap(task->heapIndex);
+    }
+  }
   interrupts();
+  return task != NULL;
+}
+
+bool Scheduler::setPeriod(const TaskHandle &handle, unsigned long periodMicros) {
+  noInterrupts();
+  Task *task = findTask(handle);
+  if (task != NULL && task->periodMicros != 0) {
+    task->periodMicros = periodMicros;
+  } else {
+    task = NULL;
+  }
+  interrupts();
+  return task != NULL;
+}
+
+// MODIFIED added
+bool Scheduler::setNextRun(const TaskHandle &handle, uint64_t uptimeMicros) {
+  noInterrupts();
+  Task *task = findTask(handle);
+  bool set = task != NULL && task == current && task->periodMicros != 0;
+  if (set) {
+    task->hasNextRun = true;
+    task->nextRunMicros = uptimeMicros;
+  }
+  interrupts();
+  return set;
+}
+
+unsigned long Scheduler::getOverrunCount(const TaskHandle &handle) const {
+  noInterrupts();
+  Task *task = findTask(handle);
+  unsigned long overrunCount = task != NULL ? task->overrunCount : 0;
+  interrupts();
+  return overrunCount;
+}
+
+bool Scheduler::isScheduled(const TaskHandle &handle) const {
+  noInterrupts();
+  Task *task = findTask(handle);
+  // a running task is only still scheduled if it's periodic
+  bool scheduled = task != NULL && (task != current || task->periodMicros != 0);
+  interrupts();
+  return scheduled;
 }
 
 bool Scheduler::isScheduled(void (*callback)()) const {
   bool scheduled = false;
   noInterrupts();
-  Task *currentTask = first;
-  while (currentTask != NULL) {
+  // MODIFIED scans the heap array instead of the list
+  for (unsigned int i = 0; i < heapSize; i++) {
+    Task *currentTask = heap[i];
     if (currentTask->isCallbackTask && ((CallbackTask*)currentTask)->callback == callback) {
       scheduled = true;
       break;
     }
-    currentTask = currentTask->next;
   }
   interrupts();
   return scheduled;
@@ -449,74 +1081,42 @@ bool Scheduler::isScheduled(void (*callback)()) const {
 bool Scheduler::isScheduled(Runnable *runnable) const {
   bool scheduled = false;
   noInterrupts();
-  Task *currentTask = first;
-  while (currentTask != NULL) {
+  // MODIFIED scans the heap array instead of the list
+  for (unsigned int i = 0; i < heapSize; i++) {
+    Task *currentTask = heap[i];
     if (!currentTask->isCallbackTask && ((RunnableTask*)currentTask)->runnable == runnable) {
       scheduled = true;
       break;
     }
-    currentTask = currentTask->next;
   }
   interrupts();
   return scheduled;
 }
 
 unsigned long Scheduler::getScheduleTimeOfCurrentTask() const {
+  // MODIFIED no longer returns with interrupts disabled
+  unsigned long scheduledUptimeMillis = 0;
   noInterrupts();
   if (current != NULL) {
-    return current->scheduledUptimeMillis;
+    scheduledUptimeMillis = current->scheduledUptimeMicros / 1000;
   }
   interrupts();
-  return 0;
+  return scheduledUptimeMillis;
 }
 
 void Scheduler::removeCallbacks(void (*callback)()) {
+  // MODIFIED removes from the heap
+  CallbackTask match(callback, 0);
   noInterrupts();
-  if (first != NULL) {
-    Task *previousTask = NULL;
-    Task *currentTask = first;
-    while (currentTask != NULL) {
-      if (currentTask->isCallbackTask && ((CallbackTask*)currentTask)->callback == callback) {
-        Task *taskToDelete = currentTask;
-        if (previousTask == NULL) {
-          // remove the first task
-          first = taskToDelete->next;
-        } else {
-          previousTask->next = taskToDelete->next;
-        }
-        currentTask = taskToDelete->next;
-        delete taskToDelete;
-      } else {
-        previousTask = currentTask;
-        currentTask = currentTask->next;
-      }
-    }
-  }
+  removeMatching(&match);
   interrupts();
 }
 
 void Scheduler::removeCallbacks(Runnable *runnable) {
+  // MODIFIED removes from the heap
+  RunnableTask match(runnable, 0);
   noInterrupts();
-  if (first != NULL) {
-    Task *previousTask = NULL;
-    Task *currentTask = first;
-    while (currentTask != NULL) {
-      if (!currentTask->isCallbackTask && ((RunnableTask*)currentTask)->runnable == runnable) {
-        Task *taskToDelete = currentTask;
-        if (previousTask == NULL) {
-          // remove the first task
-          first = taskToDelete->next;
-        } else {
-          previousTask->next = taskToDelete->next;
-        }
-        currentTask = taskToDelete->next;
-        delete taskToDelete;
-      } else {
-        previousTask = currentTask;
-        currentTask = currentTask->next;
-      }
-    }
-  }
+  removeMatching(&match);
   interrupts();
 }
 
@@ -540,86 +1140,413 @@ void Scheduler::setTaskTimeout(TaskTimeout taskTimeout) {
   interrupts();
 }
 
-// Inserts a new task in the ordered lists of tasks.
-void Scheduler::insertTask(Task *newTask) {
+// MODIFIED replaced the list insertion with the heap
+// Inserts a new task in the heap of tasks.
+TaskHandle Scheduler::insertTask(Task *newTask) {
   noInterrupts();
-  if (first == NULL) {
-    first = newTask;
+  newTask->id = nextTaskId++;
+  heapPush(newTask);
+  interrupts();
+  return TaskHandle(newTask, newTask->id);
+}
+
+// Inserts a new task in the heap of tasks and remove all existing tasks with the same callback
+TaskHandle Scheduler::insertTaskAndRemoveExisting(Task *newTask) {
+  noInterrupts();
+  removeMatching(newTask);
+  newTask->id = nextTaskId++;
+  heapPush(newTask);
+  interrupts();
+  return TaskHandle(newTask, newTask->id);
+}
+
+bool Scheduler::runsBefore(const Task *a, const Task *b) const {
+  if (a->atFront != b->atFront) {
+    return a->atFront;
+  }
+  if (a->atFront) {
+    // the last one put at the front runs first, same as the list did
+    return (long)(a->id - b->id) > 0;
+  }
+  if (a->scheduledUptimeMicros != b->scheduledUptimeMicros) {
+    return a->scheduledUptimeMicros < b->scheduledUptimeMicros;
+  }
+  return (long)(a->id - b->id) < 0;
+}
+
+void Scheduler::siftUp(unsigned int index) {
+  Task *task = heap[index];
+  while (index > 0) {
+    unsigned int parent = (index - 1) / 2;
+    if (!runsBefore(task, heap[parent])) {
+      break;
+    }
+    heap[index] = heap[parent];
+    heap[index]->heapIndex = index;
+    index = parent;
+  }
+  heap[index] = task;
+  task->heapIndex = index;
+}
+
+void Scheduler::siftDown(unsigned int index) {
+  Task *task = heap[index];
+  while (true) {
+    unsigned int child = index * 2 + 1;
+    if (child >= heapSize) {
+      break;
+    }
+    if (child + 1 < heapSize && runsBefore(heap[child + 1], heap[child])) {
+      child++;
+    }
+    if (!runsBefore(heap[child], task)) {
+      break;
+    }
+    heap[index] = heap[child];
+    heap[index]->heapIndex = index;
+    index = child;
+  }
+  heap[index] = task;
+  task->heapIndex = index;
+}
+
+void Scheduler::restoreHeap(unsigned int index) {
+  if (index > 0 && runsBefore(heap[index], heap[(index - 1) / 2])) {
+    siftUp(index);
   } else {
-    if (first->scheduledUptimeMillis > newTask->scheduledUptimeMillis) {
-      // insert before first
-      newTask->next = first;
-      first = newTask;
+    siftDown(index);
+  }
+}
+
+void Scheduler::heapPush(Task *task) {
+  if (heapSize == heapCapacity) {
+    // only reached when more tasks are queued than the pool holds
+    heapCapacity *= 2;
+    heap = (Task **)realloc(heap, heapCapacity * sizeof(Task *));
+  }
+  heap[heapSize] = task;
+  heapSize++;
+  siftUp(heapSize - 1);
+}
+
+Scheduler::Task *Scheduler::heapRemoveAt(unsigned int index) {
+  Task *task = heap[index];
+  heapSize--;
+  if (index != heapSize) {
+    heap[index] = heap[heapSize];
+    heap[index]->heapIndex = index;
+    restoreHeap(index);
+  }
+  task->heapIndex = NOT_IN_HEAP;
+  return task;
+}
+
+void Scheduler::removeMatching(const Task *task) {
+  if (current != NULL && current->equalCallback((Task *)task)) {
+    // don't schedule the running task again if it's periodic
+    current->periodMicros = 0;
+  }
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < heapSize; i++) {
+    Task *currentTask = heap[i];
+    if (currentTask->equalCallback((Task *)task)) {
+      currentTask->heapIndex = NOT_IN_HEAP;
+      freeTask(currentTask);
     } else {
-      Task *previousTask = first;
-      while (previousTask->next != NULL
-             && previousTask->next->scheduledUptimeMillis <= newTask->scheduledUptimeMillis) {
-        previousTask = previousTask->next;
-      }
-      // insert after previousTask
-      newTask->next = previousTask->next;
-      previousTask->next = newTask;
+      heap[kept] = currentTask;
+      currentTask->heapIndex = kept;
+      kept++;
+    }
+  }
+  if (kept != heapSize) {
+    heapSize = kept;
+    for (unsigned int i = heapSize / 2; i > 0; i--) {
+      siftDown(i - 1);
     }
   }
-  interrupts();
 }
 
-// Inserts a new task in the ordered lists of tasks and remove all existing tasks with the same callback
-void Scheduler::insertTaskAndRemoveExisting(Task *newTask) {
-  noInterrupts();
+bool Scheduler::advancePeriodic(Task *task, uint64_t nowMicros) {
+  if (task->hasNextRun) {
+    task->hasNextRun = false;
+    task->scheduledUptimeMicros = task->nextRunMicros;
+    task->atFront = false;
+    return false;
+  }
+  uint64_t next = task->scheduledUptimeMicros + task->periodMicros;
+  bool overran = next <= nowMicros;
+  if (overran) {
+    task->overrunCount++;
+    periodicOverrunCount++;
+    if (task->overrunPolicy == OVERRUN_SKIP) {
+      uint64_t missed = (nowMicros - next) / task->periodMicros + 1;
+      next += missed * task->periodMicros;
+      periodicSkippedCount += missed;
+    }
+    // OVERRUN_CATCH_UP keeps next in the past so it runs again right away
+  }
+  task->scheduledUptimeMicros = next;
+  task->atFront = false;
+  return overran;
+}
 
-  // remove first if it has the same callback as we insert
-  while (first != NULL && first->equalCallback(newTask)) {
-    deleteTask(first, NULL);
+// MODIFIED added utilization
+void Scheduler::updateUtilization() {
+  const uint64_t windowMicros = 1000000;
+  uint64_t now = getMicros();
+  uint64_t elapsed = now - utilizationWindowStartMicros;
+  if (elapsed >= windowMicros) {
+    utilizationPermille = busyMicros >= elapsed ? 1000 : (unsigned int)(busyMicros * 1000 / elapsed);
+    idlePermille = idleMicros >= elapsed ? 1000 : (unsigned int)(idleMicros * 1000 / elapsed);
+    busyMicros = 0;
+    idleMicros = 0;
+    utilizationWindowStartMicros = now;
   }
-  // here first is not equal to the one we insert
+}
 
-  if (first == NULL) {
-    first = newTask;
-  } else {
-    if (first->scheduledUptimeMillis > newTask->scheduledUptimeMillis) {
-      // insert before first
-      newTask->next = first;
-      first = newTask;
+unsigned int Scheduler::getUtilizationPermille() const {
+  return utilizationPermille;
+}
+
+unsigned int Scheduler::getIdlePermille() const {
+  return idlePermille;
+}
+
+#ifdef ESP32
+// MODIFIED added one scheduler per core
+void Scheduler::executeOnCore(BaseType_t core, uint32_t stackSize, UBaseType_t priority) {
+  xTaskCreatePinnedToCore([](void *arg) {
+    ((Scheduler *)arg)->execute();
+  }, "Scheduler", stackSize, this, priority, NULL, core);
+}
+
+Scheduler *Scheduler::forCore(BaseType_t core) {
+  return core >= 0 && core < portNUM_PROCESSORS ? coreSchedulers[core] : NULL;
+}
+
+Scheduler &Scheduler::forCurrentCore() {
+  Scheduler *coreScheduler = coreSchedulers[xPortGetCoreID()];
+  return coreScheduler != NULL ? *coreScheduler : scheduler;
+}
+
+Scheduler *Scheduler::getTimedOutScheduler() {
+  return timedOutScheduler;
+}
+
+bool IRAM_ATTR Scheduler::post(void (*callback)()) {
+  return postTask((void *)callback, true);
+}
+
+bool IRAM_ATTR Scheduler::post(Runnable *runnable) {
+  return postTask((void *)runnable, false);
+}
+
+unsigned long Scheduler::getPostOverflowCount() const {
+  return postOverflowCount.load(std::memory_order_relaxed);
+}
+
+bool IRAM_ATTR Scheduler::postTask(void *target, bool isCallbackTask) {
+  uint32_t pos = postEnqueuePos.load(std::memory_order_relaxed);
+  PostCell *cell;
+  while (true) {
+    cell = &postQueue[pos & (POST_QUEUE_SIZE - 1)];
+    int32_t diff = (int32_t)(cell->seq.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (postEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      postOverflowCount.fetch_add(1, std::memory_order_relaxed);
+      return false;
     } else {
-      Task *previousTask = first;
-      while (previousTask->next != NULL
-             && previousTask->next->scheduledUptimeMillis <= newTask->scheduledUptimeMillis) {
-        if (previousTask->next->equalCallback(newTask)) {
-          deleteTask(previousTask->next, previousTask);
-          // previousTask->next was deleted so we keep previousTask
-          // and will check the next previousTask->next on next loop
-        } else {
-          previousTask = previousTask->next;
-        }
+      pos = postEnqueuePos.load(std::memory_order_relaxed);
+    }
+  }
+  cell->target = target;
+  cell->isCallbackTask = isCallbackTask;
+  cell->seq.store(pos + 1, std::memory_order_release);
+  TaskHandle_t task = executingTask.load();
+  if (task != NULL) {
+    if (xPortInIsrContext()) {
+      BaseType_t woken = pdFALSE;
+      vTaskNotifyGiveFromISR(task, &woken);
+      if (woken) {
+        portYIELD_FROM_ISR();
       }
-      // insert after previousTask
-      newTask->next = previousTask->next;
-      previousTask->next = newTask;
+    } else {
+      xTaskNotifyGive(task);
     }
+  }
+  return true;
+}
 
-    // delete all existing tasks after the insert one
-    Task *previousTask = newTask;
-    while (previousTask->next != NULL) {
-      if (previousTask->next->equalCallback(newTask)) {
-        deleteTask(previousTask->next, previousTask);
-      } else {
-        previousTask = previousTask->next;
-      }
+void Scheduler::drainPosted() {
+  while (true) {
+    PostCell &cell = postQueue[postDequeuePos & (POST_QUEUE_SIZE - 1)];
+    if (cell.seq.load(std::memory_order_acquire) != postDequeuePos + 1) {
+      break;
     }
+    void *target = cell.target;
+    bool isCallbackTask = cell.isCallbackTask;
+    cell.seq.store(postDequeuePos + POST_QUEUE_SIZE, std::memory_order_release);
+    postDequeuePos++;
+    if (isCallbackTask) {
+      schedule((void (*)())target);
+    } else {
+      schedule((Runnable *)target);
+    }
+  }
+}
+#endif
+
+#ifdef TASK_STATS
+// MODIFIED added per task statistics
+Scheduler::TaskStatsEntry *Scheduler::getTaskStatsEntry(const void *key, bool isCallbackTask, bool add) {
+  for (unsigned int i = 0; i < taskStatsCount; i++) {
+    if (taskStats[i].key == key && taskStats[i].isCallbackTask == isCallbackTask) {
+      return &taskStats[i];
+    }
+  }
+  if (!add || taskStatsCount == TASK_STATS_SIZE) {
+    return NULL;
   }
+  TaskStatsEntry *entry = &taskStats[taskStatsCount];
+  memset(entry, 0, sizeof(TaskStatsEntry));
+  entry->key = key;
+  entry->isCallbackTask = isCallbackTask;
+  entry->stats.minRunCycles = UINT32_MAX;
+  taskStatsCount++;
+  return entry;
+}
+
+const void *Scheduler::getTaskStatsKey(const Task *task) {
+  return task->isCallbackTask
+    ? (const void *)((const CallbackTask*)task)->callback
+    : (const void *)((const RunnableTask*)task)->runnable->getStatsRunnable();
+}
 
+void Scheduler::addToHistogram(uint16_t *histogram, uint32_t micros) {
+  unsigned int bucket = micros == 0 ? 0 : 32 - __builtin_clz(micros);
+  if (bucket >= TASK_STATS_BUCKETS) {
+    bucket = TASK_STATS_BUCKETS - 1;
+  }
+  if (histogram[bucket] != UINT16_MAX) {
+    histogram[bucket]++;
+  }
+}
+
+void Scheduler::recordTaskRun(const void *key, bool isCallbackTask, uint32_t runCycles, uint32_t jitterMicros, bool overran) {
+  TaskStatsEntry *entry = getTaskStatsEntry(key, isCallbackTask, true);
+  if (entry == NULL) {
+    untrackedRunCount++;
+    return;
+  }
+  TaskStats &stats = entry->stats;
+  stats.runCount++;
+  if (runCycles < stats.minRunCycles) {
+    stats.minRunCycles = runCycles;
+  }
+  if (runCycles > stats.maxRunCycles) {
+    stats.maxRunCycles = runCycles;
+  }
+  stats.totalRunCycles += runCycles;
+  if (jitterMicros > stats.maxJitterMicros) {
+    stats.maxJitterMicros = jitterMicros;
+  }
+  stats.totalJitterMicros += jitterMicros;
+  if (overran) {
+    stats.overrunCount++;
+  }
+  addToHistogram(stats.runHistogram, runCycles / getCyclesPerMicro());
+  addToHistogram(stats.jitterHistogram, jitterMicros);
+}
+
+void Scheduler::setTaskName(void (*callback)(), const char *name) {
+  noInterrupts();
+  TaskStatsEntry *entry = getTaskStatsEntry((const void *)callback, true, true);
+  if (entry != NULL) {
+    entry->stats.name = name;
+  }
   interrupts();
 }
 
-void Scheduler::deleteTask(Task *taskToDelete, Task *previousTask) {
-  if (previousTask == NULL) {
-    // remove the first task
-    first = taskToDelete->next;
-  } else {
-    previousTask->next = taskToDelete->next;
+void Scheduler::setTaskName(Runnable *runnable, const char *name) {
+  noInterrupts();
+  TaskStatsEntry *entry = getTaskStatsEntry((const void *)runnable->getStatsRunnable(), false, true);
+  if (entry != NULL) {
+    entry->stats.name = name;
+  }
+  interrupts();
+}
+
+const char *Scheduler::getCurrentTaskName() const {
+  // no critical section as this is called from the watchdog interrupt
+  Task *task = current;
+  if (task == NULL) {
+    return NULL;
+  }
+  TaskStatsEntry *entry = const_cast<Scheduler *>(this)->getTaskStatsEntry(getTaskStatsKey(task), task->isCallbackTask, false);
+  return entry != NULL ? entry->stats.name : NULL;
+}
+
+unsigned int Scheduler::getTaskStatsCount() const {
+  return taskStatsCount;
+}
+
+bool Scheduler::getTaskStats(unsigned int index, TaskStats &stats) const {
+  noInterrupts();
+  bool found = index < taskStatsCount;
+  if (found) {
+    stats = taskStats[index].stats;
+  }
+  interrupts();
+  return found;
+}
+
+void Scheduler::resetTaskStats() {
+  noInterrupts();
+  for (unsigned int i = 0; i < taskStatsCount; i++) {
+    const char *name = taskStats[i].stats.name;
+    memset(&taskStats[i].stats, 0, sizeof(TaskStats));
+    taskStats[i].stats.name = name;
+    taskStats[i].stats.minRunCycles = UINT32_MAX;
   }
-  delete taskToDelete;
+  untrackedRunCount = 0;
+  interrupts();
+}
+
+unsigned long Scheduler::getUntrackedRunCount() const {
+  return untrackedRunCount;
+}
+#endif
+
+bool Scheduler::isPoolTask(const Task *task) const {
+  const TaskSlot *slot = reinterpret_cast<const TaskSlot *>(task);
+  return slot >= &taskPool[0] && slot < &taskPool[TASK_POOL_SIZE];
+}
+
+Scheduler::Task *Scheduler::findTask(const TaskHandle &handle) const {
+  Task *task = (Task *)handle.task;
+  if (task == NULL) {
+    return NULL;
+  }
+  if (task == current) {
+    return task->id == handle.id ? task : NULL;
+  }
+  if (isPoolTask(task)) {
+    // pool memory stays valid after the task is freed, so the task can be checked in place
+    if (task->heapIndex < heapSize && heap[task->heapIndex] == task && task->id == handle.id) {
+      return task;
+    }
+    return NULL;
+  }
+  // tasks that fell back to the heap may already be deleted, only compare the pointer until found
+  for (unsigned int i = 0; i < heapSize; i++) {
+    if (heap[i] == task) {
+      return task->id == handle.id ? task : NULL;
+    }
+  }
+  return NULL;
 }
 
 void Scheduler::setupTaskTimeoutIfConfigured() {
@@ -635,22 +1562,48 @@ void Scheduler::setupTaskTimeoutIfConfigured() {
 
 bool Scheduler::executeNextIfTime() {
   noInterrupts();
-  if (first != NULL && first->scheduledUptimeMillis <= getMillis()) {
-    current = first;
-    first = current->next;
+  // MODIFIED pops the heap instead of the list
+  if (heapSize != 0 && (heap[0]->atFront || heap[0]->scheduledUptimeMicros <= getMicros())) {
+    current = heapRemoveAt(0);
   }
   interrupts();
 
   if (current != NULL) {
     taskWdtReset();
+    // MODIFIED added utilization and per task statistics
+    const uint64_t startMicros = getMicros();
+#ifdef TASK_STATS
+    const uint32_t jitterMicros = startMicros > current->scheduledUptimeMicros
+      ? (uint32_t)(startMicros - current->scheduledUptimeMicros) : 0;
+    const void *statsKey = getTaskStatsKey(current);
+    const uint32_t startCycles = getCycleCount();
+#endif
     current->execute();
+#ifdef TASK_STATS
+    const uint32_t runCycles = getCycleCount() - startCycles;
+#endif
     taskWdtReset();
 #ifdef SLEEP_DELAY
     // use millis() instead of getMillis() because getMillis() may be manipulated by our WTD interrupt.
     lastTaskFinishedMillis = millis();
 #endif
-    delete current;
+    // MODIFIED periodic tasks are put back in the heap instead of being deleted
+    uint64_t nowMicros = getMicros();
+    busyMicros += nowMicros - startMicros;
     noInterrupts();
+    bool overran = false;
+    if (current->periodMicros != 0) {
+      overran = advancePeriodic(current, nowMicros);
+    }
+#ifdef TASK_STATS
+    recordTaskRun(statsKey, current->isCallbackTask, runCycles, jitterMicros, overran);
+#endif
+    if (current->periodMicros != 0) {
+      heapPush(current);
+    } else {
+      // MODIFIED from delete current; freed inside the critical section as the free list is shared
+      freeTask(current);
+    }
     current = NULL;
     interrupts();
     return true;
@@ -681,12 +1634,23 @@ void Scheduler::reactivateTaskTimeoutIfRequired() {
 }
 
 void Scheduler::execute() {
+#ifdef ESP32
+  // MODIFIED registered for forCore() and forCurrentCore()
+  coreSchedulers[xPortGetCoreID()] = this;
+  executingTask.store(xTaskGetCurrentTaskHandle());
+#endif
   setupTaskTimeoutIfConfigured();
   while (true) {
+#ifdef ESP32
+    // MODIFIED added cross core posting
+    drainPosted();
+#endif
     bool hasExecuted = executeNextIfTime();
     while (hasExecuted) {
       hasExecuted = executeNextIfTime();
     }
+    // MODIFIED added utilization
+    updateUtilization();
 
     sleepIfRequired();
     reactivateTaskTimeoutIfRequired();
@@ -26,6 +26,22 @@ unsigned long Scheduler::getMillis() const {
   return value;
 }
 
+// MODIFIED added, AVR only keeps time in millis
+uint64_t Scheduler::getMicros() const {
+  return (uint64_t)getMillis() * 1000;
+}
+
+#ifdef TASK_STATS
+// MODIFIED added for per task statistics, AVR has no cycle counter so micros are counted instead
+uint32_t Scheduler::getCycleCount() const {
+  return micros();
+}
+
+uint32_t Scheduler::getCyclesPerMicro() const {
+  return 1;
+}
+#endif
+
 void Scheduler::taskWdtEnable(const uint8_t value) {
   wdt_enable(value);
 }
@@ -52,7 +68,8 @@ void Scheduler::sleepIfRequired() {
   // but continue execution immediatelly.
   sleep_enable(); // enables the sleep bit, a safety pin
   noInterrupts();
-  bool queueEmpty = first == NULL;
+  // MODIFIED from bool queueEmpty = first == NULL;
+  bool queueEmpty = heapSize == 0;
   interrupts();
   SleepMode sleepMode = IDLE;
   if (!queueEmpty) {
@@ -108,8 +125,9 @@ inline Scheduler::SleepMode Scheduler::evaluateSleepModeAndEnableWdtIfRequired()
   unsigned long currentSchedulerMillis = getMillis();
 
   unsigned long firstScheduledUptimeMillis = 0;
-  if (first != NULL) {
-    firstScheduledUptimeMillis = first->scheduledUptimeMillis;
+  // MODIFIED from first, the heap root is the next task
+  if (heapSize != 0) {
+    firstScheduledUptimeMillis = heap[0]->scheduledUptimeMicros / 1000;
   }
   interrupts();
 
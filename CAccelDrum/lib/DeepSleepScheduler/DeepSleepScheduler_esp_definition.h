@@ -20,6 +20,8 @@ public:
     Do not call this method, it is used by the watchdog interrupt.
 */
 static void IRAM_ATTR isrWatchdogExpiredStatic();
+// MODIFIED sets timedOutScheduler
+friend void IRAM_ATTR isrWatchdogExpired(void *arg);
 private:
 hw_timer_t *timer = NULL;
 #elif ESP8266
@@ -2,6 +2,8 @@
 #ifdef ESP32
 #include <esp_sleep.h>
 #include <esp32-hal-timer.h>
+// MODIFIED included esp_timer.h for esp_timer_get_time()
+#include <esp_timer.h>
 // MODIFIED included ets_sys.h for ets_printf()
 #include <rom/ets_sys.h>
 #include <soc/rtc.h>
@@ -18,14 +20,27 @@ void Scheduler::init() {}
 
 #ifdef ESP32
 // -------------------------------------------------------------------------------------------------
+// MODIFIED from reading the RTC slow clock (150 kHz and drifts by several percent),
+// esp_timer runs from the APB clock and is advanced by the sleep time after light sleep
 unsigned long Scheduler::getMillis() const {
-  // read RTC clock which runs from initial boot/reset (also during sleep)
-  // https://forum.makehackvoid.com/t/playing-with-the-esp-32/1144/11
-  uint64_t rtcTime = rtc_time_get();
-  uint64_t rtcTimeUs = rtcTime * 20 / 3;  // ticks -> us 1,000,000/150,000
-  return rtcTimeUs / 1000;
+  return getMicros() / 1000;
 }
 
+uint64_t Scheduler::getMicros() const {
+  return esp_timer_get_time();
+}
+
+#ifdef TASK_STATS
+// MODIFIED added for per task statistics
+uint32_t Scheduler::getCycleCount() const {
+  return ESP.getCycleCount();
+}
+
+uint32_t Scheduler::getCyclesPerMicro() const {
+  return getCpuFrequencyMhz();
+}
+#endif
+
 void IRAM_ATTR Scheduler::isrWatchdogExpiredStatic() {
 #ifdef SUPERVISION_CALLBACK
   if (supervisionCallbackRunnable != NULL) {
@@ -42,10 +57,36 @@ void IRAM_ATTR Scheduler::isrWatchdogExpiredStatic() {
 /**
    Interrupt service routine called when the timer expires.
 */
-void IRAM_ATTR isrWatchdogExpired() {
+// MODIFIED from void IRAM_ATTR isrWatchdogExpired(), the argument is the scheduler that timed out
+void IRAM_ATTR isrWatchdogExpired(void *arg) {
+  Scheduler::timedOutScheduler = (Scheduler *)arg;
   Scheduler::isrWatchdogExpiredStatic();
 }
 
+// MODIFIED added, the loop used to spin through yield() until the next task was due
+void Scheduler::idleUntilNextTask() {
+  noInterrupts();
+  const bool queueEmpty = heapSize == 0;
+  const uint64_t nextMicros = queueEmpty ? 0 : heap[0]->scheduledUptimeMicros;
+  const TaskTimeout taskTimeoutLocal = taskTimeout;
+  interrupts();
+  const uint64_t tickMicros = portTICK_PERIOD_MS * 1000;
+  const uint64_t startMicros = getMicros();
+  uint64_t waitMicros = queueEmpty ? UINT64_MAX : (nextMicros > startMicros ? nextMicros - startMicros : 0);
+  if (taskTimeoutLocal != NO_SUPERVISION) {
+    // wake up in time to feed the task watchdog
+    waitMicros = min(waitMicros, (uint64_t)wdtTimeoutToDurationMs(taskTimeoutLocal) * 1000 / 2);
+  }
+  if (waitMicros < tickMicros) {
+    // a tick is the shortest block, spin for anything due sooner
+    yield();
+    return;
+  }
+  // rounded down so the task is never started late, the remainder is spun
+  ulTaskNotifyTake(pdTRUE, (TickType_t)min(waitMicros / tickMicros, (uint64_t)portMAX_DELAY));
+  idleMicros += getMicros() - startMicros;
+}
+
 void Scheduler::taskWdtEnable(const uint8_t value) {
   if (value != NO_SUPERVISION) {
     const unsigned long durationMs = wdtTimeoutToDurationMs(value);
@@ -55,7 +96,7 @@ void Scheduler::taskWdtEnable(const uint8_t value) {
       // MODIFIED freq is default clock of 80Mhz with divisor or 80 = 1Mhz
       timer = timerBegin(1'000'000);
       // MODIFIED from timerAttachInterrupt(timer, &isrWatchdogExpired, true);
-      timerAttachInterrupt(timer, &isrWatchdogExpired);
+      timerAttachInterruptArg(timer, &isrWatchdogExpired, this);
     }
     //set time in us
     // MODIFIED from timerAlarmWrite(timer, durationMs * 1000, false);
@@ -93,6 +134,22 @@ unsigned long Scheduler::getMillis() const {
   return millis();
 }
 
+// MODIFIED added
+uint64_t Scheduler::getMicros() const {
+  return micros64();
+}
+
+#ifdef TASK_STATS
+// MODIFIED added for per task statistics
+uint32_t Scheduler::getCycleCount() const {
+  return ESP.getCycleCount();
+}
+
+uint32_t Scheduler::getCyclesPerMicro() const {
+  return ESP.getCpuFreqMHz();
+}
+#endif
+
 void Scheduler::taskWdtEnable(const uint8_t value) {
   const unsigned long durationMs = wdtTimeoutToDurationMs(value);
   ESP.wdtEnable(durationMs);
@@ -161,7 +218,8 @@ inline unsigned long Scheduler::wdtTimeoutToDurationMs(const uint8_t value) {
 
 void Scheduler::sleepIfRequired() {
   noInterrupts();
-  bool queueEmpty = first == NULL;
+  // MODIFIED from bool queueEmpty = first == NULL;
+  bool queueEmpty = heapSize == 0;
   interrupts();
   SleepMode sleepMode = IDLE;
   if (!queueEmpty) {
@@ -188,8 +246,9 @@ void Scheduler::sleepIfRequired() {
       unsigned long currentSchedulerMillis = getMillis();
 
       unsigned long firstScheduledUptimeMillis = 0;
-      if (first != NULL) {
-        firstScheduledUptimeMillis = first->scheduledUptimeMillis;
+      // MODIFIED from first, the heap root is the next task
+      if (heapSize != 0) {
+        firstScheduledUptimeMillis = heap[0]->scheduledUptimeMicros / 1000;
       }
 
       unsigned long maxWaitTimeMillis = 0;
@@ -200,7 +259,12 @@ void Scheduler::sleepIfRequired() {
 
       sleep(maxWaitTimeMillis, queueEmpty);
     } else { // IDLE
+#ifdef ESP32
+      // MODIFIED from yield(), blocks instead of spinning through the loop
+      idleUntilNextTask();
+#else
       yield();
+#endif
     }
     // THE PROGRAM CONTINUES FROM HERE AFTER WAKING UP
 #ifdef AWAKE_INDICATION_PIN
@@ -214,8 +278,9 @@ inline Scheduler::SleepMode Scheduler::evaluateSleepMode() {
   unsigned long currentSchedulerMillis = getMillis();
 
   unsigned long firstScheduledUptimeMillis = 0;
-  if (first != NULL) {
-    firstScheduledUptimeMillis = first->scheduledUptimeMillis;
+  // MODIFIED from first, the heap root is the next task
+  if (heapSize != 0) {
+    firstScheduledUptimeMillis = heap[0]->scheduledUptimeMicros / 1000;
   }
   interrupts();
 
@@ -53,9 +53,19 @@
 #define Rw 0b00000010  // Read/Write bit
 #define Rs 0b00000001  // Register select bit
 
+// MODIFIED added, most bytes sent in one transaction, the Wire buffer of the esp32 holds 128
+#ifndef LCD_I2C_BATCH_SIZE
+#ifdef I2C_BUFFER_LENGTH
+#define LCD_I2C_BATCH_SIZE I2C_BUFFER_LENGTH
+#else
+#define LCD_I2C_BATCH_SIZE 32
+#endif
+#endif
+
 class LiquidCrystal_I2C : public Print {
 public:
-  LiquidCrystal_I2C(uint8_t lcd_Addr,uint8_t lcd_cols,uint8_t lcd_rows);
+  // MODIFIED added the bus, so the lcd can be moved off the default one
+  LiquidCrystal_I2C(uint8_t lcd_Addr,uint8_t lcd_cols,uint8_t lcd_rows,TwoWire &wire = Wire);
   void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS );
   void clear();
   void home();
@@ -84,12 +94,17 @@ public:
   void setCursor(uint8_t, uint8_t); 
 #if defined(ARDUINO) && ARDUINO >= 100
   virtual size_t write(uint8_t);
+  // MODIFIED added, sends the whole string in as few transactions as the Wire buffer allows
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
 #else
   virtual void write(uint8_t);
 #endif
   void command(uint8_t);
   void init();
   void oled_init();
+  // MODIFIED added, bytes put on the bus including the address byte of each transaction
+  uint32_t getBytesWritten() const { return _bytesWritten; }
 
 ////compatibility API function aliases
 void blink_on();						// alias for blink()
@@ -115,9 +130,12 @@ void draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixe
 private:
   void init_priv();
   void send(uint8_t, uint8_t);
+  void sendBatch(const uint8_t *values, size_t size, uint8_t mode); // MODIFIED added
+  void writeBatch(const uint8_t *bytes, size_t size); // MODIFIED added
   void write4bits(uint8_t);
   void expanderWrite(uint8_t);
   void pulseEnable(uint8_t);
+  TwoWire *_wire; // MODIFIED added
   uint8_t _Addr;
   uint8_t _displayfunction;
   uint8_t _displaycontrol;
@@ -127,6 +145,7 @@ private:
   uint8_t _cols;
   uint8_t _rows;
   uint8_t _backlightval;
+  uint32_t _bytesWritten = 0; // MODIFIED added
 };
 
 #endif
@@ -0,0 +1,81 @@
+# Generates logdict.json from the LOG_* calls in src, so host tools can turn Log packets back into text,
+# ids are the 32 bit FNV-1a of the format string like Log::idOf() in src/Utils/Log.h,
+# runs before every build as a pio extra script, or standalone with python scripts/gen_logdict.py
+import json
+import os
+import re
+
+LEVELS = {"DEBUG": "Debug", "INFO": "Info", "WARN": "Warn", "ERROR": "Error"}
+CALL = re.compile(r'\bLOG_(DEBUG|INFO|WARN|ERROR)\s*\(\s*"((?:[^"\\\n]|\\.)*)"')
+ESCAPES = {"n": "\n", "t": "\t", "r": "\r", "0": "\0", "\\": "\\", "\"": "\"", "'": "'"}
+
+
+def unescape(literal):
+    out = bytearray()
+    i = 0
+    while i < len(literal):
+        c = literal[i]
+        if c == "\\" and i + 1 < len(literal):
+            n = literal[i + 1]
+            if n == "x":
+                digits = re.match(r"[0-9a-fA-F]+", literal[i + 2:]).group(0)
+                out.append(int(digits, 16) & 0xFF)
+                i += 2 + len(digits)
+                continue
+            out += ESCAPES.get(n, n).encode()
+            i += 2
+            continue
+        out += c.encode()
+        i += 1
+    return bytes(out)
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def generate(projectDir):
+    srcDir = os.path.join(projectDir, "src")
+    entries = {}
+    for root, _, files in os.walk(srcDir):
+        for name in sorted(files):
+            if not name.endswith((".cpp", ".h")):
+                continue
+            path = os.path.join(root, name)
+            with open(path, encoding="utf-8") as f:
+                text = f.read()
+            for m in CALL.finditer(text):
+                lineStart = text.rfind("\n", 0, m.start()) + 1
+                if text[lineStart:m.start()].lstrip().startswith("//"):
+                    continue  # Example in a comment
+                fmt = unescape(m.group(2))
+                key = "%08x" % fnv1a(fmt)
+                entry = {
+                    "level": LEVELS[m.group(1)],
+                    "format": fmt.decode("utf-8"),
+                    "file": os.path.relpath(path, projectDir).replace(os.sep, "/"),
+                    "line": text.count("\n", 0, m.start()) + 1,
+                }
+                old = entries.get(key)
+                if old and old["format"] != entry["format"]:
+                    raise Exception("Log format id collision between %s:%d and %s:%d"
+                                    % (old["file"], old["line"], entry["file"], entry["line"]))
+                entries.setdefault(key, entry)
+    out = os.path.join(projectDir, "logdict.json")
+    content = json.dumps({"version": 1, "entries": dict(sorted(entries.items()))}, indent=2, ensure_ascii=False)
+    if not os.path.exists(out) or open(out, encoding="utf-8").read() != content:
+        with open(out, "w", encoding="utf-8") as f:
+            f.write(content)
+    print("logdict.json: %d formats" % len(entries))
+
+
+try:
+    Import("env")
+    projectDir = env.subst("$PROJECT_DIR")
+except NameError:
+    projectDir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+generate(projectDir)
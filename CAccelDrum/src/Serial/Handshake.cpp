@@ -0,0 +1,56 @@
+#include <Arduino.h>
+#include "Serial/Handshake.h"
+#include "Serial/PacketLayout.h"
+#include "Serial/SerialManager.h"
+#include "Serial/Subscriptions.h"
+#include "Utils/Log.h"
+#include "Utils/PacketUtils.h"
+
+namespace Handshake
+{
+    static bool peerIncompatible = false;
+    static uint32_t sharedCapabilities = capabilities;
+    static Co::Mailbox<HelloPacket> hellos;
+
+    static void handleHello(const HelloPacket &host)
+    {
+        peerIncompatible = host.layoutHash != PacketLayout::hash;
+        sharedCapabilities = peerIncompatible ? 0 : host.capabilities & capabilities;
+        if (peerIncompatible)
+        {
+            // Whatever it subscribed to so far it reads as garbage
+            Subscriptions::clear();
+            LOG_WARN("Host layout hash {} differs from {}, refused", host.layoutHash, PacketLayout::hash);
+        }
+        PacketUtils::send(PacketType::Hello, HelloPacket{
+            .firmwareVersion = firmwareVersion,
+            .layoutHash = PacketLayout::hash,
+            .capabilities = capabilities,
+            .baudRate = SerialManager::baudRate,
+            .accepted = !peerIncompatible});
+    }
+
+    void receiveHello(const HelloPacket &host)
+    {
+        if (hellos.isAwaited())
+            hellos.put(host);
+        else
+            handleHello(host);
+    }
+
+    Co::Task serve()
+    {
+        while (true)
+            handleHello(co_await hellos);
+    }
+
+    bool isPeerIncompatible()
+    {
+        return peerIncompatible;
+    }
+
+    uint32_t getSharedCapabilities()
+    {
+        return sharedCapabilities;
+    }
+}
\ No newline at end of file
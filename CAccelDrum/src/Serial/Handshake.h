@@ -0,0 +1,31 @@
+#pragma once
+#include <Arduino.h>
+#include "SerialPackets.h"
+#include "Utils/Coroutine.h"
+
+// The device's side of the hello exchange, the host says hello on connect and gets the device's hello back,
+// a host with a different layout hash is told it wasn't accepted and gets no streams until a matching one says hello,
+// called on the sampling core
+namespace Handshake
+{
+    // major << 16 | minor
+    constexpr uint32_t firmwareVersion = (1 << 16) | 0;
+
+    constexpr uint32_t capabilities = HelloPacket::CapReliableStreams | HelloPacket::CapDeferredLog |
+        HelloPacket::CapSubscriptions | HelloPacket::CapSensorConfig | HelloPacket::CapBootProfile |
+        HelloPacket::CapTelemetry;
+
+    // Hands a host's hello over to serve(), answered right away if serve() couldn't be started
+    void receiveHello(const HelloPacket &host);
+
+    // Answers the hellos for as long as the firmware runs, start it on the sampling core
+    Co::Task serve();
+
+    // True from a hello with a different layout hash until one with a matching hash,
+    // a host that never says hello is trusted
+    bool isPeerIncompatible();
+
+    // Capabilities both ends have, all of the device's until a host says hello,
+    // without CapReliableStreams packets are sent unacked, without CapDeferredLog logs are sent as text
+    uint32_t getSharedCapabilities();
+}
\ No newline at end of file
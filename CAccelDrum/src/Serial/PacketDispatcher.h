@@ -0,0 +1,93 @@
+#pragma once
+#include <Arduino.h>
+#include <array>
+#include "SerialPackets.h"
+#include "PacketView.h"
+
+using PacketHandler = void (*)(const SerialPacket &);
+
+namespace PacketDispatcherDetail
+{
+    template <typename THandler>
+    struct HandlerTraits;
+
+    template <typename T>
+    struct HandlerTraits<void (*)(PacketView<T>)>
+    {
+        using Inner = T;
+    };
+}
+
+// Binds a handler taking a PacketView<T> to a packet type
+template <PacketType packetType, auto handler>
+struct PacketRoute
+{
+    using Inner = typename PacketDispatcherDetail::HandlerTraits<decltype(handler)>::Inner;
+    static constexpr PacketType type = packetType;
+
+    static void invoke(const SerialPacket &packet)
+    {
+        handler(PacketView<Inner>(packet));
+    }
+};
+
+// Handler table built at compile time from the routes, dispatching is a single indexed call,
+// types without a route are counted instead of silently dropped
+template <typename... Routes>
+class PacketDispatcher
+{
+public:
+    // Returns false if the type is unknown or has no handler
+    bool dispatch(const SerialPacket &packet)
+    {
+        size_t index = (size_t)packet.type;
+        if (packet.type == PacketType::None || index >= table.size())
+        {
+            unknownCount++;
+            return false;
+        }
+        PacketHandler handler = table[index];
+        if (!handler)
+        {
+            unregisteredCount++;
+            return false;
+        }
+        handler(packet);
+        return true;
+    }
+
+    // None and types outside of PacketType
+    uint32_t getUnknownCount() const
+    {
+        return unknownCount;
+    }
+
+    // Valid types without a route
+    uint32_t getUnregisteredCount() const
+    {
+        return unregisteredCount;
+    }
+
+private:
+    static constexpr std::array<PacketHandler, (size_t)PacketType::Count> makeTable()
+    {
+        std::array<PacketHandler, (size_t)PacketType::Count> t{};
+        ((t[(size_t)Routes::type] = &Routes::invoke), ...);
+        return t;
+    }
+
+    static constexpr bool hasUniqueTypes()
+    {
+        std::array<bool, (size_t)PacketType::Count> seen{};
+        bool unique = true;
+        ((unique = unique && !seen[(size_t)Routes::type], seen[(size_t)Routes::type] = true), ...);
+        return unique;
+    }
+
+    static_assert(((Routes::type > PacketType::None && Routes::type < PacketType::Count) && ...), "Route has an invalid packet type");
+    static_assert(hasUniqueTypes(), "Packet type is routed more than once");
+
+    static constexpr std::array<PacketHandler, (size_t)PacketType::Count> table = makeTable();
+    uint32_t unknownCount = 0;
+    uint32_t unregisteredCount = 0;
+};
\ No newline at end of file
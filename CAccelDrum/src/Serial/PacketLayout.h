@@ -0,0 +1,422 @@
+#pragma once
+#include <Arduino.h>
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include "SerialPackets.h"
+
+// FNV-1a over the layout of every packet struct, compared by the hello handshake
+// so a host built against different packet definitions is refused instead of reading garbage,
+// PacketLayout.cs walks the C# structs by reflection and hashes them the same way:
+// the enum counts, then every struct as its size followed by its leaves in declaration order,
+// a scalar leaf is (offset, size, 1), an array of scalars is (offset, element size, length),
+// nested structs and arrays of structs are walked element by element
+namespace PacketLayout
+{
+    constexpr uint32_t fnv1a(uint32_t hash, uint32_t value)
+    {
+        for (uint32_t i = 0; i < sizeof(value); i++)
+        {
+            hash ^= (value >> (i * 8)) & 0xFF;
+            hash *= 16777619;
+        }
+        return hash;
+    }
+
+    struct Field
+    {
+        uint32_t offset;
+        uint32_t size;
+        // hashOf() of the field's type
+        uint32_t (*hash)(uint32_t hash, uint32_t offset);
+    };
+
+    // Fields of a struct in declaration order, every struct reached from a packet needs one,
+    // each list is checked to cover its struct without gaps
+    template <typename T>
+    struct Fields;
+
+    template <typename T>
+    struct ArrayOf
+    {
+        static constexpr bool isArray = false;
+    };
+
+    template <typename E, size_t N>
+    struct ArrayOf<std::array<E, N>>
+    {
+        static constexpr bool isArray = true;
+        using Element = E;
+        static constexpr size_t length = N;
+    };
+
+    template <typename E, size_t N>
+    struct ArrayOf<E[N]>
+    {
+        static constexpr bool isArray = true;
+        using Element = E;
+        static constexpr size_t length = N;
+    };
+
+    template <typename T>
+    constexpr bool isScalar = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+    template <typename T>
+    consteval bool coversWithoutGaps()
+    {
+        uint32_t next = 0;
+        for (const Field &field : Fields<T>::fields)
+        {
+            if (field.offset != next)
+                return false;
+            next += field.size;
+        }
+        return next == sizeof(T);
+    }
+
+    template <typename T>
+    constexpr uint32_t hashOf(uint32_t hash, uint32_t offset)
+    {
+        if constexpr (isScalar<T>)
+            return fnv1a(fnv1a(fnv1a(hash, offset), sizeof(T)), 1);
+        else if constexpr (ArrayOf<T>::isArray)
+        {
+            using E = typename ArrayOf<T>::Element;
+            if constexpr (isScalar<E>)
+                return fnv1a(fnv1a(fnv1a(hash, offset), sizeof(E)), ArrayOf<T>::length);
+            else
+            {
+                for (uint32_t i = 0; i < ArrayOf<T>::length; i++)
+                    hash = hashOf<E>(hash, offset + i * sizeof(E));
+                return hash;
+            }
+        }
+        else
+        {
+            static_assert(coversWithoutGaps<T>(), "Fields<T> misses a field or isn't in declaration order");
+            for (const Field &field : Fields<T>::fields)
+                hash = field.hash(hash, offset + field.offset);
+            return hash;
+        }
+    }
+
+    template <typename T>
+    constexpr uint32_t hashStruct(uint32_t hash)
+    {
+        return hashOf<T>(fnv1a(hash, sizeof(T)), 0);
+    }
+
+    template <typename... Ts>
+    constexpr uint32_t hashStructs(uint32_t hash, std::tuple<Ts...> *)
+    {
+        ((hash = hashStruct<Ts>(hash)), ...);
+        return hash;
+    }
+}
+
+#define PACKET_LAYOUT_FIELD(T, name) \
+    PacketLayout::Field{offsetof(T, name), sizeof(T::name), &PacketLayout::hashOf<decltype(T::name)>}
+
+template <>
+struct PacketLayout::Fields<SerialPacket>
+{
+    using T = SerialPacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, type),
+        PACKET_LAYOUT_FIELD(T, flags),
+        PACKET_LAYOUT_FIELD(T, seq),
+        PACKET_LAYOUT_FIELD(T, inner),
+        PACKET_LAYOUT_FIELD(T, crc32),
+        PACKET_LAYOUT_FIELD(T, magic)};
+};
+
+template <>
+struct PacketLayout::Fields<SerialPacket::Inner>
+{
+    using T = SerialPacket::Inner;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, data)};
+};
+
+template <>
+struct PacketLayout::Fields<AccelPacket>
+{
+    using T = AccelPacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, deltaMicros),
+        PACKET_LAYOUT_FIELD(T, ax),
+        PACKET_LAYOUT_FIELD(T, ay),
+        PACKET_LAYOUT_FIELD(T, az),
+        PACKET_LAYOUT_FIELD(T, gx),
+        PACKET_LAYOUT_FIELD(T, gy),
+        PACKET_LAYOUT_FIELD(T, gz),
+        PACKET_LAYOUT_FIELD(T, gw),
+        PACKET_LAYOUT_FIELD(T, ex),
+        PACKET_LAYOUT_FIELD(T, ey),
+        PACKET_LAYOUT_FIELD(T, ez),
+        PACKET_LAYOUT_FIELD(T, padding)};
+};
+
+template <>
+struct PacketLayout::Fields<RawAccelPacket::Pack>
+{
+    using T = RawAccelPacket::Pack;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, deltaMicros),
+        PACKET_LAYOUT_FIELD(T, ax),
+        PACKET_LAYOUT_FIELD(T, ay),
+        PACKET_LAYOUT_FIELD(T, az),
+        PACKET_LAYOUT_FIELD(T, gx),
+        PACKET_LAYOUT_FIELD(T, gy),
+        PACKET_LAYOUT_FIELD(T, gz)};
+};
+
+template <>
+struct PacketLayout::Fields<RawAccelPacket>
+{
+    using T = RawAccelPacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, packs),
+        PACKET_LAYOUT_FIELD(T, sensorMask),
+        PACKET_LAYOUT_FIELD(T, configGeneration),
+        PACKET_LAYOUT_FIELD(T, accelRanges),
+        PACKET_LAYOUT_FIELD(T, gyroRanges),
+        PACKET_LAYOUT_FIELD(T, padding)};
+};
+
+template <>
+struct PacketLayout::Fields<TextPacket>
+{
+    using T = TextPacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, length),
+        PACKET_LAYOUT_FIELD(T, hasNext),
+        PACKET_LAYOUT_FIELD(T, string)};
+};
+
+template <>
+struct PacketLayout::Fields<ConfigurePacket>
+{
+    using T = ConfigurePacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, type),
+        PACKET_LAYOUT_FIELD(T, value),
+        PACKET_LAYOUT_FIELD(T, data)};
+};
+
+template <>
+struct PacketLayout::Fields<ConfigurePacket::Settings>
+{
+    using T = ConfigurePacket::Settings;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, accelRange),
+        PACKET_LAYOUT_FIELD(T, gyroRange),
+        PACKET_LAYOUT_FIELD(T, accelFactoryTrims),
+        PACKET_LAYOUT_FIELD(T, gyroFactoryTrims)};
+};
+
+template <>
+struct PacketLayout::Fields<ConfigurePacket::SensorConfig>
+{
+    using T = ConfigurePacket::SensorConfig;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, accelRange),
+        PACKET_LAYOUT_FIELD(T, gyroRange),
+        PACKET_LAYOUT_FIELD(T, dlpfMode),
+        PACKET_LAYOUT_FIELD(T, rateDivider)};
+};
+
+template <>
+struct PacketLayout::Fields<ConfigurePacket::SensorConfigs>
+{
+    using T = ConfigurePacket::SensorConfigs;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, sensorMask),
+        PACKET_LAYOUT_FIELD(T, generation),
+        PACKET_LAYOUT_FIELD(T, sensors)};
+};
+
+template <>
+struct PacketLayout::Fields<ConfigurePacket::Subscription>
+{
+    using T = ConfigurePacket::Subscription;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, stream),
+        PACKET_LAYOUT_FIELD(T, rateHz),
+        PACKET_LAYOUT_FIELD(T, leaseMillis)};
+};
+
+template <>
+struct PacketLayout::Fields<ConfigurePacket::Subscriptions>
+{
+    using T = ConfigurePacket::Subscriptions;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, count),
+        PACKET_LAYOUT_FIELD(T, entries)};
+};
+
+template <>
+struct PacketLayout::Fields<AckPacket>
+{
+    using T = AckPacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, type),
+        PACKET_LAYOUT_FIELD(T, seq),
+        PACKET_LAYOUT_FIELD(T, padding)};
+};
+
+template <>
+struct PacketLayout::Fields<TaskStatsPacket>
+{
+    using T = TaskStatsPacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, index),
+        PACKET_LAYOUT_FIELD(T, count),
+        PACKET_LAYOUT_FIELD(T, core),
+        PACKET_LAYOUT_FIELD(T, coreBusyPermille),
+        PACKET_LAYOUT_FIELD(T, coreIdlePermille),
+        PACKET_LAYOUT_FIELD(T, name),
+        PACKET_LAYOUT_FIELD(T, runCount),
+        PACKET_LAYOUT_FIELD(T, minRunMicros),
+        PACKET_LAYOUT_FIELD(T, avgRunMicros),
+        PACKET_LAYOUT_FIELD(T, maxRunMicros),
+        PACKET_LAYOUT_FIELD(T, avgJitterMicros),
+        PACKET_LAYOUT_FIELD(T, maxJitterMicros),
+        PACKET_LAYOUT_FIELD(T, overrunCount),
+        PACKET_LAYOUT_FIELD(T, runHistogram),
+        PACKET_LAYOUT_FIELD(T, jitterHistogram),
+        PACKET_LAYOUT_FIELD(T, padding)};
+};
+
+template <>
+struct PacketLayout::Fields<LogPacket>
+{
+    using T = LogPacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, length),
+        PACKET_LAYOUT_FIELD(T, records)};
+};
+
+template <>
+struct PacketLayout::Fields<BootProfilePacket::Phase>
+{
+    using T = BootProfilePacket::Phase;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, phase),
+        PACKET_LAYOUT_FIELD(T, core),
+        PACKET_LAYOUT_FIELD(T, startMicros),
+        PACKET_LAYOUT_FIELD(T, endMicros)};
+};
+
+template <>
+struct PacketLayout::Fields<BootProfilePacket>
+{
+    using T = BootProfilePacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, count),
+        PACKET_LAYOUT_FIELD(T, phases),
+        PACKET_LAYOUT_FIELD(T, padding)};
+};
+
+template <>
+struct PacketLayout::Fields<HelloPacket>
+{
+    using T = HelloPacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, firmwareVersion),
+        PACKET_LAYOUT_FIELD(T, layoutHash),
+        PACKET_LAYOUT_FIELD(T, capabilities),
+        PACKET_LAYOUT_FIELD(T, baudRate),
+        PACKET_LAYOUT_FIELD(T, accepted),
+        PACKET_LAYOUT_FIELD(T, padding)};
+};
+
+template <>
+struct PacketLayout::Fields<TelemetryPacket::Task>
+{
+    using T = TelemetryPacket::Task;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, name),
+        PACKET_LAYOUT_FIELD(T, stackFreeMinBytes)};
+};
+
+template <>
+struct PacketLayout::Fields<TelemetryPacket>
+{
+    using T = TelemetryPacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, uptimeMillis),
+        PACKET_LAYOUT_FIELD(T, coreBusyPermille),
+        PACKET_LAYOUT_FIELD(T, freeHeap),
+        PACKET_LAYOUT_FIELD(T, minFreeHeap),
+        PACKET_LAYOUT_FIELD(T, largestFreeBlock),
+        PACKET_LAYOUT_FIELD(T, sampleSetsMilliHz),
+        PACKET_LAYOUT_FIELD(T, lcdFrames),
+        PACKET_LAYOUT_FIELD(T, lcdLastFrameBytes),
+        PACKET_LAYOUT_FIELD(T, lcdMaxFrameBytes),
+        PACKET_LAYOUT_FIELD(T, lcdAvgFrameBytes),
+        PACKET_LAYOUT_FIELD(T, taskCount),
+        PACKET_LAYOUT_FIELD(T, tasks),
+        PACKET_LAYOUT_FIELD(T, padding)};
+};
+
+template <>
+struct PacketLayout::Fields<LinkStatsPacket>
+{
+    using T = LinkStatsPacket;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, rxBytes),
+        PACKET_LAYOUT_FIELD(T, rxPackets),
+        PACKET_LAYOUT_FIELD(T, rxCorrupt),
+        PACKET_LAYOUT_FIELD(T, rxLost),
+        PACKET_LAYOUT_FIELD(T, rxOverflow),
+        PACKET_LAYOUT_FIELD(T, rxUnknown),
+        PACKET_LAYOUT_FIELD(T, rxUnregistered),
+        PACKET_LAYOUT_FIELD(T, rxBudgetExhausted),
+        PACKET_LAYOUT_FIELD(T, drainBudgetExhausted),
+        PACKET_LAYOUT_FIELD(T, maxDrainBatch),
+        PACKET_LAYOUT_FIELD(T, inboundHighWaterMark),
+        PACKET_LAYOUT_FIELD(T, txBytes),
+        PACKET_LAYOUT_FIELD(T, reliableDropped),
+        PACKET_LAYOUT_FIELD(T, retransmits),
+        PACKET_LAYOUT_FIELD(T, txClasses),
+        PACKET_LAYOUT_FIELD(T, padding)};
+};
+
+template <>
+struct PacketLayout::Fields<LinkStatsPacket::TxClassStats>
+{
+    using T = LinkStatsPacket::TxClassStats;
+    static constexpr std::array fields{
+        PACKET_LAYOUT_FIELD(T, sent),
+        PACKET_LAYOUT_FIELD(T, dropped),
+        PACKET_LAYOUT_FIELD(T, avgWaitMicros),
+        PACKET_LAYOUT_FIELD(T, maxWaitMicros)};
+};
+
+namespace PacketLayout
+{
+    // Inner struct of every packet type, in PacketType order from Accel
+    using PacketStructs = std::tuple<AccelPacket, RawAccelPacket, TextPacket, ConfigurePacket, AckPacket,
+        TaskStatsPacket, LogPacket, BootProfilePacket, HelloPacket, TelemetryPacket, LinkStatsPacket>;
+    static_assert(std::tuple_size_v<PacketStructs> == (size_t)PacketType::Count - 1, "Every packet type needs its struct here");
+
+    // Carried in ConfigurePacket::data
+    using ConfigureDataStructs = std::tuple<ConfigurePacket::Settings, ConfigurePacket::SensorConfigs,
+        ConfigurePacket::Subscriptions>;
+
+    constexpr uint32_t compute()
+    {
+        uint32_t hash = 2166136261;
+        for (uint32_t count : {(uint32_t)PacketType::Count, (uint32_t)ConfigurePacket::Type::Count,
+                 (uint32_t)ConfigurePacket::Val::Count, (uint32_t)StreamId::Count})
+            hash = fnv1a(hash, count);
+        hash = hashStruct<SerialPacket>(hash);
+        hash = hashStructs(hash, (PacketStructs *)nullptr);
+        hash = hashStructs(hash, (ConfigureDataStructs *)nullptr);
+        return hash;
+    }
+
+    constexpr uint32_t hash = compute();
+}
\ No newline at end of file
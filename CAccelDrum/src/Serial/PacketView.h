@@ -0,0 +1,54 @@
+#pragma once
+#include <Arduino.h>
+#include "SerialPackets.h"
+
+// Non-owning typed view over a received packet, the packet must outlive the view
+template <typename T>
+    requires(sizeof(T) == sizeof(SerialPacket::Inner))
+class PacketView
+{
+public:
+    using Inner = T;
+
+    explicit PacketView(const SerialPacket &packet) : packet(&packet)
+    {
+    }
+
+    const T &inner() const
+    {
+        return reinterpret_cast<const SerialPacketTyped<T> *>(packet)->inner;
+    }
+
+    const T &operator*() const
+    {
+        return inner();
+    }
+
+    const T *operator->() const
+    {
+        return &inner();
+    }
+
+    PacketType type() const
+    {
+        return packet->type;
+    }
+
+    uint8_t flags() const
+    {
+        return packet->flags;
+    }
+
+    uint16_t seq() const
+    {
+        return packet->seq;
+    }
+
+    const SerialPacket &raw() const
+    {
+        return *packet;
+    }
+
+private:
+    const SerialPacket *packet;
+};
\ No newline at end of file
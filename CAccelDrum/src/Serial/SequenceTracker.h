@@ -0,0 +1,82 @@
+#pragma once
+#include <Arduino.h>
+
+// Tracks the sequence numbers of one inbound stream,
+// remembers the last windowSize sequence numbers to tell late packets from duplicates
+class SequenceTracker
+{
+public:
+    static constexpr uint16_t windowSize = 32;
+
+    enum class Result
+    {
+        InOrder,
+        Gap,       // Some packets before this one are missing
+        Late,      // Arrived after a newer one, was counted as missing before
+        Duplicate, // Was already received
+        Resync     // Too far behind to be late, the peer has likely restarted the stream
+    };
+
+    // Sets missing to the number of packets skipped over by a gap
+    Result track(uint16_t seq, uint16_t &missing)
+    {
+        missing = 0;
+        if (!synced)
+        {
+            resync(seq);
+            return Result::InOrder;
+        }
+        int16_t diff = (int16_t)(seq - expected);
+        if (diff >= 0)
+        {
+            missing = diff;
+            received = diff + 1 >= windowSize ? 0 : received << (diff + 1);
+            received |= 1;
+            expected = seq + 1;
+            return diff == 0 ? Result::InOrder : Result::Gap;
+        }
+        // Bit n of received is set when (expected - 1 - n) was received
+        uint16_t age = expected - 1 - seq;
+        if (age >= windowSize)
+        {
+            resync(seq);
+            return Result::Resync;
+        }
+        uint32_t bit = (uint32_t)1 << age;
+        if (received & bit)
+            return Result::Duplicate;
+        received |= bit;
+        return Result::Late;
+    }
+
+    // True if seq was already received, doesn't track it
+    bool isDuplicate(uint16_t seq) const
+    {
+        if (!synced)
+            return false;
+        int16_t diff = (int16_t)(seq - expected);
+        if (diff >= 0)
+            return false;
+        uint16_t age = expected - 1 - seq;
+        return age < windowSize && (received & ((uint32_t)1 << age));
+    }
+
+    void reset()
+    {
+        synced = false;
+        expected = 0;
+        received = 0;
+    }
+
+private:
+    uint32_t received = 0;
+    uint16_t expected = 0;
+    bool synced = false;
+
+    void resync(uint16_t seq)
+    {
+        synced = true;
+        expected = seq + 1;
+        received = 1;
+    }
+};
\ No newline at end of file
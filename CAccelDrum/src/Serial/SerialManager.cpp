@@ -1,110 +1,353 @@
 #include <Arduino.h>
 #include "SerialManager.h"
 #include "SerialPackets.h"
-#include "Display/Display.h"
+#include "Handshake.h"
+#include "display/display.h"
 
 SerialManager serial;
 
 SerialManager::SerialManager() : parsingQueue(),
                                  inboundQueue(),
-                                 crcOut(),
                                  crcIn(),
                                  lastLong(0),
                                  packetCount(0),
                                  corruptedPacketCount(0),
-                                 inboundQueueMutex()
+                                 lostPacketCount(0),
+                                 latePacketCount(0),
+                                 duplicatePacketCount(0),
+                                 retransmitCount(0),
+                                 reliableDropCount(0),
+                                 outboundSeqs{},
+                                 inboundSeqs(),
+                                 retransmitWindow{},
+                                 retransmitWindowMux(portMUX_INITIALIZER_UNLOCKED),
+                                 tx(),
+                                 rxPending(false),
+                                 wakePending(false),
+                                 lastRxPollMillis(0),
+                                 inboundHandler(nullptr),
+                                 rxBudgetMicros(1000),
+                                 drainBudgetMicros(2000),
+                                 bytesReceived(0),
+                                 nativeBytesSent(0),
+                                 rxBudgetExhaustedCount(0),
+                                 drainBudgetExhaustedCount(0),
+                                 maxDrainBatch(0)
 {
 }
 
 void SerialManager::init()
 {
-    Serial.begin(1'000'000);
-    while (!Serial)
-        ;
+    // Keep the uart buffer short so queued packets wait in the tx scheduler where they can be reordered
+    Serial.setTxBufferSize(sizeof(SerialPacket) * TxScheduler::txBufferPackets);
+    Serial.begin(baudRate);
     while (Serial.available() && Serial.read())
         ;
+    // Called from the uart event task, only raises the flag and wakes run()
+    Serial.setRxFIFOFull(rxFifoThreshold);
+    Serial.onReceive([this]()
+    {
+        rxPending.store(true, std::memory_order_release);
+        wake();
+    });
+}
+
+void SerialManager::setInboundHandler(void (*handler)())
+{
+    inboundHandler = handler;
+}
+
+void SerialManager::setRxBudgetMicros(uint32_t micros)
+{
+    rxBudgetMicros = micros;
+}
+
+void SerialManager::setDrainBudgetMicros(uint32_t micros)
+{
+    drainBudgetMicros = micros;
+}
+
+void SerialManager::wake()
+{
+    if (wakePending.exchange(true, std::memory_order_acq_rel))
+        return;
+    // The poll fallback picks it up if the post queue is full
+    if (!scheduler.post(this))
+        wakePending.store(false, std::memory_order_release);
 }
 
 void SerialManager::run()
 {
-    scheduler.schedule(this);
+    wakePending.store(false, std::memory_order_release);
+    // This run replaces whichever one was still queued
+    scheduler.removeCallbacks(this);
     receive();
+    retransmitExpired();
+    tx.flush();
+    if (rxPending.load(std::memory_order_relaxed))
+        scheduler.schedule(this); // Rx budget ran out
+    else if (tx.hasQueued())
+        scheduler.scheduleDelayedMicros(this, txRetryMicros);
+    else
+        scheduler.scheduleDelayed(this, min(rxPollIntervalMillis, retransmitTimeoutMillis));
+}
+
+bool SerialManager::send(PacketType type, void* packet, size_t size)
+{
+    return send(type, packet, size, defaultTxClass(type));
 }
 
-void SerialManager::send(PacketType type, void* packet, size_t size)
+bool SerialManager::send(PacketType type, void* packet, size_t size, TxClass cls)
 {
     if (size != sizeof(SerialPacket::Inner))
-        return;
+        return false;
     SerialPacket::Inner &inner = *reinterpret_cast<SerialPacket::Inner *>(packet);
     if (!(type > PacketType::None && type < PacketType::Count))
-        return;
+        return false;
+    // A host without acks would have every reliable packet retransmitted until maxAttempts
+    bool reliable = isReliableStream(type) &&
+        (Handshake::getSharedCapabilities() & HelloPacket::CapReliableStreams);
     SerialPacket outPacket{
         .type = type,
+        .flags = reliable ? SerialPacket::FlagReliable : SerialPacket::FlagNone,
+        .seq = outboundSeqs[(size_t)type].fetch_add(1, std::memory_order_relaxed),
         .inner = inner,
         .magic = SerialPacket::magicExpected};
-    crcOut.restart();
-    crcOut.add(reinterpret_cast<uint8_t *>(&outPacket.type), sizeof(outPacket.type));
-    crcOut.add(reinterpret_cast<uint8_t *>(&outPacket.inner), sizeof(outPacket.inner));
-    outPacket.crc32 = crcOut.calc();
-    sendNative(outPacket);
+    stampCrc(outPacket);
+    // Refused rather than evicting an older one, which would drop it without the sender knowing
+    if (reliable && !trackOutbound(outPacket, cls))
+        return false;
+    // A tracked packet that doesn't fit is sent again by retransmitExpired()
+    bool queued = tx.enqueue(cls, outPacket);
+    tx.flush();
+    // Uart is full or the other core is flushing, make sure someone comes back for it
+    if (tx.hasQueued())
+        wake();
+    return queued || reliable;
+}
+
+void SerialManager::stampCrc(SerialPacket &packet)
+{
+    // Local so senders on both cores don't share state
+    CRC32 crc;
+    crc.add(reinterpret_cast<uint8_t *>(&packet), offsetof(SerialPacket, crc32));
+    packet.crc32 = crc.calc();
+}
+
+bool SerialManager::trackOutbound(SerialPacket &packet, TxClass cls)
+{
+    portENTER_CRITICAL(&retransmitWindowMux);
+    PendingPacket *slot = nullptr;
+    for (PendingPacket &pending : retransmitWindow)
+    {
+        if (!pending.inUse)
+        {
+            slot = &pending;
+            break;
+        }
+    }
+    if (!slot)
+    {
+        reliableDropCount++;
+        portEXIT_CRITICAL(&retransmitWindowMux);
+        return false;
+    }
+    *slot = PendingPacket{
+        .packet = packet,
+        .sentMillis = millis(),
+        .cls = cls,
+        .attempts = 1,
+        .inUse = true};
+    portEXIT_CRITICAL(&retransmitWindowMux);
+    return true;
+}
+
+void SerialManager::retransmitExpired()
+{
+    uint32_t now = millis();
+    // One entry at a time, the crc and the enqueue run after the critical section
+    // so interrupts on this core and the other core's senders aren't held up by them
+    for (PendingPacket &pending : retransmitWindow)
+    {
+        SerialPacket packet;
+        TxClass cls;
+        portENTER_CRITICAL(&retransmitWindowMux);
+        if (!pending.inUse || now - pending.sentMillis < retransmitTimeoutMillis)
+        {
+            portEXIT_CRITICAL(&retransmitWindowMux);
+            continue;
+        }
+        if (pending.attempts >= maxAttempts)
+        {
+            pending.inUse = false;
+            reliableDropCount++;
+            portEXIT_CRITICAL(&retransmitWindowMux);
+            continue;
+        }
+        pending.packet.flags |= SerialPacket::FlagRetransmit;
+        pending.sentMillis = now;
+        pending.attempts++;
+        retransmitCount++;
+        packet = pending.packet;
+        cls = pending.cls;
+        portEXIT_CRITICAL(&retransmitWindowMux);
+
+        // Acked in the meantime at worst, the host drops the extra copy as a duplicate
+        stampCrc(packet);
+        tx.enqueue(cls, packet);
+    }
+}
+
+void SerialManager::handleAck(AckPacket &ack)
+{
+    portENTER_CRITICAL(&retransmitWindowMux);
+    for (PendingPacket &pending : retransmitWindow)
+    {
+        if (pending.inUse &&
+            pending.packet.type == ack.type &&
+            pending.packet.seq == ack.seq)
+        {
+            pending.inUse = false;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&retransmitWindowMux);
 }
 
 void SerialManager::sendNative(SerialPacket &packet)
 {
-    Serial.write(reinterpret_cast<byte *>(&packet), sizeof(packet));
+    nativeBytesSent.fetch_add(Serial.write(reinterpret_cast<byte *>(&packet), sizeof(packet)), std::memory_order_relaxed);
 }
 
 void SerialManager::receive()
 {
-    const int maxBytesPerBatch = sizeof(SerialPacket) * 4;
-    int bytesRead = 0;
-    while (Serial.available() && bytesRead < maxBytesPerBatch)
+    uint32_t now = millis();
+    if (!rxPending.exchange(false, std::memory_order_acquire))
     {
-        bytesRead++;
-        int _int = Serial.read();
-        if (_int == -1)
+        if (now - lastRxPollMillis < rxPollIntervalMillis)
             return;
-        byte b = _int;
-        parsingQueue.push(b);
-        lastLong <<= 8;
-        lastLong |= b;
-        if (parsingQueue.size() > sizeof(SerialPacket))
-            parsingQueue.shift(); // pop() pops from the END of the buffer, which is what we just added
-        if (parsingQueue.size() == sizeof(SerialPacket) &&
-            lastLong == SerialPacket::magicExpectedReversed)
+    }
+    lastRxPollMillis = now;
+
+    Timer<Clocks::Micros> budget(rxBudgetMicros, true);
+    bool enqueued = false;
+    byte buf[64];
+    while (true)
+    {
+        int available = Serial.available();
+        if (available <= 0)
+            break;
+        if (budget.isElapsed())
         {
-            SerialPacket packet;
-            for (int i = 0; i < sizeof(SerialPacket); i++)
-                reinterpret_cast<byte *>(&packet)[i] = parsingQueue.shift();
-            tryEnqueueInbound(packet);
+            // Continue on the next run
+            rxBudgetExhaustedCount++;
+            rxPending.store(true, std::memory_order_relaxed);
+            break;
         }
+        size_t len = Serial.read(buf, min((size_t)available, sizeof(buf)));
+        bytesReceived += len;
+        for (size_t i = 0; i < len; i++)
+            enqueued |= parseByte(buf[i]);
     }
+    if (enqueued && inboundHandler)
+        scheduler.scheduleOnce(inboundHandler);
+}
+
+bool SerialManager::parseByte(byte b)
+{
+    parsingQueue.push(b);
+    lastLong <<= 8;
+    lastLong |= b;
+    if (parsingQueue.size() > sizeof(SerialPacket))
+        parsingQueue.shift(); // pop() pops from the END of the buffer, which is what we just added
+    if (parsingQueue.size() == sizeof(SerialPacket) &&
+        lastLong == SerialPacket::magicExpectedReversed)
+    {
+        SerialPacket packet;
+        for (size_t i = 0; i < sizeof(SerialPacket); i++)
+            reinterpret_cast<byte *>(&packet)[i] = parsingQueue.shift();
+        return tryEnqueueInbound(packet);
+    }
+    return false;
 }
 
 bool SerialManager::tryEnqueueInbound(SerialPacket &packet)
 {
     crcIn.restart();
-    crcIn.add(reinterpret_cast<uint8_t *>(&packet.type), sizeof(packet.type));
-    crcIn.add(reinterpret_cast<uint8_t *>(&packet.inner), sizeof(packet.inner));
+    crcIn.add(reinterpret_cast<uint8_t *>(&packet), offsetof(SerialPacket, crc32));
     uint32_t crc = crcIn.calc();
     if (crc != packet.crc32)
     {
         corruptedPacketCount++;
         return false;
     }
-    inboundQueue.push(packet);
     packetCount++;
+    // Left for the dispatcher to count, an unknown type has no sequence to track or ack
+    if (!(packet.type > PacketType::None && packet.type < PacketType::Count))
+        return inboundQueue.tryPush(packet);
+    if (inboundSeqs[(size_t)packet.type].isDuplicate(packet.seq))
+    {
+        duplicatePacketCount++;
+        // Acked again, the previous ack might have been the one lost
+        ackInbound(packet);
+        return false;
+    }
+    if (packet.type == PacketType::Ack)
+    {
+        trackInbound(packet);
+        handleAck(*reinterpret_cast<AckPacket *>(&packet.inner));
+        return true;
+    }
+    // Neither acked nor tracked when it doesn't fit, so the host sends a reliable one again
+    // and it isn't taken for a duplicate then
+    if (!inboundQueue.tryPush(packet))
+        return false;
+    ackInbound(packet);
+    trackInbound(packet);
     return true;
 }
 
-bool SerialManager::tryDequeueInbound(SerialPacket &outPacket)
+void SerialManager::ackInbound(SerialPacket &packet)
 {
-    if (inboundQueue.size() > 0)
+    if (!(packet.flags & SerialPacket::FlagReliable))
+        return;
+    AckPacket ack{
+        .type = packet.type,
+        .seq = packet.seq};
+    send(PacketType::Ack, &ack, sizeof(ack));
+}
+
+void SerialManager::trackInbound(SerialPacket &packet)
+{
+    uint16_t missing;
+    switch (inboundSeqs[(size_t)packet.type].track(packet.seq, missing))
     {
-        outPacket = inboundQueue.shift();
-        return true;
+        case SequenceTracker::Result::Gap:
+            lostPacketCount += missing;
+            break;
+        case SequenceTracker::Result::Late:
+            latePacketCount++;
+            if (lostPacketCount > 0)
+                lostPacketCount--;
+            break;
+        default:
+            break;
     }
-    return false;
+}
+
+bool SerialManager::tryDequeueInbound(SerialPacket &outPacket)
+{
+    return inboundQueue.tryPop(outPacket);
+}
+
+const SerialPacket *SerialManager::peekInbound()
+{
+    return inboundQueue.front();
+}
+
+void SerialManager::popInbound()
+{
+    inboundQueue.pop();
 }
 
 uint32_t SerialManager::getCorruptedPacketCount() const
@@ -115,4 +358,69 @@ uint32_t SerialManager::getCorruptedPacketCount() const
 uint32_t SerialManager::getPacketCount() const
 {
     return packetCount;
+}
+
+uint32_t SerialManager::getLostPacketCount() const
+{
+    return lostPacketCount;
+}
+
+uint32_t SerialManager::getLatePacketCount() const
+{
+    return latePacketCount;
+}
+
+uint32_t SerialManager::getDuplicatePacketCount() const
+{
+    return duplicatePacketCount;
+}
+
+uint32_t SerialManager::getRetransmitCount() const
+{
+    return retransmitCount;
+}
+
+uint32_t SerialManager::getReliableDropCount() const
+{
+    return reliableDropCount;
+}
+
+TxScheduler::ClassStats SerialManager::getTxStats(TxClass cls)
+{
+    return tx.getStats(cls);
+}
+
+uint32_t SerialManager::getInboundHighWaterMark() const
+{
+    return inboundQueue.getHighWaterMark();
+}
+
+uint32_t SerialManager::getInboundOverflowCount() const
+{
+    return inboundQueue.getOverflowCount();
+}
+
+uint32_t SerialManager::getBytesReceived() const
+{
+    return bytesReceived;
+}
+
+uint32_t SerialManager::getBytesSent() const
+{
+    return tx.getBytesSent() + nativeBytesSent.load(std::memory_order_relaxed);
+}
+
+uint32_t SerialManager::getRxBudgetExhaustedCount() const
+{
+    return rxBudgetExhaustedCount;
+}
+
+uint32_t SerialManager::getDrainBudgetExhaustedCount() const
+{
+    return drainBudgetExhaustedCount;
+}
+
+uint32_t SerialManager::getMaxDrainBatch() const
+{
+    return maxDrainBatch;
 }
\ No newline at end of file
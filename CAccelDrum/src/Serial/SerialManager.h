@@ -4,8 +4,13 @@
 #define LIBCALL_DEEP_SLEEP_SCHEDULER
 #include <DeepSleepScheduler.h>
 #include <CircularBuffer.hpp>
-#include <mutex>
+#include <array>
+#include <atomic>
 #include "SerialPackets.h"
+#include "SequenceTracker.h"
+#include "TxScheduler.h"
+#include "Utils/LockFreeQueue.h"
+#include "Utils/Timer.h"
 
 class SerialManager;
 extern SerialManager serial;
@@ -13,32 +18,168 @@ extern SerialManager serial;
 class SerialManager : public Runnable
 {
 public:
+    static constexpr uint32_t baudRate = 1'000'000;
+
     SerialManager();
 
     void init();
 
+    // Drains the uart into the inbound queue when the rx event or the poll fallback says there's data,
+    // then flushes the tx scheduler, runs on a single task,
+    // woken by the rx event or a send that couldn't be flushed instead of rescheduling itself right away
     virtual void run() override;
 
-    void send(PacketType type, void* packet, size_t size);
+    // Scheduled whenever new packets are put into the inbound queue
+    void setInboundHandler(void (*handler)());
+
+    // Time a single run() may spend reading and parsing the uart
+    void setRxBudgetMicros(uint32_t micros);
+
+    // Time a single drainInbound() may spend handling packets, at least one packet is always handled
+    void setDrainBudgetMicros(uint32_t micros);
+
+    // Consumer side, handles every queued packet in place until the queue is empty or the budget runs out,
+    // returns the number handled
+    template <typename THandler>
+    uint32_t drainInbound(THandler handler)
+    {
+        Timer<Clocks::Micros> budget(drainBudgetMicros, true);
+        uint32_t handled = 0;
+        while (const SerialPacket *packet = peekInbound())
+        {
+            if (handled > 0 && budget.isElapsed())
+            {
+                drainBudgetExhaustedCount++;
+                break;
+            }
+            handler(*packet);
+            popInbound();
+            handled++;
+        }
+        maxDrainBatch = max(maxDrainBatch, handled);
+        return handled;
+    }
+
+    // Safe to call from either core,
+    // queues the packet in its priority class, it's written once the classes before it are drained,
+    // returns false if it was dropped because its class queue or the retransmit window is full
+    bool send(PacketType type, void* packet, size_t size);
+
+    bool send(PacketType type, void* packet, size_t size, TxClass cls);
 
+    // Writes directly, bypassing the tx scheduler, still counted in getBytesSent()
     void sendNative(SerialPacket& packet);
 
+    // Consumer side of the inbound queue, call from a single task
     bool tryDequeueInbound(SerialPacket& outPacket);
 
+    // Consumer side, returns the oldest inbound packet in place without copying or nullptr,
+    // it stays valid until popInbound()
+    const SerialPacket* peekInbound();
+
+    // Consumer side, must follow a non null peekInbound()
+    void popInbound();
+
     uint32_t getPacketCount() const;
 
     uint32_t getCorruptedPacketCount() const;
 
+    // Inbound packets skipped over by sequence gaps, minus the ones that arrived late
+    uint32_t getLostPacketCount() const;
+
+    uint32_t getLatePacketCount() const;
+
+    uint32_t getDuplicatePacketCount() const;
+
+    // Outbound reliable packets sent again because their ack didn't arrive in time
+    uint32_t getRetransmitCount() const;
+
+    // Outbound reliable packets given up on after maxAttempts or refused by a full window
+    uint32_t getReliableDropCount() const;
+
+    // Sent counts and queueing latency per priority class
+    TxScheduler::ClassStats getTxStats(TxClass cls);
+
+    uint32_t getInboundHighWaterMark() const;
+
+    // Packets dropped because the inbound queue was full
+    uint32_t getInboundOverflowCount() const;
+
+    uint32_t getBytesReceived() const;
+
+    // Written to the uart by the tx scheduler and sendNative()
+    uint32_t getBytesSent() const;
+
+    // Times run() stopped reading with bytes still in the uart
+    uint32_t getRxBudgetExhaustedCount() const;
+
+    // Times drainInbound() stopped with packets still queued
+    uint32_t getDrainBudgetExhaustedCount() const;
+
+    // Most packets handled by one drainInbound()
+    uint32_t getMaxDrainBatch() const;
+
 private:
+    struct PendingPacket
+    {
+        SerialPacket packet;
+        uint32_t sentMillis;
+        TxClass cls;
+        uint8_t attempts;
+        bool inUse;
+    };
+
+    // Reliable streams are sent as control and bulk, a burst that fills both queues still fits
+    static constexpr size_t retransmitWindowSize = TxScheduler::controlQueueSize + TxScheduler::bulkQueueSize;
+    static constexpr uint32_t retransmitTimeoutMillis = 100;
+    static constexpr uint8_t maxAttempts = 5;
+    // Rx event fires once this many bytes are in the fifo or the line goes idle
+    static constexpr uint8_t rxFifoThreshold = 64;
+    // Uart is checked anyway this often in case an rx event was missed
+    static constexpr uint32_t rxPollIntervalMillis = 20;
+    // Roughly the time the uart takes to send one packet at 1 Mbaud, nothing signals when it has room again
+    static constexpr uint32_t txRetryMicros = 1500;
+
     CircularBuffer<byte, sizeof(SerialPacket) * 2> parsingQueue;
-    CircularBuffer<SerialPacket, 16> inboundQueue;
-    CRC32 crcOut;
+    SpscQueue<SerialPacket, 16> inboundQueue;
     CRC32 crcIn;
     uint64_t lastLong;
     uint32_t packetCount;
     uint32_t corruptedPacketCount;
-    std::mutex inboundQueueMutex;
+    uint32_t lostPacketCount;
+    uint32_t latePacketCount;
+    uint32_t duplicatePacketCount;
+    uint32_t retransmitCount;
+    uint32_t reliableDropCount;
+    std::array<std::atomic<uint16_t>, (size_t)PacketType::Count> outboundSeqs;
+    std::array<SequenceTracker, (size_t)PacketType::Count> inboundSeqs;
+    std::array<PendingPacket, retransmitWindowSize> retransmitWindow;
+    portMUX_TYPE retransmitWindowMux;
+    TxScheduler tx;
+    std::atomic<bool> rxPending;
+    // Set while a run() posted by wake() hasn't started yet
+    std::atomic<bool> wakePending;
+    uint32_t lastRxPollMillis;
+    void (*inboundHandler)();
+    uint32_t rxBudgetMicros;
+    uint32_t drainBudgetMicros;
+    uint32_t bytesReceived;
+    std::atomic<uint32_t> nativeBytesSent;
+    uint32_t rxBudgetExhaustedCount;
+    uint32_t drainBudgetExhaustedCount;
+    uint32_t maxDrainBatch;
 
+    // Safe from any core, posts run() to the scheduler unless it's already on its way
+    void wake();
     void receive();
+    // Returns true if a complete packet was enqueued
+    bool parseByte(byte b);
     bool tryEnqueueInbound(SerialPacket& packet);
+    void ackInbound(SerialPacket& packet);
+    void trackInbound(SerialPacket& packet);
+    void handleAck(AckPacket& ack);
+    // Returns false if the window is full
+    bool trackOutbound(SerialPacket& packet, TxClass cls);
+    void retransmitExpired();
+    void stampCrc(SerialPacket& packet);
 };
\ No newline at end of file
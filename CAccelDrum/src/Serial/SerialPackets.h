@@ -3,29 +3,66 @@
 #include <array>
 #include "Utils/BitUtils.h"
 
-enum class PacketType : uint32_t
+enum class PacketType : uint8_t
 {
     None,
     Accel,
     RawAccel,
     Text,
     Configure,
+    Ack,
+    TaskStats,
+    Log,
+    BootProfile,
+    Hello,
+    Telemetry,
+    LinkStats,
+    Count
+};
+
+// Reliable streams are acked by the receiver and retransmitted by the sender,
+// the rest are best-effort and only have their losses counted
+constexpr bool isReliableStream(PacketType type)
+{
+    return type == PacketType::Text || type == PacketType::Configure || type == PacketType::Log ||
+        type == PacketType::BootProfile || type == PacketType::Hello;
+}
+
+// Streams the host subscribes to, each is sent at its own rate while its lease is renewed
+enum class StreamId : uint8_t
+{
+    RawSensor0, // Packs of mpus[0] in RawAccel packets
+    RawSensor1,
+    RawSensor2,
+    RawSensor3,
+    TaskStats, // A TaskStats dump
+    Telemetry,
     Count
 };
 
 struct SerialPacket
 {
     static constexpr size_t sizeExpected = 144;
-    static constexpr size_t sizeInner = sizeExpected - sizeof(PacketType) - sizeof(uint32_t) - sizeof(uint64_t);
+    static constexpr size_t sizeHeader = sizeof(PacketType) + sizeof(uint8_t) + sizeof(uint16_t);
+    static constexpr size_t sizeInner = sizeExpected - sizeHeader - sizeof(uint32_t) - sizeof(uint64_t);
     static constexpr uint64_t magicExpected = 0xDEADBEEF80085069;
     static constexpr uint64_t magicExpectedReversed = BitUtils::reverseBytewise(magicExpected);
 
+    enum Flags : uint8_t
+    {
+        FlagNone = 0,
+        FlagReliable = 1 << 0,   // Receiver should reply with an ack
+        FlagRetransmit = 1 << 1, // Sent again because the ack didn't arrive in time
+    };
+
     PacketType type;
+    uint8_t flags;
+    uint16_t seq; // Counted separately for every packet type
     struct Inner
     {
         byte data[sizeInner];
     } inner;    
-    uint32_t crc32;
+    uint32_t crc32; // Covers everything before it
     uint64_t magic;
 } __attribute__((packed));
 
@@ -35,6 +72,8 @@ template <typename T>
 struct SerialPacketTyped
 {
     PacketType type;
+    uint8_t flags;
+    uint16_t seq;
     T inner;
     uint32_t crc32;
     uint64_t magic;
@@ -59,7 +98,12 @@ struct RawAccelPacket
     } __attribute__((packed));
     static constexpr uint32_t packCount = 4;
     std::array<Pack, packCount> packs;
-    byte padding[sizeof(SerialPacket::Inner) - sizeof(packs)];
+    uint8_t sensorMask; // Packs read in this set, bit i for packs[i], the others are zeroed
+    // Scale the packs were converted with, changes together with the SensorConfigResult of the same generation
+    uint8_t configGeneration;
+    std::array<uint8_t, packCount> accelRanges; // ACCEL_FS
+    std::array<uint8_t, packCount> gyroRanges; // GYRO_FS
+    byte padding[sizeof(SerialPacket::Inner) - sizeof(packs) - sizeof(uint8_t) * 2 - sizeof(uint8_t) * packCount * 2];
 } __attribute__((packed));
 
 struct TextPacket
@@ -70,14 +114,24 @@ struct TextPacket
     std::array<char, sizeStr> string;
 } __attribute__((packed));
 
+struct AckPacket
+{
+    PacketType type;
+    uint16_t seq;
+    byte padding[SerialPacket::sizeInner - sizeof(PacketType) - sizeof(uint16_t)];
+} __attribute__((packed));
+
 struct ConfigurePacket
 {
     enum class Type : uint32_t
     {
         None,
-        PollForData,
+        Subscribe,
         Backlight,
         Reset,
+        TaskStats,
+        BootProfile,
+        SensorConfig,
         Count
     };
     enum class Val : int32_t
@@ -92,6 +146,17 @@ struct ConfigurePacket
         BacklightSetToggle,
         ResetAck,
         ResetResultSettings,
+        TaskStatsGet, // Replied with a TaskStats packet per task
+        TaskStatsReset,
+        TaskStatsAck,
+        BootProfileGet, // Replied with a BootProfile packet
+        SensorConfigGet, // Replied with a SensorConfigResult
+        SensorConfigSet, // SensorConfigs in data, replied with a SensorConfigResult once applied
+        SensorConfigResult,
+        SensorConfigRejected, // A value in the set was out of range, nothing was changed
+        SubscribeSet, // Subscriptions in data, replied with a SubscribeResult of the granted rates
+        SubscribeResult,
+        Count
     };
     struct Settings
     {
@@ -100,9 +165,164 @@ struct ConfigurePacket
         std::array<uint8_t, 12> accelFactoryTrims;
         std::array<uint8_t, 12> gyroFactoryTrims;
     } __attribute__((packed));
+    struct SensorConfig
+    {
+        uint8_t accelRange; // ACCEL_FS
+        uint8_t gyroRange; // GYRO_FS
+        uint8_t dlpfMode; // MPU6050_DLPF_BW_*
+        uint8_t rateDivider; // Output rate is 1 kHz (8 kHz without the filter) / (1 + rateDivider)
+    } __attribute__((packed));
+    struct SensorConfigs
+    {
+        uint8_t sensorMask; // Bit i for mpus[i], the sensors a set applies to
+        uint8_t generation; // Of the configs in a result, see RawAccelPacket::configGeneration
+        std::array<SensorConfig, 4> sensors;
+    } __attribute__((packed));
+    struct Subscription
+    {
+        uint8_t stream; // StreamId
+        uint16_t rateHz; // 0 unsubscribes, capped to the max rate of the stream
+        uint16_t leaseMillis; // Dropped unless subscribed again within this
+    } __attribute__((packed));
+    struct Subscriptions
+    {
+        static constexpr size_t maxCount = 8;
+        uint8_t count;
+        std::array<Subscription, maxCount> entries;
+    } __attribute__((packed));
     static constexpr size_t sizeData = SerialPacket::sizeInner - sizeof(Type) - sizeof(Val);
     typedef std::array<byte, sizeData> Data;
     Type type;
     Val value;
     Data data;
+} __attribute__((packed));
+
+// Scheduler statistics of one task, a dump sends one per task
+struct TaskStatsPacket
+{
+    static constexpr size_t sizeName = 16;
+    static constexpr size_t histogramBuckets = 16;
+    uint8_t index;
+    uint8_t count; // Packets in this dump
+    uint8_t core; // Core of the scheduler running the task
+    uint16_t coreBusyPermille; // Time that scheduler spent running tasks over the last second
+    uint16_t coreIdlePermille; // Time it spent blocked waiting for the next task
+    std::array<char, sizeName> name;
+    uint32_t runCount;
+    uint32_t minRunMicros;
+    uint32_t avgRunMicros;
+    uint32_t maxRunMicros;
+    uint32_t avgJitterMicros; // Actual start minus scheduled start
+    uint32_t maxJitterMicros;
+    uint32_t overrunCount;
+    // Bucket i counts values in [2^(i - 1), 2^i) micros, the last one also counts everything above
+    std::array<uint16_t, histogramBuckets> runHistogram;
+    std::array<uint16_t, histogramBuckets> jitterHistogram;
+    byte padding[SerialPacket::sizeInner - sizeof(uint8_t) * 3 - sizeof(uint16_t) * 2 - sizeName - sizeof(uint32_t) * 7 - sizeof(uint16_t) * histogramBuckets * 2];
+} __attribute__((packed));
+
+// Deferred log records packed back to back, each is
+// length (of the whole record), format id, millis, level, dropped count, then the tagged arguments,
+// see Utils/Log.h
+struct LogPacket
+{
+    static constexpr size_t sizeRecords = SerialPacket::sizeInner - sizeof(uint8_t);
+    uint8_t length; // Bytes of records used
+    std::array<uint8_t, sizeRecords> records;
+} __attribute__((packed));
+
+// Start and end of the boot phases in micros since the app started, sent once sampling starts and on request,
+// phases overlap as they run on both cores
+struct BootProfilePacket
+{
+    struct Phase
+    {
+        uint8_t phase; // BootPhase in Utils/BootProfile.h
+        uint8_t core;
+        uint32_t startMicros;
+        uint32_t endMicros; // 0 while the phase is running
+    } __attribute__((packed));
+    static constexpr size_t maxPhases = 12;
+    uint8_t count;
+    std::array<Phase, maxPhases> phases;
+    byte padding[SerialPacket::sizeInner - sizeof(uint8_t) - sizeof(Phase) * maxPhases];
+} __attribute__((packed));
+
+// Exchanged on connect, the host sends its own and the device replies with its own,
+// a peer built with different packet layouts is refused, so this layout and the Hello type must never change
+struct HelloPacket
+{
+    enum Capabilities : uint32_t
+    {
+        CapNone = 0,
+        CapReliableStreams = 1 << 0, // Acks and retransmits of the isReliableStream() types, else all are best-effort
+        CapDeferredLog = 1 << 1, // Log packets rendered from logdict.json, else logs are formatted into Text packets
+        CapSubscriptions = 1 << 2,
+        CapSensorConfig = 1 << 3,
+        CapBootProfile = 1 << 4,
+        CapTelemetry = 1 << 5,
+    };
+    uint32_t firmwareVersion; // major << 16 | minor, 0 from the host
+    uint32_t layoutHash; // See Serial/PacketLayout.h
+    uint32_t capabilities; // Capabilities of the sender
+    uint32_t baudRate; // Of the link
+    uint8_t accepted; // In the device's reply, 0 if the host's layoutHash differs
+    byte padding[SerialPacket::sizeInner - sizeof(uint32_t) * 4 - sizeof(uint8_t)];
+} __attribute__((packed));
+
+// Health of the device, streamed at a low rate so degradation shows up over long sessions,
+// rates and loads are over the time since the previous packet, followed by a LinkStatsPacket
+struct TelemetryPacket
+{
+    struct Task
+    {
+        static constexpr size_t sizeName = 12;
+        std::array<char, sizeName> name; // Cut, not null terminated when it fills the array
+        uint16_t stackFreeMinBytes; // High-water mark, the least stack left since the task started
+    } __attribute__((packed));
+    static constexpr size_t maxTasks = 5;
+    uint32_t uptimeMillis;
+    std::array<uint16_t, 2> coreBusyPermille; // Per core, of the scheduler running there
+    uint32_t freeHeap;
+    uint32_t minFreeHeap; // Least free heap since boot
+    uint32_t largestFreeBlock;
+    uint32_t sampleSetsMilliHz; // RawAccel packets actually sent per 1000 seconds
+    uint32_t lcdFrames; // Frames sent to the lcd since boot
+    uint32_t lcdLastFrameBytes; // Bytes written over i2c for the last frame
+    uint32_t lcdMaxFrameBytes;
+    uint32_t lcdAvgFrameBytes;
+    uint8_t taskCount;
+    std::array<Task, maxTasks> tasks;
+    byte padding[SerialPacket::sizeInner - sizeof(uint32_t) * 9 - sizeof(uint16_t) * 2 - sizeof(uint8_t) - sizeof(Task) * maxTasks];
+} __attribute__((packed));
+
+// Counters of the serial link since boot, sent on the telemetry stream right after each TelemetryPacket
+struct LinkStatsPacket
+{
+    // Of a TxClass
+    struct TxClassStats
+    {
+        uint32_t sent;
+        uint32_t dropped; // Tx queue full
+        uint32_t avgWaitMicros; // From enqueue to the uart
+        uint32_t maxWaitMicros;
+    } __attribute__((packed));
+    static constexpr uint8_t txClassCount = 4;
+
+    uint32_t rxBytes;
+    uint32_t rxPackets;
+    uint32_t rxCorrupt;
+    uint32_t rxLost; // Skipped over by sequence gaps
+    uint32_t rxOverflow; // Dropped because the inbound queue was full, a reliable one is sent again by the host
+    uint32_t rxUnknown; // None or a type outside of PacketType when dispatched
+    uint32_t rxUnregistered; // Valid type without a handler on the device
+    uint32_t rxBudgetExhausted; // Times reading stopped with bytes still in the uart
+    uint32_t drainBudgetExhausted; // Times handling stopped with packets still queued
+    uint32_t maxDrainBatch; // Most packets handled in one go
+    uint32_t inboundHighWaterMark; // Most packets waiting in the inbound queue
+    uint32_t txBytes; // Written to the uart, including the packets that bypass the tx scheduler
+    uint32_t reliableDropped; // Given up on after the retransmits or refused by a full window
+    uint32_t retransmits;
+    std::array<TxClassStats, txClassCount> txClasses; // Realtime, Sensor, Control, Bulk
+    byte padding[SerialPacket::sizeInner - sizeof(uint32_t) * 14 - sizeof(TxClassStats) * txClassCount];
 } __attribute__((packed));
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include <Arduino.h>
+#include "Serial/Subscriptions.h"
+
+namespace Subscriptions
+{
+    struct State
+    {
+        uint16_t rateHz; // 0 while not subscribed
+        uint32_t periodMicros;
+        uint32_t nextDueMicros;
+        uint32_t leaseEndMicros;
+    };
+
+    static constexpr std::array<uint16_t, (size_t)StreamId::Count> maxRatesHz = {
+        1000, 1000, 1000, 1000, // Raw sensors, one read takes about 350 us on a 400 kHz bus
+        10, // TaskStats, a dump is a packet per task
+        10, // Telemetry
+    };
+
+    static std::array<State, (size_t)StreamId::Count> states;
+    static std::atomic<uint32_t> activeMask(0);
+
+    // Wrap safe, true if a is at or after b
+    static bool reached(uint32_t a, uint32_t b)
+    {
+        return (int32_t)(a - b) >= 0;
+    }
+
+    static void drop(size_t i)
+    {
+        states[i].rateHz = 0;
+        activeMask.fetch_and(~(1u << i), std::memory_order_relaxed);
+    }
+
+    uint16_t subscribe(StreamId stream, uint16_t rateHz, uint16_t leaseMillis, uint32_t nowMicros)
+    {
+        size_t i = (size_t)stream;
+        if (i >= states.size())
+            return 0;
+        if (!rateHz || !leaseMillis)
+        {
+            drop(i);
+            return 0;
+        }
+        State &state = states[i];
+        rateHz = min(rateHz, maxRatesHz[i]);
+        if (state.rateHz != rateHz)
+        {
+            // A renewal keeps the timeline, a new rate starts one right away
+            state.rateHz = rateHz;
+            state.periodMicros = 1'000'000 / rateHz;
+            state.nextDueMicros = nowMicros;
+        }
+        state.leaseEndMicros = nowMicros + leaseMillis * 1000;
+        activeMask.fetch_or(1u << i, std::memory_order_relaxed);
+        return rateHz;
+    }
+
+    uint32_t takeDue(uint32_t nowMicros)
+    {
+        uint32_t due = 0;
+        for (size_t i = 0; i < states.size(); i++)
+        {
+            State &state = states[i];
+            if (!state.rateHz)
+                continue;
+            if (reached(nowMicros, state.leaseEndMicros))
+            {
+                drop(i);
+                continue;
+            }
+            if (!reached(nowMicros + dueSlackMicros, state.nextDueMicros))
+                continue;
+            due |= 1u << i;
+            state.nextDueMicros += state.periodMicros;
+            // Fell more than a period behind, skip the missed ones instead of sending a burst
+            if (reached(nowMicros, state.nextDueMicros))
+                state.nextDueMicros = nowMicros + state.periodMicros;
+        }
+        return due;
+    }
+
+    uint32_t untilNextDue(uint32_t nowMicros, uint32_t maxMicros)
+    {
+        uint32_t until = maxMicros;
+        for (const State &state : states)
+        {
+            if (!state.rateHz)
+                continue;
+            // Also wake for the lease so the stream isn't reported active long after it ran out
+            for (uint32_t at : {state.nextDueMicros, state.leaseEndMicros})
+                until = min(until, reached(nowMicros, at) ? 1u : at - nowMicros);
+        }
+        return until;
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < states.size(); i++)
+            drop(i);
+    }
+
+    uint16_t getRate(StreamId stream)
+    {
+        return states[(size_t)stream].rateHz;
+    }
+
+    bool isActive(StreamId stream)
+    {
+        return activeMask.load(std::memory_order_relaxed) & (1u << (size_t)stream);
+    }
+
+    bool isAnyActive()
+    {
+        return activeMask.load(std::memory_order_relaxed);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include "SerialPackets.h"
+
+// Rates and leases of the streams the host subscribed to, every stream keeps its own deadlines
+// on its ideal timeline, the sampling task sends what's due and sleeps until the next deadline of any stream,
+// called on the sampling core except isActive() and isAnyActive()
+namespace Subscriptions
+{
+    // A run this early still counts as on time, so streams due a moment apart are sent by one run
+    // instead of waking the task again right after
+    constexpr uint32_t dueSlackMicros = 250;
+
+    // Applies one subscription, returns the granted rate, 0 for an unknown stream or an unsubscribe
+    uint16_t subscribe(StreamId stream, uint16_t rateHz, uint16_t leaseMillis, uint32_t nowMicros);
+
+    // Mask of the streams due by nowMicros, bit i for StreamId i, their deadlines move on by one period,
+    // streams whose lease ran out are dropped
+    uint32_t takeDue(uint32_t nowMicros);
+
+    // Micros from nowMicros until the earliest deadline, maxMicros if nothing is subscribed
+    uint32_t untilNextDue(uint32_t nowMicros, uint32_t maxMicros);
+
+    // Drops every stream
+    void clear();
+
+    uint16_t getRate(StreamId stream);
+
+    // Safe from any core
+    bool isActive(StreamId stream);
+
+    bool isAnyActive();
+}
\ No newline at end of file
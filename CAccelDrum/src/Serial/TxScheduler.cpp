@@ -0,0 +1,130 @@
+#include <Arduino.h>
+#include "TxScheduler.h"
+
+TxScheduler::TxScheduler() : realtimeQueue(),
+                             sensorQueue(),
+                             controlQueue(),
+                             bulkQueue(),
+                             flushing(false),
+                             deficits{},
+                             stats{},
+                             bytesSent(0)
+{
+}
+
+bool TxScheduler::enqueue(TxClass cls, const SerialPacket &packet)
+{
+    Entry entry{
+        .packet = packet,
+        .enqueuedMicros = (uint32_t)micros()};
+    return withQueue(cls, [&](auto &queue) { return queue.tryPush(entry); });
+}
+
+bool TxScheduler::hasRoom() const
+{
+    return Serial.availableForWrite() >= (int)sizeof(SerialPacket);
+}
+
+bool TxScheduler::writeFrom(TxClass cls)
+{
+    return withQueue(cls, [&](auto &queue)
+    {
+        Entry *entry = queue.front();
+        if (!entry || !hasRoom())
+            return false;
+        Serial.write(reinterpret_cast<const uint8_t *>(&entry->packet), sizeof(SerialPacket));
+        uint32_t wait = (uint32_t)micros() - entry->enqueuedMicros;
+        ClassStats &s = stats[(size_t)cls];
+        s.sent++;
+        s.totalWaitMicros += wait;
+        s.maxWaitMicros = max(s.maxWaitMicros, wait);
+        bytesSent += sizeof(SerialPacket);
+        queue.pop();
+        return true;
+    });
+}
+
+uint32_t TxScheduler::flushRealtime()
+{
+    uint32_t written = 0;
+    while (writeFrom(TxClass::Realtime))
+        written++;
+    return written;
+}
+
+bool TxScheduler::isEmpty(TxClass cls)
+{
+    return withQueue(cls, [](auto &queue) { return queue.isEmpty(); });
+}
+
+uint32_t TxScheduler::flush()
+{
+    if (flushing.exchange(true, std::memory_order_acquire))
+        return 0;
+    uint32_t written = 0;
+    // Deficit round robin over the budgeted classes,
+    // realtime is checked again before every other packet
+    bool progress = true;
+    while (progress && hasRoom())
+    {
+        progress = false;
+        for (size_t i = (size_t)TxClass::Sensor; i < (size_t)TxClass::Count; i++)
+        {
+            TxClass cls = (TxClass)i;
+            if (isEmpty(cls))
+            {
+                deficits[i] = 0; // Idle classes don't bank credit
+                continue;
+            }
+            deficits[i] = min(deficits[i] + quantums[i], quantums[i] * 2);
+            while (deficits[i] >= sizeof(SerialPacket) && !isEmpty(cls))
+            {
+                written += flushRealtime();
+                if (!writeFrom(cls))
+                {
+                    // Uart is full, keep the credit for the next flush
+                    progress = false;
+                    break;
+                }
+                deficits[i] -= sizeof(SerialPacket);
+                written++;
+                progress = true;
+            }
+            if (!hasRoom())
+                break;
+        }
+    }
+    written += flushRealtime();
+    flushing.store(false, std::memory_order_release);
+    return written;
+}
+
+TxScheduler::ClassStats TxScheduler::getStats(TxClass cls)
+{
+    ClassStats s = stats[(size_t)cls];
+    withQueue(cls, [&](auto &queue)
+    {
+        s.dropped = queue.getOverflowCount();
+        s.highWaterMark = queue.getHighWaterMark();
+        return 0;
+    });
+    return s;
+}
+
+uint32_t TxScheduler::getQueuedCount(TxClass cls)
+{
+    return withQueue(cls, [](auto &queue) { return queue.size(); });
+}
+
+bool TxScheduler::hasQueued()
+{
+    for (size_t i = 0; i < (size_t)TxClass::Count; i++)
+        if (!isEmpty((TxClass)i))
+            return true;
+    return false;
+}
+
+uint32_t TxScheduler::getBytesSent() const
+{
+    return bytesSent;
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+#include <Arduino.h>
+#include <array>
+#include <atomic>
+#include "SerialPackets.h"
+#include "Utils/LockFreeQueue.h"
+
+// Transmit priority classes, lower value is served first
+enum class TxClass : uint8_t
+{
+    Realtime, // For hits, always preempts the rest at packet boundaries, nothing detects hits on the device yet so it stays empty
+    Sensor,
+    Control,
+    Bulk, // Text and dumps
+    Count
+};
+
+constexpr TxClass defaultTxClass(PacketType type)
+{
+    switch (type)
+    {
+        case PacketType::Accel:
+        case PacketType::RawAccel:
+            return TxClass::Sensor;
+        case PacketType::Configure:
+        case PacketType::Ack:
+            return TxClass::Control;
+        default:
+            return TxClass::Bulk;
+    }
+}
+
+// Queues outbound packets per class and hands them to the uart only when its tx buffer has room,
+// so nothing low priority piles up in the uart ahead of a realtime packet,
+// packets can be enqueued from either core, flushing is done by one caller at a time
+class TxScheduler
+{
+public:
+    struct ClassStats
+    {
+        uint32_t sent;
+        uint32_t dropped; // Rejected because the queue was full
+        uint32_t highWaterMark;
+        uint32_t maxWaitMicros;
+        uint64_t totalWaitMicros;
+
+        uint32_t avgWaitMicros() const
+        {
+            return sent ? totalWaitMicros / sent : 0;
+        }
+    };
+
+    // Uart tx buffer size in packets, bounds how long a realtime packet can wait behind a written one
+    static constexpr size_t txBufferPackets = 2;
+    static constexpr size_t controlQueueSize = 8;
+    static constexpr size_t bulkQueueSize = 16;
+
+    TxScheduler();
+
+    // Returns false if the queue of the class is full
+    bool enqueue(TxClass cls, const SerialPacket &packet);
+
+    // Writes queued packets while the uart has room, returns the number of packets written,
+    // returns 0 right away if another core is already flushing
+    uint32_t flush();
+
+    ClassStats getStats(TxClass cls);
+
+    uint32_t getQueuedCount(TxClass cls);
+
+    // True if a packet of any class is waiting for the uart
+    bool hasQueued();
+
+    uint32_t getBytesSent() const;
+
+private:
+    struct Entry
+    {
+        SerialPacket packet;
+        uint32_t enqueuedMicros;
+    };
+
+    // Bytes of credit each class gets per round, realtime isn't budgeted
+    static constexpr std::array<uint32_t, (size_t)TxClass::Count> quantums =
+    {
+        0,
+        sizeof(SerialPacket) * 4,
+        sizeof(SerialPacket) * 2,
+        sizeof(SerialPacket) * 1,
+    };
+
+    MpscQueue<Entry, 4> realtimeQueue;
+    MpscQueue<Entry, 4> sensorQueue;
+    MpscQueue<Entry, controlQueueSize> controlQueue;
+    MpscQueue<Entry, bulkQueueSize> bulkQueue;
+    std::atomic<bool> flushing;
+    // Only touched by the flushing side
+    std::array<uint32_t, (size_t)TxClass::Count> deficits;
+    std::array<ClassStats, (size_t)TxClass::Count> stats;
+    uint32_t bytesSent;
+
+    // Calls func with the queue of the class
+    template <typename TFunc>
+    auto withQueue(TxClass cls, TFunc func)
+    {
+        switch (cls)
+        {
+            case TxClass::Realtime:
+                return func(realtimeQueue);
+            case TxClass::Sensor:
+                return func(sensorQueue);
+            case TxClass::Control:
+                return func(controlQueue);
+            default:
+                return func(bulkQueue);
+        }
+    }
+
+    bool writeFrom(TxClass cls);
+    uint32_t flushRealtime();
+    bool hasRoom() const;
+    bool isEmpty(TxClass cls);
+};
\ No newline at end of file
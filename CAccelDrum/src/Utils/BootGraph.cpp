@@ -0,0 +1,60 @@
+#include <Arduino.h>
+#include "main.h"
+#include "Utils/BootGraph.h"
+
+namespace BootGraph
+{
+    // lcd.begin() sleeps for over a second, in a task of its own the sleep overlaps with the sensor bring-up
+    static void runLcd(void *arg)
+    {
+        const Steps &steps = *(const Steps *)arg;
+        BootProfile::begin(BootPhase::Lcd);
+        steps.initLcd();
+        BootProfile::end(BootPhase::Lcd);
+        vTaskDelete(nullptr);
+    }
+
+    void startLcd(const Steps &steps)
+    {
+        xTaskCreatePinnedToCore(runLcd, "lcd init", lcdInitStackSize, (void *)&steps, 1, nullptr, 0);
+    }
+
+    // Split in two so neither half holds the task watchdog for the whole calibration
+    static Co::Task calibrate(const Steps &steps, uint8_t i)
+    {
+        steps.calibrateAccel(i);
+        co_await Co::yieldNow();
+        steps.calibrateGyro(i);
+    }
+
+    // Brings up the two mpus of a bus, each bus is served by its own core
+    static Co::Task bringUpBus(const Steps &steps, uint8_t first, BootPhase sensorsPhase, BootPhase calibratePhase)
+    {
+        BootProfile::begin(sensorsPhase);
+        steps.initSensor(first);
+        steps.initSensor(first + 1);
+        BootProfile::end(sensorsPhase);
+        co_await Co::yieldNow();
+
+        BootProfile::begin(calibratePhase);
+        co_await calibrate(steps, first);
+        co_await calibrate(steps, first + 1);
+        BootProfile::end(calibratePhase);
+    }
+
+    // The mpus on Wire1 are brought up by the ui core in parallel, the display is only drawn between the steps
+    static Co::Task bringUpWire1(const Steps &steps)
+    {
+        co_await Co::resumeOn(uiScheduler);
+        co_await bringUpBus(steps, 2, BootPhase::SensorsWire1, BootPhase::CalibrateWire1);
+        co_await Co::resumeOn(scheduler);
+    }
+
+    Co::Task bringUpSensors(const Steps &steps)
+    {
+        Co::Task wire1 = bringUpWire1(steps);
+        wire1.start();
+        co_await bringUpBus(steps, 0, BootPhase::SensorsWire, BootPhase::CalibrateWire);
+        co_await wire1;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include "Utils/BootProfile.h"
+#include "Utils/CoroutineScheduler.h"
+
+// The parallel part of the boot, the lcd in a task of its own and each sensor bus on its own core,
+// the steps are passed in so the same graph runs on the host with simulated delays
+namespace BootGraph
+{
+    struct Steps
+    {
+        void (*initLcd)();
+        void (*initSensor)(uint8_t i);
+        void (*calibrateAccel)(uint8_t i);
+        void (*calibrateGyro)(uint8_t i);
+    };
+
+    // Runs initLcd in a short-lived task on core 0, steps has to outlive it
+    void startLcd(const Steps &steps);
+
+    // Brings up the mpus on Wire on this core while the ui core brings up the ones on Wire1,
+    // resumes on the sampling core once both are done
+    Co::Task bringUpSensors(const Steps &steps);
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include <Arduino.h>
+#include <atomic>
+#include "Utils/BootProfile.h"
+
+namespace BootProfile
+{
+    static_assert((size_t)BootPhase::Count <= BootProfilePacket::maxPhases);
+
+    // The packet may be made on the other core while a phase is still running
+    struct Record
+    {
+        uint32_t startMicros;
+        std::atomic<uint32_t> endMicros;
+        uint8_t core;
+        std::atomic<bool> begun;
+    };
+
+    static Record records[(size_t)BootPhase::Count];
+
+    void begin(BootPhase phase)
+    {
+        Record &r = records[(size_t)phase];
+        r.startMicros = micros();
+        r.endMicros.store(0, std::memory_order_relaxed);
+        r.core = xPortGetCoreID();
+        r.begun.store(true, std::memory_order_release);
+    }
+
+    void end(BootPhase phase)
+    {
+        records[(size_t)phase].endMicros.store(micros(), std::memory_order_release);
+    }
+
+    BootProfilePacket makePacket()
+    {
+        BootProfilePacket packet{};
+        for (size_t i = 0; i < (size_t)BootPhase::Count; i++)
+        {
+            const Record &r = records[i];
+            if (!r.begun.load(std::memory_order_acquire))
+                continue;
+            packet.phases[packet.count++] = {
+                .phase = (uint8_t)i,
+                .core = r.core,
+                .startMicros = r.startMicros,
+                .endMicros = r.endMicros.load(std::memory_order_acquire)};
+        }
+        return packet;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+#include <Arduino.h>
+#include "Serial/SerialPackets.h"
+
+// Phases of the boot, the lcd and the two sensor buses are brought up in parallel so several overlap
+enum class BootPhase : uint8_t
+{
+    Boot, // setup() until sampling starts
+    Setup,
+    Serial,
+    Lcd,
+    SensorsWire, // Init and offsets of the mpus on Wire
+    SensorsWire1,
+    CalibrateWire,
+    CalibrateWire1,
+    Pins,
+    Count
+};
+
+// Timestamps of the boot phases, each phase is begun and ended once by one task
+namespace BootProfile
+{
+    void begin(BootPhase phase);
+
+    void end(BootPhase phase);
+
+    // The phases begun so far, in the order of BootPhase
+    BootProfilePacket makePacket();
+}
\ No newline at end of file
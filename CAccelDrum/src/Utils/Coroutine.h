@@ -0,0 +1,417 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+// Frames of Co::Task coroutines come from a fixed arena instead of the heap,
+// a coroutine whose frame doesn't fit a block or finds every block in use isn't created, see Task::isValid()
+#ifndef COROUTINE_FRAME_SIZE
+#define COROUTINE_FRAME_SIZE 512
+#endif
+// The boot holds up to 8 at once and the handshake 1 for good
+#ifndef COROUTINE_FRAME_COUNT
+#define COROUTINE_FRAME_COUNT 10
+#endif
+
+// Nothing in here depends on Arduino so it can be built and tested on a host,
+// the scheduler awaitables are in CoroutineScheduler.h
+namespace Co
+{
+    // Fixed size blocks claimed through a bit mask, allocating and freeing are safe from any core
+    template <size_t BlockSize, size_t BlockCount>
+    class FrameArena
+    {
+        static_assert(BlockCount >= 1 && BlockCount <= 32, "Blocks are tracked in a 32 bit mask");
+
+    public:
+        static constexpr size_t blockSize = BlockSize;
+        static constexpr size_t blockCount = BlockCount;
+
+        // Returns nullptr if size is larger than a block or every block is in use
+        void *allocate(size_t size) noexcept
+        {
+            updateMax(largestRequest, size);
+            if (size > BlockSize)
+            {
+                failedCount.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            uint32_t used = usedMask.load(std::memory_order_relaxed);
+            while (true)
+            {
+                uint32_t free = ~used & fullMask;
+                if (!free)
+                {
+                    failedCount.fetch_add(1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                uint32_t bit = free & (~free + 1); // Lowest free block
+                if (usedMask.compare_exchange_weak(used, used | bit,
+                        std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    updateMax(highWaterMark, std::popcount(used | bit));
+                    return blocks[std::countr_zero(bit)].bytes;
+                }
+            }
+        }
+
+        void deallocate(void *p) noexcept
+        {
+            size_t index = reinterpret_cast<Block *>(p) - blocks;
+            usedMask.fetch_and(~(1u << index), std::memory_order_release);
+        }
+
+        uint32_t getUsedCount() const
+        {
+            return std::popcount(usedMask.load(std::memory_order_relaxed));
+        }
+
+        uint32_t getHighWaterMark() const
+        {
+            return highWaterMark.load(std::memory_order_relaxed);
+        }
+
+        // Frames that were too large or found the arena full
+        uint32_t getFailedCount() const
+        {
+            return failedCount.load(std::memory_order_relaxed);
+        }
+
+        // Largest frame asked for, for sizing COROUTINE_FRAME_SIZE
+        uint32_t getLargestRequest() const
+        {
+            return largestRequest.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Block
+        {
+            unsigned char bytes[BlockSize];
+        };
+
+        static constexpr uint32_t fullMask = BlockCount == 32 ? 0xFFFFFFFF : (1u << BlockCount) - 1;
+
+        static void updateMax(std::atomic<uint32_t> &max, uint32_t value)
+        {
+            uint32_t current = max.load(std::memory_order_relaxed);
+            while (value > current &&
+                   !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+                ;
+        }
+
+        Block blocks[BlockCount];
+        std::atomic<uint32_t> usedMask{0};
+        std::atomic<uint32_t> highWaterMark{0};
+        std::atomic<uint32_t> failedCount{0};
+        std::atomic<uint32_t> largestRequest{0};
+    };
+
+    inline FrameArena<COROUTINE_FRAME_SIZE, COROUTINE_FRAME_COUNT> frameArena;
+
+    // Coroutine that starts suspended and runs until its first suspension when started or awaited,
+    // awaiting it continues the awaiter once it finishes,
+    // dropping a started task lets it finish on its own, dropping one that wasn't started destroys it
+    class [[nodiscard]] Task
+    {
+    public:
+        struct promise_type;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept
+            {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(Handle handle) noexcept
+            {
+                promise_type &promise = handle.promise();
+                std::coroutine_handle<> next = promise.continuation
+                    ? promise.continuation
+                    : std::noop_coroutine();
+                if (promise.detached)
+                    handle.destroy();
+                return next;
+            }
+
+            void await_resume() noexcept
+            {
+            }
+        };
+
+        struct promise_type
+        {
+            std::coroutine_handle<> continuation;
+            bool started = false;
+            bool detached = false;
+
+            static void *operator new(size_t size) noexcept
+            {
+                return frameArena.allocate(size);
+            }
+
+            static void operator delete(void *p) noexcept
+            {
+                frameArena.deallocate(p);
+            }
+
+            static Task get_return_object_on_allocation_failure() noexcept
+            {
+                return Task();
+            }
+
+            Task get_return_object() noexcept
+            {
+                return Task(Handle::from_promise(*this));
+            }
+
+            std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            FinalAwaiter final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void return_void() noexcept
+            {
+            }
+
+            void unhandled_exception() noexcept
+            {
+                std::terminate();
+            }
+        };
+
+        struct Awaiter
+        {
+            Handle handle;
+
+            // An invalid task is treated as already finished
+            bool await_ready() noexcept
+            {
+                return !handle || handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+            {
+                promise_type &promise = handle.promise();
+                promise.continuation = awaiter;
+                if (promise.started)
+                    return std::noop_coroutine(); // Continued by FinalAwaiter
+                promise.started = true;
+                return handle;
+            }
+
+            void await_resume() noexcept
+            {
+            }
+        };
+
+        Task() = default;
+
+        Task(Task &&other) noexcept : handle(std::exchange(other.handle, {}))
+        {
+        }
+
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                handle = std::exchange(other.handle, {});
+            }
+            return *this;
+        }
+
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            release();
+        }
+
+        // False if the frame couldn't be allocated, the coroutine body never runs then
+        bool isValid() const
+        {
+            return (bool)handle;
+        }
+
+        bool isDone() const
+        {
+            return !handle || handle.done();
+        }
+
+        // Runs the coroutine until it first suspends, it can still be awaited afterwards,
+        // the awaiter has to run on the same core the task finishes on
+        void start()
+        {
+            if (!handle || handle.promise().started)
+                return;
+            handle.promise().started = true;
+            handle.resume();
+        }
+
+        // Starts the coroutine if needed and gives up on awaiting it, its frame is freed when it finishes,
+        // an unstarted task is marked before it runs as it may move to the other core and finish there first
+        void detach()
+        {
+            if (!handle || handle.promise().started)
+            {
+                release();
+                return;
+            }
+            Handle h = std::exchange(handle, {});
+            h.promise().started = true;
+            h.promise().detached = true;
+            h.resume();
+        }
+
+        Awaiter operator co_await() const noexcept
+        {
+            return Awaiter{handle};
+        }
+
+    private:
+        Handle handle;
+
+        explicit Task(Handle handle) : handle(handle)
+        {
+        }
+
+        void release()
+        {
+            Handle h = std::exchange(handle, {});
+            if (!h)
+                return;
+            if (h.done() || !h.promise().started)
+                h.destroy();
+            else
+                h.promise().detached = true;
+        }
+    };
+
+    // Manual reset event for one waiter, set() resumes the waiter inline,
+    // so set it from the core the waiter runs on, post it over from other cores and interrupts
+    class Event
+    {
+    public:
+        struct Awaiter
+        {
+            Event &event;
+
+            bool await_ready() const noexcept
+            {
+                return event.set_;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept
+            {
+                event.waiter = handle;
+            }
+
+            void await_resume() const noexcept
+            {
+            }
+        };
+
+        void set()
+        {
+            set_ = true;
+            if (std::coroutine_handle<> h = std::exchange(waiter, {}))
+                h.resume();
+        }
+
+        void reset()
+        {
+            set_ = false;
+        }
+
+        bool isSet() const
+        {
+            return set_;
+        }
+
+        Awaiter operator co_await() noexcept
+        {
+            return Awaiter{*this};
+        }
+
+    private:
+        std::coroutine_handle<> waiter;
+        bool set_ = false;
+    };
+
+    // Holds the latest value for one waiter, e.g. an inbound packet handed over by its handler,
+    // awaiting takes the value out, same threading rules as Event
+    template <typename T>
+    class Mailbox
+    {
+    public:
+        struct Awaiter
+        {
+            Mailbox &mailbox;
+
+            bool await_ready() const noexcept
+            {
+                return mailbox.full;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept
+            {
+                mailbox.waiter = handle;
+            }
+
+            T await_resume() noexcept
+            {
+                mailbox.full = false;
+                return mailbox.value;
+            }
+        };
+
+        // Overwrites a value nobody took yet
+        void put(const T &v)
+        {
+            if (full)
+                overwrittenCount++;
+            value = v;
+            full = true;
+            if (std::coroutine_handle<> h = std::exchange(waiter, {}))
+                h.resume();
+        }
+
+        bool hasValue() const
+        {
+            return full;
+        }
+
+        bool isAwaited() const
+        {
+            return (bool)waiter;
+        }
+
+        uint32_t getOverwrittenCount() const
+        {
+            return overwrittenCount;
+        }
+
+        Awaiter operator co_await() noexcept
+        {
+            return Awaiter{*this};
+        }
+
+    private:
+        T value{};
+        std::coroutine_handle<> waiter;
+        bool full = false;
+        uint32_t overwrittenCount = 0;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+#include <Arduino.h>
+#define LIBCALL_DEEP_SLEEP_SCHEDULER
+#include <DeepSleepScheduler.h>
+#include "Coroutine.h"
+
+// Awaitables that suspend a Co::Task and let the scheduler resume it, so a multi step flow
+// gives the other tasks their turn instead of blocking the core
+namespace Co
+{
+    class StatsRunnable : public Runnable
+    {
+    public:
+        void run() override
+        {
+        }
+    };
+
+    // Every coroutine resume is counted under this in the task stats, name it with setTaskName()
+    inline StatsRunnable statsRunnable;
+
+    // Scheduled in place of the coroutine, lives in the suspended coroutine's frame
+    class Resumer : public Runnable
+    {
+    public:
+        void run() override
+        {
+            handle.resume();
+        }
+
+        Runnable *getStatsRunnable() override
+        {
+            return &statsRunnable;
+        }
+
+    protected:
+        std::coroutine_handle<> handle;
+    };
+
+    class DelayAwaiter : public Resumer
+    {
+    public:
+        DelayAwaiter(Scheduler &scheduler, uint32_t micros) : scheduler(scheduler), micros(micros)
+        {
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            handle = h;
+            scheduler.scheduleDelayedMicros(this, micros);
+        }
+
+        void await_resume() const noexcept
+        {
+        }
+
+    private:
+        Scheduler &scheduler;
+        uint32_t micros;
+    };
+
+    class ResumeOnAwaiter : public Resumer
+    {
+    public:
+        explicit ResumeOnAwaiter(Scheduler &target) : target(target)
+        {
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        // Keeps running here if the post queue is full,
+        // the frame isn't touched after a successful post as the other core may already be running it
+        bool await_suspend(std::coroutine_handle<> h)
+        {
+            handle = h;
+            moved = true;
+            if (target.post(this))
+                return true;
+            moved = false;
+            return false;
+        }
+
+        bool await_resume() const noexcept
+        {
+            return moved;
+        }
+
+    private:
+        Scheduler &target;
+        bool moved = false;
+    };
+
+    // Suspends for at least micros on the scheduler of the calling core
+    inline DelayAwaiter delayMicros(uint32_t micros)
+    {
+        return DelayAwaiter(Scheduler::forCurrentCore(), micros);
+    }
+
+    // Suspends for at least millis on the scheduler of the calling core
+    inline DelayAwaiter delay(uint32_t millis)
+    {
+        return delayMicros(millis * 1000);
+    }
+
+    // Lets the tasks that are already due run before continuing
+    inline DelayAwaiter yieldNow()
+    {
+        return delayMicros(0);
+    }
+
+    // Continues on the core executing target, evaluates to false if its post queue was full
+    // and the coroutine kept running where it was
+    inline ResumeOnAwaiter resumeOn(Scheduler &target)
+    {
+        return ResumeOnAwaiter(target);
+    }
+
+    namespace Detail
+    {
+        inline Task startOn(Scheduler &target, Task task)
+        {
+            co_await resumeOn(target);
+            co_await task;
+        }
+    }
+
+    // Starts task from target's loop instead of inline and lets it finish on its own,
+    // returns false if a frame couldn't be allocated
+    inline bool spawn(Scheduler &target, Task task)
+    {
+        if (!task.isValid())
+            return false;
+        Task starter = Detail::startOn(target, std::move(task));
+        if (!starter.isValid())
+            return false;
+        starter.detach();
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,477 @@
+#pragma once
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+// Heap free formatting into fixed buffers, the format string is checked against the arguments at compile time,
+// "{}" formats the next argument, "{:spec}" with spec [0][width][.precision][type],
+// type is d, x, X, c, s or f, "{{" and "}}" are literal braces,
+// nothing in here depends on Arduino
+namespace Fmt
+{
+    // Float with a precision picked at runtime, formatted by "{}"
+    struct Fixed
+    {
+        float value;
+        uint8_t precision;
+    };
+
+    // Writes up to capacity chars without a terminating null,
+    // when a flush function is given it's called with the full buffer instead of dropping what doesn't fit
+    class Writer
+    {
+    public:
+        using FlushFunction = void (*)(void *context, const char *data, size_t length, bool more);
+
+        Writer(char *buf, size_t capacity, FlushFunction flush = nullptr, void *context = nullptr) :
+            buf(buf), capacity(capacity), flushFunction(flush), context(context)
+        {
+        }
+
+        void put(char c)
+        {
+            if (written == capacity && flushFunction)
+            {
+                flushFunction(context, buf, written, true);
+                written = 0;
+            }
+            if (written < capacity)
+                buf[written++] = c;
+            total++;
+        }
+
+        void write(std::string_view s)
+        {
+            for (char c : s)
+                put(c);
+        }
+
+        void fill(char c, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+                put(c);
+        }
+
+        // Hands what's left to the flush function as the last part
+        void finish()
+        {
+            if (flushFunction)
+            {
+                flushFunction(context, buf, written, false);
+                written = 0;
+            }
+        }
+
+        // Chars currently in the buffer
+        size_t getWritten() const
+        {
+            return written;
+        }
+
+        // Chars formatted in total, including the ones dropped or flushed
+        size_t getTotal() const
+        {
+            return total;
+        }
+
+        bool isTruncated() const
+        {
+            return !flushFunction && total > written;
+        }
+
+    private:
+        char *buf;
+        size_t capacity;
+        size_t written = 0;
+        size_t total = 0;
+        FlushFunction flushFunction;
+        void *context;
+    };
+
+    struct Spec
+    {
+        char type = 0;
+        bool zeroPad = false;
+        uint8_t width = 0;
+        int8_t precision = -1;
+    };
+
+    namespace Detail
+    {
+        enum class Kind
+        {
+            Bool,
+            Char,
+            Signed,
+            Unsigned,
+            Float,
+            Fixed,
+            String,
+        };
+
+        template <typename T>
+        consteval Kind kindOf()
+        {
+            using U = std::remove_cvref_t<T>;
+            if constexpr (std::is_same_v<U, bool>)
+                return Kind::Bool;
+            else if constexpr (std::is_same_v<U, char>)
+                return Kind::Char;
+            else if constexpr (std::is_enum_v<U>)
+                return std::is_signed_v<std::underlying_type_t<U>> ? Kind::Signed : Kind::Unsigned;
+            else if constexpr (std::signed_integral<U>)
+                return Kind::Signed;
+            else if constexpr (std::unsigned_integral<U>)
+                return Kind::Unsigned;
+            else if constexpr (std::floating_point<U>)
+                return Kind::Float;
+            else if constexpr (std::is_same_v<U, Fixed>)
+                return Kind::Fixed;
+            else if constexpr (std::is_convertible_v<const U &, std::string_view>)
+                return Kind::String;
+            else
+                static_assert(sizeof(U) == 0, "Type can't be formatted");
+        }
+
+        // Not constexpr, calling it while checking a format string is what fails the compilation
+        void formatStringError(const char *reason);
+
+        constexpr bool typeAccepts(char type, Kind kind)
+        {
+            switch (type)
+            {
+                case 0:
+                    return true;
+                case 'd':
+                    return kind == Kind::Signed || kind == Kind::Unsigned || kind == Kind::Char || kind == Kind::Bool;
+                case 'x':
+                case 'X':
+                    return kind == Kind::Signed || kind == Kind::Unsigned || kind == Kind::Char;
+                case 'c':
+                    return kind == Kind::Char || kind == Kind::Signed || kind == Kind::Unsigned;
+                case 's':
+                    return kind == Kind::String || kind == Kind::Bool;
+                case 'f':
+                    return kind == Kind::Float || kind == Kind::Fixed;
+                default:
+                    return false;
+            }
+        }
+
+        // Parses the spec between ':' and '}', returns the index of '}'
+        constexpr size_t parseSpec(std::string_view s, size_t i, Spec &spec)
+        {
+            if (i < s.size() && s[i] == '0')
+            {
+                spec.zeroPad = true;
+                i++;
+            }
+            unsigned width = 0;
+            while (i < s.size() && s[i] >= '0' && s[i] <= '9')
+                width = width * 10 + (s[i++] - '0');
+            spec.width = width > 64 ? 64 : width;
+            if (i < s.size() && s[i] == '.')
+            {
+                i++;
+                unsigned precision = 0;
+                while (i < s.size() && s[i] >= '0' && s[i] <= '9')
+                    precision = precision * 10 + (s[i++] - '0');
+                spec.precision = precision > 9 ? 9 : precision;
+            }
+            if (i < s.size() && s[i] != '}')
+                spec.type = s[i++];
+            return i;
+        }
+
+        template <typename... Args>
+        consteval void check(std::string_view s)
+        {
+            constexpr Kind kinds[] = {kindOf<Args>()..., Kind::Bool};
+            size_t arg = 0;
+            for (size_t i = 0; i < s.size(); i++)
+            {
+                if (s[i] == '}')
+                {
+                    if (i + 1 < s.size() && s[i + 1] == '}')
+                        i++;
+                    else
+                        formatStringError("Unmatched '}', use '}}' for a brace");
+                    continue;
+                }
+                if (s[i] != '{')
+                    continue;
+                if (i + 1 < s.size() && s[i + 1] == '{')
+                {
+                    i++;
+                    continue;
+                }
+                Spec spec;
+                i++;
+                if (i < s.size() && s[i] == ':')
+                    i = parseSpec(s, i + 1, spec);
+                if (i >= s.size() || s[i] != '}')
+                    formatStringError("Placeholder isn't closed or its spec is invalid");
+                if (arg >= sizeof...(Args))
+                    formatStringError("More placeholders than arguments");
+                if (!typeAccepts(spec.type, kinds[arg]))
+                    formatStringError("Spec type doesn't fit the argument");
+                arg++;
+            }
+            if (arg != sizeof...(Args))
+                formatStringError("More arguments than placeholders");
+        }
+
+        inline void writeUnsigned(Writer &w, uint64_t v, const Spec &spec, bool negative, unsigned base = 10, bool upper = false)
+        {
+            char digits[20];
+            size_t n = 0;
+            const char *table = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+            do
+            {
+                digits[n++] = table[v % base];
+                v /= base;
+            } while (v);
+            size_t length = n + negative;
+            if (negative && spec.zeroPad)
+                w.put('-');
+            if (spec.width > length)
+                w.fill(spec.zeroPad ? '0' : ' ', spec.width - length);
+            if (negative && !spec.zeroPad)
+                w.put('-');
+            while (n)
+                w.put(digits[--n]);
+        }
+
+        inline void writeFloat(Writer &w, double v, Spec spec)
+        {
+            if (v != v)
+            {
+                w.write("nan");
+                return;
+            }
+            bool negative = v < 0;
+            if (negative)
+                v = -v;
+            if (v > 1.8e19)
+            {
+                w.write(negative ? "-inf" : "inf");
+                return;
+            }
+            int precision = spec.precision < 0 ? 2 : spec.precision > 9 ? 9 : spec.precision;
+            uint64_t scale = 1;
+            for (int i = 0; i < precision; i++)
+                scale *= 10;
+            uint64_t whole = (uint64_t)v;
+            uint64_t fraction = (uint64_t)((v - whole) * scale + 0.5);
+            if (fraction >= scale)
+            {
+                whole++;
+                fraction -= scale;
+            }
+            size_t fractionLength = precision > 0 ? precision + 1 : 0;
+            Spec wholeSpec = spec;
+            wholeSpec.width = spec.width > fractionLength ? spec.width - fractionLength : 0;
+            writeUnsigned(w, whole, wholeSpec, negative && (whole || fraction));
+            if (precision > 0)
+            {
+                w.put('.');
+                Spec fractionSpec;
+                fractionSpec.zeroPad = true;
+                fractionSpec.width = precision;
+                writeUnsigned(w, fraction, fractionSpec, false);
+            }
+        }
+
+        template <typename T>
+        void writeArg(Writer &w, const T &value, const Spec &spec)
+        {
+            constexpr Kind kind = kindOf<T>();
+            if constexpr (kind == Kind::Bool)
+            {
+                if (spec.type == 'd')
+                    writeUnsigned(w, value, spec, false);
+                else
+                    w.write(value ? "true" : "false");
+            }
+            else if constexpr (kind == Kind::Char)
+            {
+                if (spec.type == 'd' || spec.type == 'x' || spec.type == 'X')
+                    writeUnsigned(w, (unsigned char)value, spec, false, spec.type == 'd' ? 10 : 16, spec.type == 'X');
+                else
+                {
+                    if (spec.width > 1)
+                        w.fill(' ', spec.width - 1);
+                    w.put(value);
+                }
+            }
+            else if constexpr (kind == Kind::Signed || kind == Kind::Unsigned)
+            {
+                if (spec.type == 'c')
+                {
+                    w.put((char)value);
+                    return;
+                }
+                unsigned base = spec.type == 'x' || spec.type == 'X' ? 16 : 10;
+                if constexpr (kind == Kind::Signed)
+                {
+                    int64_t v = (int64_t)value;
+                    if (base == 10 && v < 0)
+                        writeUnsigned(w, 0 - (uint64_t)v, spec, true);
+                    else
+                        writeUnsigned(w, (uint64_t)(std::make_unsigned_t<decltype(+value)>)value, spec, false, base, spec.type == 'X');
+                }
+                else
+                    writeUnsigned(w, (uint64_t)value, spec, false, base, spec.type == 'X');
+            }
+            else if constexpr (kind == Kind::Float)
+                writeFloat(w, value, spec);
+            else if constexpr (kind == Kind::Fixed)
+            {
+                Spec fixedSpec = spec;
+                fixedSpec.precision = spec.precision < 0 ? value.precision : spec.precision;
+                writeFloat(w, value.value, fixedSpec);
+            }
+            else
+            {
+                std::string_view s = value;
+                if (spec.precision >= 0 && s.size() > (size_t)spec.precision)
+                    s = s.substr(0, spec.precision);
+                if (spec.width > s.size())
+                    w.fill(' ', spec.width - s.size());
+                w.write(s);
+            }
+        }
+
+        // Finds the argument for the placeholder without recursion
+        template <typename... Args>
+        void writeArgAt(Writer &w, size_t index, const Spec &spec, const Args &...args)
+        {
+            size_t i = 0;
+            ((i++ == index ? writeArg(w, args, spec) : void()), ...);
+        }
+    }
+
+    // Converted from a string literal, fails to compile if the literal doesn't match Args
+    template <typename... Args>
+    struct FormatString
+    {
+        template <typename T>
+            requires std::is_convertible_v<const T &, std::string_view>
+        consteval FormatString(const T &s) : str(s)
+        {
+            Detail::check<Args...>(str);
+        }
+
+        std::string_view str;
+    };
+
+    // Args in a non deduced context so FormatString is deduced from the arguments
+    template <typename... Args>
+    using FormatStringFor = FormatString<std::type_identity_t<Args>...>;
+
+    template <typename... Args>
+    void formatTo(Writer &w, FormatStringFor<Args...> formatString, const Args &...args)
+    {
+        std::string_view s = formatString.str;
+        size_t arg = 0;
+        for (size_t i = 0; i < s.size(); i++)
+        {
+            char c = s[i];
+            if (c == '{' && s[i + 1] == '{')
+            {
+                w.put('{');
+                i++;
+            }
+            else if (c == '}')
+            {
+                w.put('}');
+                i++;
+            }
+            else if (c == '{')
+            {
+                Spec spec;
+                i++;
+                if (s[i] == ':')
+                    i = Detail::parseSpec(s, i + 1, spec);
+                Detail::writeArgAt(w, arg++, spec, args...);
+            }
+            else
+                w.put(c);
+        }
+    }
+
+    // Like snprintf, writes at most size - 1 chars plus a null and returns the full length
+    template <typename... Args>
+    size_t formatTo(char *buf, size_t size, FormatStringFor<Args...> formatString, const Args &...args)
+    {
+        if (size == 0)
+            return 0;
+        Writer w(buf, size - 1);
+        formatTo(w, formatString, args...);
+        buf[w.getWritten()] = '\0';
+        return w.getTotal();
+    }
+
+    template <size_t N, typename... Args>
+    size_t formatTo(char (&buf)[N], FormatStringFor<Args...> formatString, const Args &...args)
+    {
+        return formatTo(buf, N, formatString, args...);
+    }
+
+    // Null terminated string of at most N chars stored inline
+    template <size_t N>
+    class FixedString
+    {
+    public:
+        const char *c_str() const
+        {
+            return data;
+        }
+
+        std::string_view view() const
+        {
+            return std::string_view(data, length);
+        }
+
+        size_t size() const
+        {
+            return length;
+        }
+
+        operator std::string_view() const
+        {
+            return view();
+        }
+
+        bool isTruncated() const
+        {
+            return truncated;
+        }
+
+        template <typename... Args>
+        void assign(FormatStringFor<Args...> formatString, const Args &...args)
+        {
+            Writer w(data, N);
+            formatTo(w, formatString, args...);
+            length = w.getWritten();
+            data[length] = '\0';
+            truncated = w.isTruncated();
+        }
+
+    private:
+        char data[N + 1] = {};
+        size_t length = 0;
+        bool truncated = false;
+    };
+
+    // Formats into a FixedString<N>, e.g. Fmt::format<8>("|{}|", count)
+    template <size_t N, typename... Args>
+    FixedString<N> format(FormatStringFor<Args...> formatString, const Args &...args)
+    {
+        FixedString<N> s;
+        s.assign(formatString, args...);
+        return s;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Power of 2 buckets plus count, min, max and total, for a single writer,
+// bucket i counts values in [2^(i - 1), 2^i), the last one also counts everything above
+template <size_t Buckets = 24>
+class Histogram
+{
+    static_assert(Buckets >= 2 && Buckets <= 33, "Buckets cover at most the 32 bit range");
+
+public:
+    static constexpr size_t bucketCount = Buckets;
+
+    static constexpr size_t bucketOf(uint32_t value)
+    {
+        size_t bucket = std::bit_width(value);
+        return bucket < Buckets ? bucket : Buckets - 1;
+    }
+
+    void record(uint32_t value)
+    {
+        buckets[bucketOf(value)]++;
+        if (value < minValue)
+            minValue = value;
+        if (value > maxValue)
+            maxValue = value;
+        total += value;
+        count++;
+    }
+
+    void reset()
+    {
+        *this = Histogram();
+    }
+
+    uint32_t getCount() const
+    {
+        return count;
+    }
+
+    // 0 when empty
+    uint32_t getMin() const
+    {
+        return count ? minValue : 0;
+    }
+
+    uint32_t getMax() const
+    {
+        return maxValue;
+    }
+
+    uint32_t getMean() const
+    {
+        return count ? (uint32_t)(total / count) : 0;
+    }
+
+    uint32_t getBucket(size_t i) const
+    {
+        return i < Buckets ? buckets[i] : 0;
+    }
+
+    // Upper bound of the bucket holding the pth percentile (0 to 100)
+    uint32_t getPercentileBound(uint32_t p) const
+    {
+        uint64_t target = ((uint64_t)count * p + 99) / 100;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < Buckets; i++)
+        {
+            seen += buckets[i];
+            if (seen >= target && seen)
+                return i == Buckets - 1 ? maxValue : (uint32_t)((1ull << i) - 1);
+        }
+        return maxValue;
+    }
+
+private:
+    std::array<uint32_t, Buckets> buckets{};
+    uint32_t count = 0;
+    uint32_t minValue = std::numeric_limits<uint32_t>::max();
+    uint32_t maxValue = 0;
+    uint64_t total = 0;
+};
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include <esp_timer.h>
+#include "Utils/I2cArbiter.h"
+
+I2cArbiter wireArbiter("Wire");
+I2cArbiter wire1Arbiter("Wire1");
+
+I2cArbiter::I2cArbiter(const char *name) :
+    name(name),
+    mutex(xSemaphoreCreateMutex()),
+    sensorsWaiting(0),
+    nextSensorMicros(0),
+    acquiredMicros(0),
+    holder(Client::Sensor),
+    busyMicros{},
+    sensorWaits(),
+    deferredChunks(0),
+    resetMicros(esp_timer_get_time())
+{
+}
+
+I2cArbiter &I2cArbiter::forWire(TwoWire &wire)
+{
+    return &wire == &Wire1 ? wire1Arbiter : wireArbiter;
+}
+
+void I2cArbiter::acquire(Client client)
+{
+    if (client != Client::Sensor)
+    {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        acquiredMicros = esp_timer_get_time();
+        holder = client;
+        return;
+    }
+    sensorsWaiting.fetch_add(1, std::memory_order_acq_rel);
+    uint64_t start = esp_timer_get_time();
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    acquiredMicros = esp_timer_get_time();
+    holder = client;
+    sensorsWaiting.fetch_sub(1, std::memory_order_acq_rel);
+    sensorWaits.record((uint32_t)(acquiredMicros - start));
+}
+
+bool I2cArbiter::tryAcquire(Client client, uint32_t chunkMicros)
+{
+    int32_t untilSensor = (int32_t)(nextSensorMicros.load(std::memory_order_relaxed) - micros());
+    bool sensorDue = untilSensor >= 0 && (uint32_t)untilSensor < chunkMicros + guardMicros;
+    if (sensorsWaiting.load(std::memory_order_acquire) || sensorDue || xSemaphoreTake(mutex, 0) != pdTRUE)
+    {
+        deferredChunks++;
+        return false;
+    }
+    acquiredMicros = esp_timer_get_time();
+    holder = client;
+    return true;
+}
+
+void I2cArbiter::release()
+{
+    busyMicros[(size_t)holder] += esp_timer_get_time() - acquiredMicros;
+    xSemaphoreGive(mutex);
+}
+
+void I2cArbiter::expectSensorAt(uint32_t micros)
+{
+    nextSensorMicros.store(micros, std::memory_order_relaxed);
+}
+
+const char *I2cArbiter::getName() const
+{
+    return name;
+}
+
+I2cArbiter::Stats I2cArbiter::getStats()
+{
+    uint64_t elapsed = esp_timer_get_time() - resetMicros;
+    uint64_t busy = 0;
+    for (uint64_t b : busyMicros)
+        busy += b;
+    return Stats
+    {
+        .busyPermille = elapsed ? (uint32_t)min(busy * 1000 / elapsed, (uint64_t)1000) : 0,
+        .busyMicros = busyMicros,
+        .sensorWaitCount = sensorWaits.getCount(),
+        .sensorWaitMeanMicros = sensorWaits.getMean(),
+        .sensorWaitMaxMicros = sensorWaits.getMax(),
+        .sensorWaitP99Micros = sensorWaits.getPercentileBound(99),
+        .deferredChunks = deferredChunks,
+    };
+}
+
+void I2cArbiter::resetStats()
+{
+    busyMicros = {};
+    sensorWaits.reset();
+    deferredChunks = 0;
+    resetMicros = esp_timer_get_time();
+}
\ No newline at end of file
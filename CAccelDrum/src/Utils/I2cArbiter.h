@@ -0,0 +1,99 @@
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+#include <array>
+#include <atomic>
+#include "Utils/Histogram.h"
+
+// Orders the clients of one I2C bus so sensor reads never wait behind a long lcd refresh,
+// sensors take the bus whenever they need it, the display only takes it in short chunks
+// while no sensor is waiting and the next expected sensor read is far enough away,
+// code that uses the bus without the arbiter still works as Wire locks each transaction, it just isn't ordered or counted
+class I2cArbiter
+{
+public:
+    enum class Client : uint8_t
+    {
+        Sensor,
+        Display,
+        Count
+    };
+
+    // Figures since the last reset, read without locking so they can be a little off
+    struct Stats
+    {
+        uint32_t busyPermille; // Time the bus was held by any client
+        std::array<uint64_t, (size_t)Client::Count> busyMicros;
+        uint32_t sensorWaitCount;
+        uint32_t sensorWaitMeanMicros;
+        uint32_t sensorWaitMaxMicros;
+        uint32_t sensorWaitP99Micros; // Upper bound of the bucket
+        uint32_t deferredChunks; // Display chunks put off for a sensor read
+    };
+
+    // Holds the bus for a sensor until it goes out of scope
+    class SensorGuard
+    {
+    public:
+        explicit SensorGuard(I2cArbiter &arbiter) : arbiter(arbiter)
+        {
+            arbiter.acquire(Client::Sensor);
+        }
+
+        SensorGuard(const SensorGuard &) = delete;
+        SensorGuard &operator=(const SensorGuard &) = delete;
+
+        ~SensorGuard()
+        {
+            arbiter.release();
+        }
+
+    private:
+        I2cArbiter &arbiter;
+    };
+
+    explicit I2cArbiter(const char *name);
+
+    // The arbiter of Wire or Wire1
+    static I2cArbiter &forWire(TwoWire &wire);
+
+    // Blocks until the bus is free, a sensor's wait is recorded
+    void acquire(Client client);
+
+    // Takes the bus only if no sensor is waiting and chunkMicros fits before the next expected sensor read,
+    // counts a deferred chunk otherwise
+    bool tryAcquire(Client client, uint32_t chunkMicros);
+
+    // Bills the time since acquiring to the client that acquired
+    void release();
+
+    // Called by the sampling task with the time of its next read, a time in the past means none is expected
+    void expectSensorAt(uint32_t micros);
+
+    const char *getName() const;
+
+    Stats getStats();
+
+    void resetStats();
+
+private:
+    // Margin kept free before an expected sensor read
+    static constexpr uint32_t guardMicros = 200;
+
+    const char *name;
+    SemaphoreHandle_t mutex;
+    std::atomic<uint32_t> sensorsWaiting;
+    std::atomic<uint32_t> nextSensorMicros;
+    // Written by the holder of the bus, esp_timer_get_time() so long sessions don't wrap
+    uint64_t acquiredMicros;
+    Client holder;
+    std::array<uint64_t, (size_t)Client::Count> busyMicros;
+    // Written by the sensor side only
+    Histogram<> sensorWaits;
+    // Written by the display side only
+    uint32_t deferredChunks;
+    uint64_t resetMicros;
+};
+
+extern I2cArbiter wireArbiter;
+extern I2cArbiter wire1Arbiter;
\ No newline at end of file
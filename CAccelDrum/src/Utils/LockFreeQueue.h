@@ -0,0 +1,229 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Keeps the producer and consumer indices from sharing a cache line
+constexpr size_t cacheLineSize = 64;
+
+namespace LockFreeQueueDetail
+{
+    inline void updateMax(std::atomic<uint32_t> &max, uint32_t value)
+    {
+        uint32_t current = max.load(std::memory_order_relaxed);
+        while (value > current &&
+               !max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            ;
+    }
+}
+
+// Bounded single producer single consumer ring,
+// push from exactly one task and pop from exactly one (possibly other) task
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+    static constexpr size_t capacity = N;
+
+    // Producer only, returns false and counts an overflow when full
+    bool tryPush(const T &value)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - headCached == N)
+        {
+            headCached = head.load(std::memory_order_acquire);
+            if (t - headCached == N)
+            {
+                overflowCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        LockFreeQueueDetail::updateMax(highWaterMark, t + 1 - headCached);
+        return true;
+    }
+
+    // Consumer only, returns the oldest element in place or nullptr when empty,
+    // it stays valid until pop()
+    T *front()
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tailCached)
+        {
+            tailCached = tail.load(std::memory_order_acquire);
+            if (h == tailCached)
+                return nullptr;
+        }
+        return &slots[h & mask];
+    }
+
+    // Consumer only, must follow a non null front()
+    void pop()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer only
+    bool tryPop(T &out)
+    {
+        T *value = front();
+        if (!value)
+            return false;
+        out = *value;
+        pop();
+        return true;
+    }
+
+    // Approximate when called while the other side is active
+    uint32_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    bool isEmpty() const
+    {
+        return size() == 0;
+    }
+
+    uint32_t getHighWaterMark() const
+    {
+        return highWaterMark.load(std::memory_order_relaxed);
+    }
+
+    uint32_t getOverflowCount() const
+    {
+        return overflowCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint32_t mask = N - 1;
+
+    // Producer side
+    alignas(cacheLineSize) std::atomic<uint32_t> tail{0};
+    uint32_t headCached = 0;
+    std::atomic<uint32_t> highWaterMark{0};
+    std::atomic<uint32_t> overflowCount{0};
+    // Consumer side
+    alignas(cacheLineSize) std::atomic<uint32_t> head{0};
+    uint32_t tailCached = 0;
+    alignas(cacheLineSize) T slots[N];
+};
+
+// Bounded multiple producer single consumer ring (Vyukov's sequenced cells),
+// push from any task or core and pop from exactly one task
+template <typename T, size_t N>
+class MpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "Capacity must be a power of 2");
+
+public:
+    static constexpr size_t capacity = N;
+
+    MpscQueue()
+    {
+        for (uint32_t i = 0; i < N; i++)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    // Any producer, returns false and counts an overflow when full
+    bool tryPush(const T &value)
+    {
+        uint32_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &cells[pos & mask];
+            uint32_t seq = cell->seq.load(std::memory_order_acquire);
+            int32_t diff = (int32_t)(seq - pos);
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                overflowCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        LockFreeQueueDetail::updateMax(highWaterMark,
+            pos + 1 - dequeuePos.load(std::memory_order_relaxed));
+        return true;
+    }
+
+    // Consumer only, returns the oldest published element in place or nullptr when empty,
+    // it stays valid until pop()
+    T *front()
+    {
+        uint32_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell &cell = cells[pos & mask];
+        if (cell.seq.load(std::memory_order_acquire) != pos + 1)
+            return nullptr;
+        return &cell.value;
+    }
+
+    // Consumer only, must follow a non null front()
+    void pop()
+    {
+        uint32_t pos = dequeuePos.load(std::memory_order_relaxed);
+        cells[pos & mask].seq.store(pos + N, std::memory_order_release);
+        dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    }
+
+    // Consumer only
+    bool tryPop(T &out)
+    {
+        T *value = front();
+        if (!value)
+            return false;
+        out = *value;
+        pop();
+        return true;
+    }
+
+    // Counts claimed cells, including ones whose producers are still writing
+    uint32_t size() const
+    {
+        return enqueuePos.load(std::memory_order_relaxed) - dequeuePos.load(std::memory_order_relaxed);
+    }
+
+    // Consumer only, exact for the consumer
+    bool isEmpty()
+    {
+        return front() == nullptr;
+    }
+
+    uint32_t getHighWaterMark() const
+    {
+        return highWaterMark.load(std::memory_order_relaxed);
+    }
+
+    uint32_t getOverflowCount() const
+    {
+        return overflowCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint32_t mask = N - 1;
+
+    struct Cell
+    {
+        std::atomic<uint32_t> seq;
+        T value;
+    };
+
+    alignas(cacheLineSize) std::atomic<uint32_t> enqueuePos{0};
+    std::atomic<uint32_t> highWaterMark{0};
+    std::atomic<uint32_t> overflowCount{0};
+    alignas(cacheLineSize) std::atomic<uint32_t> dequeuePos{0};
+    alignas(cacheLineSize) Cell cells[N];
+};
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include <Arduino.h>
+#include <atomic>
+#include <cstring>
+#define LIBCALL_DEEP_SLEEP_SCHEDULER
+#include <DeepSleepScheduler.h>
+#include "Serial/Handshake.h"
+#include "Utils/Log.h"
+#include "Utils/PacketUtils.h"
+
+namespace Log
+{
+    // How long a record can wait for others to share its packet
+    static constexpr uint32_t batchDelayMillis = 20;
+
+    // Records logged on one core, only touched from that core
+    class Batch : public Runnable
+    {
+    public:
+        void run() override
+        {
+            scheduled = false;
+            send();
+        }
+
+        void append(const uint8_t *record, size_t length)
+        {
+            if (packet.length + length > LogPacket::sizeRecords)
+                send();
+            memcpy(packet.records.data() + packet.length, record, length);
+            packet.length += length;
+            if (!scheduled)
+            {
+                scheduled = true;
+                Scheduler::forCurrentCore().scheduleDelayed(this, batchDelayMillis);
+            }
+        }
+
+        void send()
+        {
+            if (packet.length == 0)
+                return;
+            PacketUtils::send(PacketType::Log, packet);
+            packet.length = 0;
+        }
+
+    private:
+        LogPacket packet{};
+        bool scheduled = false;
+    };
+
+    static Batch batches[portNUM_PROCESSORS];
+    static std::atomic<Level> minLevel(Level::Debug);
+    static std::atomic<uint32_t> truncatedCount(0);
+
+    void setLevel(Level level)
+    {
+        minLevel.store(level, std::memory_order_relaxed);
+    }
+
+    bool isEnabled(Level level)
+    {
+        return level >= minLevel.load(std::memory_order_relaxed);
+    }
+
+    void commit(const uint8_t *record, size_t length)
+    {
+        batches[xPortGetCoreID()].append(record, length);
+    }
+
+    void flush()
+    {
+        batches[xPortGetCoreID()].send();
+    }
+
+    uint32_t getTruncatedCount()
+    {
+        return truncatedCount.load(std::memory_order_relaxed);
+    }
+
+    bool isDeferred()
+    {
+        return Handshake::getSharedCapabilities() & HelloPacket::CapDeferredLog;
+    }
+
+    void countTruncated()
+    {
+        truncatedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,259 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <cstring>
+#include <string_view>
+#include "Serial/SerialPackets.h"
+#include "Utils/Format.h"
+#include "Utils/PacketUtils.h"
+
+// Deferred logging, a call site only sends the id of its format string and its raw arguments,
+// the host turns them into text with logdict.json, which scripts/gen_logdict.py generates from the
+// LOG_* calls on every build, so the format has to be a single string literal,
+// records are batched per core into Log packets, don't log from interrupts
+//
+// LOG_INFO("Sent {} packets in {:.1} s", count, secs);
+
+// Calls below this level are compiled out, 0 debug, 1 info, 2 warn, 3 error
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 1
+#endif
+// Records per call site per second, the rest are dropped and counted in the next record
+#ifndef LOG_RATE_LIMIT
+#define LOG_RATE_LIMIT 10
+#endif
+
+#define LOG_AT(level, format, ...)                                                          \
+    do                                                                                      \
+    {                                                                                       \
+        if constexpr ((uint8_t)(level) >= LOG_MIN_LEVEL)                                    \
+        {                                                                                   \
+            static Log::Site logSite;                                                       \
+            if (Log::isEnabled(level) && logSite.allow())                                   \
+            {                                                                               \
+                constexpr uint32_t logId = Log::idOf(format);                               \
+                Log::write(logId, level, logSite, format __VA_OPT__(, ) __VA_ARGS__);       \
+            }                                                                               \
+        }                                                                                   \
+    } while (0)
+
+#define LOG_DEBUG(format, ...) LOG_AT(Log::Level::Debug, format __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_INFO(format, ...) LOG_AT(Log::Level::Info, format __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_WARN(format, ...) LOG_AT(Log::Level::Warn, format __VA_OPT__(, ) __VA_ARGS__)
+#define LOG_ERROR(format, ...) LOG_AT(Log::Level::Error, format __VA_OPT__(, ) __VA_ARGS__)
+
+namespace Log
+{
+    enum class Level : uint8_t
+    {
+        Debug,
+        Info,
+        Warn,
+        Error,
+    };
+
+    // Precedes every argument, a string is followed by its length byte
+    enum class Tag : uint8_t
+    {
+        Bool,
+        Char,
+        I32,
+        U32,
+        I64,
+        U64,
+        F32,
+        Fixed, // F32 followed by the precision byte
+        String,
+    };
+
+    // Bytes before the arguments
+    constexpr size_t sizeRecordHeader = sizeof(uint8_t) + sizeof(uint32_t) * 2 + sizeof(uint8_t) * 2;
+    // Longer string arguments are cut
+    constexpr size_t maxStringLength = 32;
+
+    // 32 bit FNV-1a of the format, gen_logdict.py hashes the same way
+    consteval uint32_t idOf(std::string_view format)
+    {
+        uint32_t hash = 2166136261u;
+        for (char c : format)
+        {
+            hash ^= (uint8_t)c;
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    // Per call site rate limit, best effort if the site logs from both cores
+    class Site
+    {
+    public:
+        // Returns false if this call is over the limit and should be dropped
+        bool allow()
+        {
+            uint32_t now = millis();
+            if (now - windowStartMillis >= 1000)
+            {
+                windowStartMillis = now;
+                countInWindow = 0;
+            }
+            if (countInWindow < LOG_RATE_LIMIT)
+            {
+                countInWindow++;
+                return true;
+            }
+            if (dropped < UINT8_MAX)
+                dropped++;
+            return false;
+        }
+
+        // Calls dropped since the last record, saturates at 255
+        uint8_t takeDropped()
+        {
+            uint8_t n = dropped;
+            dropped = 0;
+            return n;
+        }
+
+    private:
+        uint32_t windowStartMillis = 0;
+        uint16_t countInWindow = 0;
+        uint8_t dropped = 0;
+    };
+
+    void setLevel(Level level);
+
+    bool isEnabled(Level level);
+
+    // Appends a finished record to the batch of the calling core,
+    // the batch is sent when the next record doesn't fit or soon after its first record
+    void commit(const uint8_t *record, size_t length);
+
+    // Sends the batch of the calling core right away
+    void flush();
+
+    // Records cut short because their arguments didn't fit a packet
+    uint32_t getTruncatedCount();
+
+    // False if the host said hello without CapDeferredLog, it can't render Log packets then
+    bool isDeferred();
+
+    // Appends tagged arguments, stops at the first one that doesn't fit
+    class Encoder
+    {
+    public:
+        Encoder(uint8_t *buf, size_t capacity) : buf(buf), capacity(capacity)
+        {
+        }
+
+        template <typename T>
+        void put(const T &value)
+        {
+            if (!truncated && length + sizeof(T) <= capacity)
+            {
+                memcpy(buf + length, &value, sizeof(T));
+                length += sizeof(T);
+            }
+            else
+                truncated = true;
+        }
+
+        template <typename T>
+        void putArg(const T &value)
+        {
+            using Fmt::Detail::Kind;
+            constexpr Kind kind = Fmt::Detail::kindOf<T>();
+            if (truncated)
+                return;
+            size_t start = length;
+            if constexpr (kind == Kind::Bool)
+                putTagged(Tag::Bool, (uint8_t)value);
+            else if constexpr (kind == Kind::Char)
+                putTagged(Tag::Char, value);
+            else if constexpr (kind == Kind::Signed)
+            {
+                if constexpr (sizeof(T) <= sizeof(int32_t))
+                    putTagged(Tag::I32, (int32_t)value);
+                else
+                    putTagged(Tag::I64, (int64_t)value);
+            }
+            else if constexpr (kind == Kind::Unsigned)
+            {
+                if constexpr (sizeof(T) <= sizeof(uint32_t))
+                    putTagged(Tag::U32, (uint32_t)value);
+                else
+                    putTagged(Tag::U64, (uint64_t)value);
+            }
+            else if constexpr (kind == Kind::Float)
+                putTagged(Tag::F32, (float)value);
+            else if constexpr (kind == Kind::Fixed)
+            {
+                putTagged(Tag::Fixed, value.value);
+                put(value.precision);
+            }
+            else
+            {
+                std::string_view s = value;
+                s = s.substr(0, maxStringLength);
+                putTagged(Tag::String, (uint8_t)s.size());
+                if (!truncated && length + s.size() <= capacity)
+                {
+                    memcpy(buf + length, s.data(), s.size());
+                    length += s.size();
+                }
+                else
+                    truncated = true;
+            }
+            if (truncated)
+                length = start; // Drop the partial argument
+        }
+
+        size_t getLength() const
+        {
+            return length;
+        }
+
+        bool isTruncated() const
+        {
+            return truncated;
+        }
+
+    private:
+        uint8_t *buf;
+        size_t capacity;
+        size_t length = 0;
+        bool truncated = false;
+
+        template <typename T>
+        void putTagged(Tag tag, const T &value)
+        {
+            put(tag);
+            put(value);
+        }
+    };
+
+    // Used by write()
+    void countTruncated();
+
+    // Called by LOG_AT, the format is only checked against the arguments, the host has the text
+    template <typename... Args>
+    void write(uint32_t id, Level level, Site &site, Fmt::FormatStringFor<Args...> formatString, const Args &...args)
+    {
+        if (!isDeferred())
+        {
+            PacketUtils::formatlnToPackets(formatString, args...);
+            return;
+        }
+        uint8_t record[LogPacket::sizeRecords];
+        Encoder e(record, sizeof(record));
+        e.put((uint8_t)0); // Length, filled in below
+        e.put(id);
+        e.put((uint32_t)millis());
+        e.put(level);
+        e.put(site.takeDropped());
+        (e.putArg(args), ...);
+        if (e.isTruncated())
+            countTruncated();
+        record[0] = (uint8_t)e.getLength();
+        commit(record, e.getLength());
+    }
+}
\ No newline at end of file
@@ -21,33 +21,21 @@ namespace PacketUtils
 
     void printToPackets(std::string_view str)
     {
-        size_t len = str.length();
-        for (uint32_t chunkIndex = 0; chunkIndex < len; chunkIndex += TextPacket::sizeStr)
-        {
-            std::string_view slice = str.substr(chunkIndex, TextPacket::sizeStr);
-            TextPacket p{
-                .length = slice.length(),
-                .hasNext = slice.size() == TextPacket::sizeStr && len > TextPacket::sizeStr};
-            slice.copy(p.string.data(), slice.size());
-            serial.send(PacketType::Text, &p, sizeof(p));
-        }
+        formatToPackets("{}", str);
     }
 
     void printlnToPackets(std::string_view str)
     {
-        size_t len = str.length();
-        for (uint32_t chunkIndex = 0; chunkIndex < len; chunkIndex += TextPacket::sizeStr)
-        {
-            std::string_view slice = str.substr(chunkIndex, TextPacket::sizeStr);
-            TextPacket p{
-                .length = slice.length(),
-                .hasNext = true};
-            slice.copy(p.string.data(), slice.size());
-            serial.send(PacketType::Text, &p, sizeof(p));
-        }
-        TextPacket p{
-            .length = 1,};
-        p.string[0] = '\n';
+        formatlnToPackets("{}", str);
+    }
+
+    void sendTextPart(void *context, const char *data, size_t length, bool more)
+    {
+        if (length == 0 && !more)
+            return; // Nothing was formatted
+        TextPacket &p = *static_cast<TextPacket *>(context);
+        p.length = length;
+        p.hasNext = more;
         serial.send(PacketType::Text, &p, sizeof(p));
     }
 }
\ No newline at end of file
@@ -4,36 +4,51 @@
 #include <iomanip>
 #include "Serial/SerialManager.h"
 #include "Serial/SerialPackets.h"
+#include "Utils/Format.h"
 #include "Utils/Utils.h"    
 
 namespace PacketUtils
 {
     template <typename T>
     requires (sizeof(T) == sizeof(SerialPacket::Inner))
-    inline SerialPacketTyped<T> as(SerialPacket packet)
+    inline const SerialPacketTyped<T> &as(const SerialPacket &packet)
     {
-        return *reinterpret_cast<SerialPacketTyped<T> *>(&packet);
+        return *reinterpret_cast<const SerialPacketTyped<T> *>(&packet);
     }
 
     template <typename T>
     requires (sizeof(T) == sizeof(SerialPacket::Inner))
-    inline T innerAs(SerialPacket packet)
+    inline const T &innerAs(const SerialPacket &packet)
     {
-        return (*reinterpret_cast<SerialPacketTyped<T> *>(&packet)).inner;
+        return as<T>(packet).inner;
     }
 
     template <typename T>
         requires(sizeof(T) == sizeof(SerialPacket::Inner))
-    inline void send(PacketType type, T &packet)
+    inline bool send(PacketType type, T &packet)
     {
-        serial.send(type, &packet, sizeof(T));
+        return serial.send(type, &packet, sizeof(T));
     }
 
     template <typename T>
         requires(sizeof(T) == sizeof(SerialPacket::Inner))
-    inline void send(PacketType type, T &&packet)
+    inline bool send(PacketType type, T &&packet)
     {
-        serial.send(type, &packet, sizeof(T));
+        return serial.send(type, &packet, sizeof(T));
+    }
+
+    template <typename T>
+        requires(sizeof(T) == sizeof(SerialPacket::Inner))
+    inline bool send(PacketType type, T &packet, TxClass cls)
+    {
+        return serial.send(type, &packet, sizeof(T), cls);
+    }
+
+    template <typename T>
+        requires(sizeof(T) == sizeof(SerialPacket::Inner))
+    inline bool send(PacketType type, T &&packet, TxClass cls)
+    {
+        return serial.send(type, &packet, sizeof(T), cls);
     }
 
     template <typename TFrom, typename TTo>
@@ -49,6 +64,12 @@ namespace PacketUtils
         return reinterpNarrowing<ConfigurePacket::Data, TTo>(from);
     }
 
+    template <typename TTo>
+    inline const TTo &getConfigureDataAs(const ConfigurePacket::Data &from)
+    {
+        return *reinterpret_cast<const TTo *>(&from);
+    }
+
     std::string getBytesHex(SerialPacket& packet, uint32_t groupSize = 8, uint32_t groupsPerLine = 4);
 
     inline void sendConfigureAck(ConfigurePacket::Type type, ConfigurePacket::Val ack)
@@ -64,17 +85,26 @@ namespace PacketUtils
 
     void printlnToPackets(std::string_view str);
 
+    // Fmt::Writer flush function for a TextPacket context whose string the writer fills
+    void sendTextPart(void *context, const char *data, size_t length, bool more);
+
+    // Formats straight into TextPackets, a full packet is sent each time the text outgrows it
     template <typename... Args>
-    void printfToPackets(const char *format, Args... args)
+    void formatToPackets(Fmt::FormatStringFor<Args...> formatString, const Args &...args)
     {
-        std::string s = Utils::stringSprintf(format, args...);
-        printToPackets(s);
+        TextPacket p{};
+        Fmt::Writer w(p.string.data(), p.string.size(), sendTextPart, &p);
+        Fmt::formatTo(w, formatString, args...);
+        w.finish();
     }
 
     template <typename... Args>
-    void printlnfToPackets(const char *format, Args... args)
+    void formatlnToPackets(Fmt::FormatStringFor<Args...> formatString, const Args &...args)
     {
-        std::string s = Utils::stringSprintf(format, args...);
-        printlnToPackets(s);
+        TextPacket p{};
+        Fmt::Writer w(p.string.data(), p.string.size(), sendTextPart, &p);
+        Fmt::formatTo(w, formatString, args...);
+        w.put('\n');
+        w.finish();
     }
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include <Arduino.h>
+#include "main.h"
+#include "Utils/I2cArbiter.h"
+#include "Utils/SensorConfig.h"
+
+namespace SensorConfig
+{
+    static constexpr Config defaultConfig = {
+        .accelRange = (uint8_t)ACCEL_FS::A8G,
+        .gyroRange = (uint8_t)GYRO_FS::G1000DPS,
+        .dlpfMode = MPU6050_DLPF_BW_256,
+        .rateDivider = 0};
+
+    static std::array<Config, sensorCount> applied;
+    static std::array<float, sensorCount> accelResolutions;
+    static std::array<float, sensorCount> gyroResolutions;
+    static std::array<Config, sensorCount> pending;
+    static uint8_t pendingMask = 0;
+    static uint8_t generation = 0;
+
+    static bool isValid(const Config &config)
+    {
+        return config.accelRange <= (uint8_t)ACCEL_FS::A16G &&
+            config.gyroRange <= (uint8_t)GYRO_FS::G2000DPS &&
+            config.dlpfMode <= MPU6050_DLPF_BW_5;
+    }
+
+    static void store(uint8_t i, const Config &config)
+    {
+        applied[i] = config;
+        // Each range step doubles the full scale of 2 g and 250 dps over the 16 bit readings,
+        // the library only updates its own resolution in initialize()
+        accelResolutions[i] = (2 << config.accelRange) / 32768.0f;
+        gyroResolutions[i] = (250 << config.gyroRange) / 32768.0f;
+    }
+
+    void initialize(uint8_t i)
+    {
+        mpus[i].initialize((ACCEL_FS)defaultConfig.accelRange, (GYRO_FS)defaultConfig.gyroRange);
+        mpus[i].setDLPFMode(defaultConfig.dlpfMode);
+        mpus[i].setRate(defaultConfig.rateDivider);
+        store(i, defaultConfig);
+    }
+
+    bool request(const ConfigurePacket::SensorConfigs &configs)
+    {
+        for (uint8_t i = 0; i < sensorCount; i++)
+            if (configs.sensorMask & (1 << i) && !isValid(configs.sensors[i]))
+                return false;
+        for (uint8_t i = 0; i < sensorCount; i++)
+            if (configs.sensorMask & (1 << i))
+                pending[i] = configs.sensors[i];
+        pendingMask |= configs.sensorMask & ((1 << sensorCount) - 1);
+        return true;
+    }
+
+    bool applyPending()
+    {
+        if (!pendingMask)
+            return false;
+        for (uint8_t i = 0; i < sensorCount; i++)
+        {
+            if (!(pendingMask & (1 << i)))
+                continue;
+            const Config &config = pending[i];
+            {
+                I2cArbiter::SensorGuard guard(i < 2 ? wireArbiter : wire1Arbiter);
+                mpus[i].setFullScaleAccelRange(config.accelRange);
+                mpus[i].setFullScaleGyroRange(config.gyroRange);
+                mpus[i].setDLPFMode(config.dlpfMode);
+                mpus[i].setRate(config.rateDivider);
+            }
+            store(i, config);
+        }
+        pendingMask = 0;
+        generation++;
+        return true;
+    }
+
+    ConfigurePacket::SensorConfigs get()
+    {
+        return ConfigurePacket::SensorConfigs{
+            .sensorMask = (1 << sensorCount) - 1,
+            .generation = generation,
+            .sensors = applied};
+    }
+
+    uint8_t getGeneration()
+    {
+        return generation;
+    }
+
+    const Config &get(uint8_t i)
+    {
+        return applied[i];
+    }
+
+    float getAccelResolution(uint8_t i)
+    {
+        return accelResolutions[i];
+    }
+
+    float getGyroResolution(uint8_t i)
+    {
+        return gyroResolutions[i];
+    }
+}
\ No newline at end of file
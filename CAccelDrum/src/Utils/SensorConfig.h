@@ -0,0 +1,37 @@
+#pragma once
+#include <Arduino.h>
+#include "Serial/SerialPackets.h"
+
+// Full scale ranges, low-pass filter and sample divider of each mpu, changed by the host at runtime,
+// a change is only queued when it arrives and written by the sampling task before its next sample set,
+// so every pack of a set and the scale it's converted with come from the same config
+namespace SensorConfig
+{
+    using Config = ConfigurePacket::SensorConfig;
+
+    constexpr uint8_t sensorCount = 4;
+
+    // Initializes mpus[i] with the default config
+    void initialize(uint8_t i);
+
+    // Queues the configs of the sensors in the mask over any queued before, returns false without queueing
+    // anything if a value is out of range, called on the sampling core
+    bool request(const ConfigurePacket::SensorConfigs &configs);
+
+    // Writes the queued configs, returns false if there were none, called by the sampling task between sample sets
+    bool applyPending();
+
+    // The applied configs of all sensors
+    ConfigurePacket::SensorConfigs get();
+
+    // Bumped by every applied change
+    uint8_t getGeneration();
+
+    const Config &get(uint8_t i);
+
+    // g per LSB
+    float getAccelResolution(uint8_t i);
+
+    // Degrees per second per LSB
+    float getGyroResolution(uint8_t i);
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include <Arduino.h>
+#define LIBCALL_DEEP_SLEEP_SCHEDULER
+#include <DeepSleepScheduler.h>
+#include <cstring>
+#include "display/display.h"
+#include "Serial/SerialManager.h"
+#include "Utils/Telemetry.h"
+
+namespace Telemetry
+{
+    // The tasks worth watching, the Scheduler task runs the display and the buttons on core 0,
+    // loopTask runs sampling, serial and the boot calibration on core 1
+    static constexpr const char *watchedTasks[] = {"loopTask", "Scheduler", "uart_event_task", "esp_timer"};
+    static_assert(std::size(watchedTasks) <= TelemetryPacket::maxTasks);
+    static_assert((size_t)TxClass::Count == LinkStatsPacket::txClassCount);
+
+    static uint32_t lastMicros = 0;
+    static uint32_t lastSampleSets = 0;
+
+    TelemetryPacket makePacket(uint32_t sampleSetsSent)
+    {
+        uint32_t now = micros();
+        uint32_t elapsed = now - lastMicros;
+        TelemetryPacket packet{};
+        packet.uptimeMillis = millis();
+        for (BaseType_t core = 0; core < portNUM_PROCESSORS && core < (BaseType_t)packet.coreBusyPermille.size(); core++)
+            if (Scheduler *s = Scheduler::forCore(core))
+                packet.coreBusyPermille[core] = s->getUtilizationPermille();
+
+        packet.freeHeap = ESP.getFreeHeap();
+        packet.minFreeHeap = ESP.getMinFreeHeap();
+        packet.largestFreeBlock = ESP.getMaxAllocHeap();
+        packet.sampleSetsMilliHz = elapsed ? (uint64_t)(sampleSetsSent - lastSampleSets) * 1'000'000'000 / elapsed : 0;
+
+        Display::FrameStats frameStats = display.getFrameStats();
+        packet.lcdFrames = frameStats.frames;
+        packet.lcdLastFrameBytes = frameStats.lastFrameBytes;
+        packet.lcdMaxFrameBytes = frameStats.maxFrameBytes;
+        packet.lcdAvgFrameBytes = frameStats.frames ? frameStats.totalBytes / frameStats.frames : 0;
+
+        for (const char *name : watchedTasks)
+        {
+            // ESP-IDF reports the high-water mark in bytes instead of words
+            TaskHandle_t handle = xTaskGetHandle(name);
+            if (!handle)
+                continue;
+            TelemetryPacket::Task &task = packet.tasks[packet.taskCount++];
+            strncpy(task.name.data(), name, task.name.size());
+            task.stackFreeMinBytes = min(uxTaskGetStackHighWaterMark(handle), (UBaseType_t)UINT16_MAX);
+        }
+
+        lastMicros = now;
+        lastSampleSets = sampleSetsSent;
+        return packet;
+    }
+
+    LinkStatsPacket makeLinkStats()
+    {
+        LinkStatsPacket packet{};
+        packet.rxBytes = serial.getBytesReceived();
+        packet.rxPackets = serial.getPacketCount();
+        packet.rxCorrupt = serial.getCorruptedPacketCount();
+        packet.rxLost = serial.getLostPacketCount();
+        packet.rxOverflow = serial.getInboundOverflowCount();
+        packet.rxBudgetExhausted = serial.getRxBudgetExhaustedCount();
+        packet.drainBudgetExhausted = serial.getDrainBudgetExhaustedCount();
+        packet.maxDrainBatch = serial.getMaxDrainBatch();
+        packet.inboundHighWaterMark = serial.getInboundHighWaterMark();
+        packet.txBytes = serial.getBytesSent();
+        packet.reliableDropped = serial.getReliableDropCount();
+        packet.retransmits = serial.getRetransmitCount();
+        for (size_t i = 0; i < (size_t)TxClass::Count; i++)
+        {
+            TxScheduler::ClassStats stats = serial.getTxStats((TxClass)i);
+            packet.txClasses[i] = {stats.sent, stats.dropped, stats.avgWaitMicros(), stats.maxWaitMicros};
+        }
+        return packet;
+    }
+}
\ No newline at end of file
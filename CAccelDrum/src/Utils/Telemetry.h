@@ -0,0 +1,13 @@
+#pragma once
+#include <Arduino.h>
+#include "Serial/SerialPackets.h"
+
+// Periodic health report of the device, see TelemetryPacket
+namespace Telemetry
+{
+    // Loads and rates are over the time since the previous call, called on the sampling core
+    TelemetryPacket makePacket(uint32_t sampleSetsSent);
+
+    // Counters of the serial link since boot, the dispatcher's counts are left to its owner
+    LinkStatsPacket makeLinkStats();
+}
\ No newline at end of file
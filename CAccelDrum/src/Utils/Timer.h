@@ -1,14 +1,120 @@
 #pragma once
 #include <Arduino.h>
+#include <esp_cpu.h>
+#include <esp_timer.h>
 #include <limits>
+#include "Histogram.h"
 
+// Time sources for Timer, picked at compile time so reading one is an inlined call,
+// Rep is unsigned so differences stay correct across a wrap
+namespace Clocks
+{
+    struct Millis
+    {
+        using Rep = uint32_t;
+
+        static Rep now()
+        {
+            return ::millis();
+        }
+
+        static uint32_t toMicros(Rep ticks)
+        {
+            return min(ticks, (Rep)(std::numeric_limits<uint32_t>::max() / 1000)) * 1000;
+        }
+
+        static uint32_t toNanos(Rep ticks)
+        {
+            return min(ticks, (Rep)(std::numeric_limits<uint32_t>::max() / 1'000'000)) * 1'000'000;
+        }
+    };
+
+    struct Micros
+    {
+        using Rep = uint64_t;
+
+        static Rep now()
+        {
+            return esp_timer_get_time();
+        }
+
+        static uint32_t toMicros(Rep ticks)
+        {
+            return (uint32_t)min(ticks, (Rep)std::numeric_limits<uint32_t>::max());
+        }
+
+        static uint32_t toNanos(Rep ticks)
+        {
+            return (uint32_t)min(ticks * 1000, (Rep)std::numeric_limits<uint32_t>::max());
+        }
+    };
+
+    // Cpu cycle counter of the calling core, a single instruction to read,
+    // wraps every 2^32 cycles (about 17 s at 240 MHz) and isn't comparable across cores
+    struct Cycles
+    {
+        using Rep = uint32_t;
+
+        static Rep now()
+        {
+            return esp_cpu_get_cycle_count();
+        }
+
+        static uint32_t toMicros(Rep ticks)
+        {
+            return ticks / getCpuFrequencyMhz();
+        }
+
+        static uint32_t toNanos(Rep ticks)
+        {
+            return (uint32_t)min((uint64_t)ticks * 1000 / getCpuFrequencyMhz(), (uint64_t)std::numeric_limits<uint32_t>::max());
+        }
+    };
+
+    // Advanced by hand, ticks are micros, Tag keeps independent test clocks apart
+    template <typename Tag = void>
+    struct Test
+    {
+        using Rep = uint64_t;
+
+        static inline Rep value = 0;
+
+        static Rep now()
+        {
+            return value;
+        }
+
+        static void set(Rep v)
+        {
+            value = v;
+        }
+
+        static void advance(Rep ticks)
+        {
+            value += ticks;
+        }
+
+        static uint32_t toMicros(Rep ticks)
+        {
+            return (uint32_t)ticks;
+        }
+
+        static uint32_t toNanos(Rep ticks)
+        {
+            return (uint32_t)(ticks * 1000);
+        }
+    };
+}
+
+template <typename Clock = Clocks::Millis>
 class Timer
 {
 public:
-    typedef std::function<uint64_t()> TimeFunction;
+    using Rep = typename Clock::Rep;
 
-    Timer(uint64_t threshold = 0, bool running = false, TimeFunction timeFunction = ::millis) :
-        threshold(threshold), running(running), timeFunction(timeFunction)
+    // threshold is in ticks of Clock
+    Timer(Rep threshold = 0, bool running = false) :
+        threshold(threshold), running(running), startTime(running ? Clock::now() : 0)
     {
     }
 
@@ -20,7 +126,7 @@ public:
     Timer& start()
     {
         running = true;
-        startTime = timeFunction();
+        startTime = Clock::now();
         return *this;
     }
 
@@ -35,14 +141,25 @@ public:
         return *this;
     }
 
-    uint64_t elapsedTime()
+    // In ticks of Clock
+    Rep elapsedTime()
+    {
+        return running ? (Rep)(Clock::now() - startTime) : 0;
+    }
+
+    uint32_t elapsedMicros()
     {
-        return running ? timeFunction() - startTime : 0;
+        return Clock::toMicros(elapsedTime());
+    }
+
+    uint32_t elapsedNanos()
+    {
+        return Clock::toNanos(elapsedTime());
     }
 
     bool isElapsed()
     {
-        return running ? timeFunction() - startTime >= threshold : false;
+        return running ? (Rep)(Clock::now() - startTime) >= threshold : false;
     }
 
     bool checkAndResetIfElapsed()
@@ -53,8 +170,29 @@ public:
         return elapsed;
     }
 private:
-    uint64_t startTime = 0;
-    uint64_t threshold = 0;
-    TimeFunction timeFunction;
+    Rep threshold = 0;
     bool running = false;
+    Rep startTime = 0;
+};
+
+// Records the nanos between construction and destruction into the histogram
+template <typename Clock = Clocks::Cycles, typename THistogram = Histogram<>>
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(THistogram &histogram) : histogram(histogram), startTime(Clock::now())
+    {
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    ~ScopedTimer()
+    {
+        histogram.record(Clock::toNanos((typename Clock::Rep)(Clock::now() - startTime)));
+    }
+
+private:
+    THistogram &histogram;
+    typename Clock::Rep startTime;
 };
\ No newline at end of file
@@ -1,14 +1,16 @@
 #include <Arduino.h>
 #include <string>
+#include "Utils/Format.h"
+#include "Utils/Utils.h"
 
 namespace Utils
 {
-    int formatMetric(char *buf, size_t size, uint32_t num, uint32_t decimalPlaces = 1)
+    int formatMetric(char *buf, size_t size, uint32_t num, uint32_t decimalPlaces)
     {
         if (num >= 1'000'000)
-            return snprintf(buf, size, "%.*fm", decimalPlaces, num / 1'000'000.0f);
+            return Fmt::formatTo(buf, size, "{}m", Fmt::Fixed{num / 1'000'000.0f, (uint8_t)decimalPlaces});
         else if (num >= 1'000)
-            return snprintf(buf, size, "%.*fk", decimalPlaces, num / 1'000.0f);
-        return snprintf(buf, size, "%u", num);
+            return Fmt::formatTo(buf, size, "{}k", Fmt::Fixed{num / 1'000.0f, (uint8_t)decimalPlaces});
+        return Fmt::formatTo(buf, size, "{}", num);
     }
 }
\ No newline at end of file
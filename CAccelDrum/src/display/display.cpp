@@ -6,57 +6,111 @@
 #include <cstdio>
 #include <string_view>
 #include "main.h"
-#include "Display.h"
+#include "display.h"
 #include "Utils/Utils.h"
 
 Display display;
 
-Display::Display() : lcd(0x27, 20, 4),
-                     lcdOverlayTimeoutMillis(0),
-                     lcdBufOverlay{},
-                     lcdBufNew{},
+Display::Display() : lcd(0x27, 20, 4, DISPLAY_WIRE),
+                     frames{},
+                     frameStates{},
+                     published(0),
+                     reading(noFrame),
                      lcdBufOld{},
                      backlight(false),
-                     theLock()
-{
-    init();
-}
-
-void Display::init()
+                     cursorCol(cols),
+                     cursorRow(0),
+                     frameStats{},
+                     widgets(nullptr),
+                     widgetsCleared(false),
+                     arbiter(I2cArbiter::forWire(DISPLAY_WIRE)),
+                     microsPerCell(150),
+                     framePending(false)
 {
     for (uint32_t row = 0; row < bufRows; row++)
     {
         memset(lcdBufOld[row], ' ', cols);
-        memset(lcdBufNew[row], ' ', cols);
         *reinterpret_cast<uint32_t*>(&lcdBufOld[row][cols + 1]) = 0xDEADBEFF;
-        *reinterpret_cast<uint32_t*>(&lcdBufNew[row][cols + 1]) = 0xDEADBEFF;
-        *reinterpret_cast<uint32_t*>(&lcdBufOverlay[row][cols + 1]) = 0xDEADBEFF;
+        for (Frame &frame : frames)
+        {
+            memset(frame.text[row], ' ', cols);
+            *reinterpret_cast<uint32_t*>(&frame.text[row][cols + 1]) = 0xDEADBEFF;
+            *reinterpret_cast<uint32_t*>(&frame.overlay[row][cols + 1]) = 0xDEADBEFF;
+        }
     }
+    frameStates[indexOf(published.load())].store(FrameState::Published);
+}
+
+void Display::init()
+{
     lcd.begin(16, 2);
+    cursorCol = cols;
 }
 
 void Display::clear()
 {
-    for (uint32_t j = 0; j < rows; j++)
-        memset(lcdBufNew[j], ' ', cols);
+    edit([](Frame &frame)
+    {
+        for (uint32_t j = 0; j < rows; j++)
+            memset(frame.text[j], ' ', cols);
+    });
+    widgetsCleared.store(true, std::memory_order_release);
+}
+
+void Display::addWidget(Widgets::Widget &widget)
+{
+    Widgets::Widget **tail = &widgets;
+    while (*tail)
+        tail = &(*tail)->next;
+    widget.next = nullptr;
+    widget.invalidate();
+    *tail = &widget;
+}
+
+void Display::removeWidgets()
+{
+    while (widgets)
+    {
+        Widgets::Widget *next = widgets->next;
+        widgets->next = nullptr;
+        widgets = next;
+    }
+}
+
+void Display::createChar(uint8_t slot, uint8_t charmap[8])
+{
+    arbiter.acquire(I2cArbiter::Client::Display);
+    lcd.createChar(slot, charmap);
+    arbiter.release();
+    cursorCol = cols; // Left in CGRAM, the next write has to set the cursor
+}
+
+void Display::refreshWidgets()
+{
+    bool cleared = widgetsCleared.exchange(false, std::memory_order_acquire);
+    uint32_t now = millis();
+    for (Widgets::Widget *w = widgets; w; w = w->next)
+    {
+        if (cleared)
+            w->invalidate();
+        w->refresh(*this, now);
+    }
 }
 
 void Display::setBacklight(bool v)
 {
+    arbiter.acquire(I2cArbiter::Client::Display);
     if (v)
         lcd.backlight();
     else
         lcd.noBacklight();
+    arbiter.release();
     backlight = v;
 }
 
 bool Display::toggleBacklight()
 {
-    backlight = !backlight;
-    if (backlight)
-        lcd.backlight();
-    else
-        lcd.noBacklight();
+    setBacklight(!backlight);
     return backlight;
 }
 
@@ -65,135 +119,229 @@ bool Display::getBacklight() const
     return backlight;
 }
 
-ScopedLocker Display::lock()
+void Display::bufOverlayClear(Frame &frame)
 {
-    return theLock.lock();
+    frame.overlayTimeoutMillis = 0;
+    for (uint32_t j = 0; j < rows; j++)
+        memset(frame.overlay[j], '\0', cols);
 }
 
 void Display::overlayClear()
 {
-    lcdOverlayTimeoutMillis = 0;
-    for (uint32_t j = 0; j < rows; j++)
-        memset(lcdBufOverlay[j], '\0', cols);
+    edit(bufOverlayClear);
 }
 
-bool Display::bufPrintf(char buf[bufRows][bufCols], uint32_t col, uint32_t row, const char* s, va_list args)
+void Display::overlayClearIfTimeout(uint64_t timeoutMillis)
 {
-    if (row >= rows || col >= cols)
+    edit([&](Frame &frame)
+    {
+        if (frame.overlayTimeoutMillis == timeoutMillis)
+            bufOverlayClear(frame);
+    });
+}
+
+bool Display::bufPrint(char buf[bufRows][bufCols], uint32_t col, uint32_t row, const char c)
+{
+    if (col >= cols || row >= rows)
         return false;
-    uint32_t printBufSize = cols - col + 1;
-    char printBuf[printBufSize] = {0};
-    int32_t fullLen = vsnprintf(printBuf, printBufSize, s, args);
-    // Don't print directly to avoid writing the terminating null
-    memcpy(buf[row] + col, printBuf, min(fullLen, (int32_t)printBufSize - 1) * sizeof(char));
-    return fullLen >= 0 && fullLen < printBufSize;
+    buf[row][col] = c;
+    return true;
 }
 
-bool Display::printf(uint32_t col, uint32_t row, const char* s, ...)
+bool Display::print(uint32_t col, uint32_t row, const char c)
 {
-    va_list args;
-    va_start(args, s);
-    bool res = bufPrintf(lcdBufNew, col, row, s, args);
-    va_end(args);
-    return res;
+    return edit([&](Frame &frame)
+    {
+        return bufPrint(frame.text, col, row, c);
+    });
 }
 
-bool Display::overlayPrintf(uint32_t col, uint32_t row, uint64_t timeoutPeriodMs, const char* s, ...)
+bool Display::overlayPrint(uint32_t col, uint32_t row, uint64_t timeoutPeriodMs, const char c)
 {
-    lcdOverlayTimeoutMillis = millis() + timeoutPeriodMs;
-    va_list args;
-    va_start(args, s);
-    bool res = bufPrintf(lcdBufOverlay, col, row, s, args);
-    va_end(args);
-    return res;
+    uint64_t timeoutMillis = millis() + timeoutPeriodMs;
+    return edit([&](Frame &frame)
+    {
+        frame.overlayTimeoutMillis = timeoutMillis;
+        return bufPrint(frame.overlay, col, row, c);
+    });
 }
 
-bool Display::bufPrint(char buf[bufRows][bufCols], uint32_t col, uint32_t row, const char c)
+uint8_t Display::claimFrame()
 {
-    if (col >= cols || row >= rows)
+    while (true)
+    {
+        for (uint8_t i = 0; i < frameCount; i++)
+        {
+            FrameState expected = FrameState::Free;
+            if (!frameStates[i].compare_exchange_strong(expected, FrameState::Writing))
+                continue;
+            // Pairs with pinFrame(), either the reader sees the frame isn't published anymore or this sees the pin
+            if (reading.load() != i)
+                return i;
+            frameStates[i].store(FrameState::Free);
+        }
+        yield();
+    }
+}
+
+void Display::copyPublished(uint8_t mine, uint32_t &current)
+{
+    current = published.load(std::memory_order_acquire);
+    while (true)
+    {
+        frames[mine] = frames[indexOf(current)];
+        // The copied frame may have been retired and reused while copying, then it's torn,
+        // the fence keeps the copy from being reordered past the check
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint32_t latest = published.load(std::memory_order_relaxed);
+        if (latest == current)
+            return;
+        current = latest;
+    }
+}
+
+bool Display::tryPublish(uint8_t mine, uint32_t &current)
+{
+    uint32_t next = ((current >> 8) + 1) << 8 | mine;
+    // Marked before it's visible, a writer publishing right after could otherwise retire it first
+    // and have it marked published again, never to be freed
+    frameStates[mine].store(FrameState::Published, std::memory_order_relaxed);
+    if (!published.compare_exchange_strong(current, next, std::memory_order_acq_rel, std::memory_order_acquire))
+    {
+        frameStates[mine].store(FrameState::Writing, std::memory_order_relaxed);
         return false;
-    buf[row][col] = c;
+    }
+    frameStates[indexOf(current)].store(FrameState::Free, std::memory_order_release);
     return true;
 }
 
-bool Display::print(uint32_t col, uint32_t row, const char c)
+const Display::Frame &Display::pinFrame()
 {
-    return bufPrint(lcdBufNew, col, row, c);
+    while (true)
+    {
+        uint32_t current = published.load();
+        reading.store(indexOf(current));
+        // Still published after the pin was visible, so no writer can claim it anymore
+        if (published.load() == current)
+            return frames[indexOf(current)];
+    }
 }
 
-bool Display::overlayPrint(uint32_t col, uint32_t row, uint64_t timeoutPeriodMs, const char c)
+void Display::unpinFrame()
 {
-    lcdOverlayTimeoutMillis = millis() + timeoutPeriodMs;
-    return bufPrint(lcdBufOverlay, col, row, c);
+    reading.store(noFrame, std::memory_order_release);
 }
 
-bool Display::checkBufIntegrity()
+bool Display::checkBufIntegrity(const Frame &frame)
 {
     for (uint32_t j = 0; j < rows; j++)
     {
         if (lcdBufOld[j][cols] != '\0' ||
-            lcdBufNew[j][cols] != '\0' ||
-            lcdBufOverlay[j][cols] != '\0' ||
+            frame.text[j][cols] != '\0' ||
+            frame.overlay[j][cols] != '\0' ||
             memchr(lcdBufOld[j], '\0', cols) ||
-            memchr(lcdBufNew[j], '\0', cols) ||
+            memchr(frame.text[j], '\0', cols) ||
             *reinterpret_cast<uint32_t*>(&lcdBufOld[j][cols + 1]) != 0xDEADBEFF ||
-            *reinterpret_cast<uint32_t*>(&lcdBufNew[j][cols + 1]) != 0xDEADBEFF ||
-            *reinterpret_cast<uint32_t*>(&lcdBufOverlay[j][cols + 1]) != 0xDEADBEFF)
+            *reinterpret_cast<const uint32_t*>(&frame.text[j][cols + 1]) != 0xDEADBEFF ||
+            *reinterpret_cast<const uint32_t*>(&frame.overlay[j][cols + 1]) != 0xDEADBEFF)
         {
-            lcdOverlayTimeoutMillis = 0;
+            memset(lcdBufOld, ' ', sizeof(lcdBufOld));
+            lcdBufOld[0][cols] = '\0';
+            lcdBufOld[1][cols] = '\0';
             strcpy(lcdBufOld[0] + cols - strlen("buffer"), "buffer");
             strcpy(lcdBufOld[1] + cols - strlen("corrupt"), "corrupt");
-            strcpy(lcdBufNew[0] + cols - strlen("buffer"), "buffer");
-            strcpy(lcdBufNew[1] + cols - strlen("corrupt"), "corrupt");
             return false;
         }
     }
     return true;
 }
 
-void Display::update()
+bool Display::update()
 {
-    bool corrupted = !checkBufIntegrity();
-    if (corrupted)
+    refreshWidgets();
+    const Frame *frame = &pinFrame();
+    if (frame->overlayTimeoutMillis && millis() >= frame->overlayTimeoutMillis)
+    {
+        uint64_t expired = frame->overlayTimeoutMillis;
+        unpinFrame();
+        overlayClearIfTimeout(expired);
+        frame = &pinFrame();
+    }
+    if (!checkBufIntegrity(*frame))
     {
         analogWrite(ledPinDebug, debugLedBrightness);
         lcd.setCursor(0, 0);
-        lcd.print(lcdBufNew[0]);
+        lcd.print(lcdBufOld[0]);
         lcd.setCursor(0, 1);
-        lcd.print(lcdBufNew[1]);
+        lcd.print(lcdBufOld[1]);
         while (true);
     }
-    else if (lcdOverlayTimeoutMillis ||
-        memcmp(lcdBufOld, lcdBufNew, (bufCols * bufRows)) != 0)
+    uint32_t bytesBefore = lcd.getBytesWritten();
+    framePending = false;
+    for (uint32_t j = 0; j < rows && !framePending; j++)
+        framePending = !updateRow(*frame, j, frame->overlayTimeoutMillis != 0);
+    unpinFrame();
+    uint32_t frameBytes = lcd.getBytesWritten() - bytesBefore;
+    if (frameBytes)
     {
-        for (uint32_t j = 0; j < bufRows; j++)
-            memcpy(lcdBufOld[j], lcdBufNew[j], cols);
+        frameStats.frames++;
+        frameStats.lastFrameBytes = frameBytes;
+        frameStats.maxFrameBytes = max(frameStats.maxFrameBytes, frameBytes);
+        frameStats.totalBytes += frameBytes;
+    }
+    return !framePending;
+}
 
-        if (lcdOverlayTimeoutMillis)
+bool Display::updateRow(const Frame &source, uint32_t row, bool overlayShown)
+{
+    char frame[cols];
+    for (uint32_t i = 0; i < cols; i++)
+    {
+        const char car = source.overlay[row][i];
+        frame[i] = overlayShown && car != '\0' ? car : source.text[row][i];
+    }
+
+    uint32_t i = 0;
+    while (i < cols)
+    {
+        if (frame[i] == lcdBufOld[row][i])
         {
-            if (millis() < lcdOverlayTimeoutMillis)
-            {
-                for (uint32_t j = 0; j < bufRows; j++)
-                    for (uint32_t i = 0; i < cols; i++)
-                    {
-                        const char car = lcdBufOverlay[j][i];
-                        if (car != '\0')
-                            lcdBufOld[j][i] = car;
-                    }
-            }
-            else
-                overlayClear();
+            i++;
+            continue;
         }
+        uint32_t end = i + 1;
+        for (uint32_t k = end; k < cols && k - end <= maxRewrittenGap; k++)
+            if (frame[k] != lcdBufOld[row][k])
+                end = k + 1;
+        end = min(end, i + maxChunkCells); // The rest is still dirty and goes in the next chunk
 
-        lcd.setCursor(0, 0);
-        lcd.print(lcdBufOld[0]);
-        lcd.setCursor(0, 1);
-        lcd.print(lcdBufOld[1]);
+        bool moveCursor = cursorRow != row || cursorCol != i;
+        uint32_t cells = end - i + moveCursor;
+        if (!arbiter.tryAcquire(I2cArbiter::Client::Display, cells * microsPerCell))
+            return false;
+        uint32_t start = micros();
+        if (moveCursor)
+            lcd.setCursor(i, row);
+        lcd.write((const uint8_t *)frame + i, end - i);
+        arbiter.release();
+        microsPerCell = (microsPerCell * 3 + (micros() - start) / cells) / 4;
+
+        memcpy(lcdBufOld[row] + i, frame + i, end - i);
+        cursorRow = row;
+        cursorCol = end;
+        i = end;
     }
+    return true;
+}
+
+Display::FrameStats Display::getFrameStats() const
+{
+    return frameStats;
 }
 
 void Display::run()
 {
-    scheduler.scheduleDelayed(this, 100);
-    update();
+    // A frame cut short by a sensor read is finished in the next gap
+    bool done = update();
+    Scheduler::forCurrentCore().scheduleDelayed(this, done ? refreshMillis : pendingRetryMillis);
 }
\ No newline at end of file
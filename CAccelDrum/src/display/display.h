@@ -3,11 +3,23 @@
 #include <LiquidCrystal_I2C.h>
 #define LIBCALL_DEEP_SLEEP_SCHEDULER
 #include <DeepSleepScheduler.h>
-#include "Utils/Lock.h"
+#include <atomic>
+#include <type_traits>
+#include "widgets.h"
+#include "Utils/Format.h"
+#include "Utils/I2cArbiter.h"
+
+// Bus of the lcd, Wire1 keeps it off the bus of mpus 0 and 1 but shares it with 2 and 3
+#ifndef DISPLAY_WIRE
+#define DISPLAY_WIRE Wire
+#endif
 
 class Display;
 extern Display display;
 
+// Every write is a small transaction on a private copy of the frame that is then published with a CAS,
+// so writers on both cores never block each other or the refresh, which only reads published frames,
+// a writer that loses the race redoes its edit on the newer frame
 class Display : public Runnable
 {
 public:
@@ -20,24 +32,47 @@ public:
     // The buffer rows (same as display rows)
     static constexpr uint32_t bufRows = rows;
 
+    // Sets the magic numbers at the end of each row
     Display();
 
-    // Sets the magic numbers at the end of each row and starts the driver
+    // Starts the driver, sleeps for over a second, the frames can be written before
     void init();
 
     virtual void run() override;
 
-    // Returns true if all 3 dispaly buffers' trailing null char and magic number aren't overridden,
-    // when corruption is detected, also writes "buffer" "corrupt" to the end,
-    // and resets the trailing null char and magic number,
-    // execution should not continue after the corruption
-    bool checkBufIntegrity();
+    // Text and overlay as written, the refresh composes and sends them
+    struct Frame
+    {
+        char text[bufRows][bufCols]; // Spaces should be filled with ' '
+        char overlay[bufRows][bufCols]; // '\0' in the overlay means transparent
+        uint64_t overlayTimeoutMillis;
+    };
+
+    // I2C traffic of the frames that changed something on the lcd
+    struct FrameStats
+    {
+        uint32_t frames;
+        uint32_t lastFrameBytes;
+        uint32_t maxFrameBytes;
+        uint64_t totalBytes;
+    };
+
+    // Sends the cells that changed to the display in chunks fitted between sensor reads,
+    // also checks for buffer corruption, returns false if a chunk was put off for a sensor read
+    bool update();
+
+    // Called from the other core by telemetry, the fields can be from consecutive frames
+    FrameStats getFrameStats() const;
+
+    // Clears the display, widgets are redrawn on the next update
+    void clear();
 
-    // Sends update to the display when needed, also checks for buffer corruption
-    void update();
+    // Widgets are refreshed by update(), only call these on the display's core
+    void addWidget(Widgets::Widget &widget);
+    void removeWidgets();
 
-    // Clears the display
-    void clear();
+    // Loads a custom char into CGRAM slot 0 to 7, slot 0 can't be printed as the buffers are null terminated
+    void createChar(uint8_t slot, uint8_t charmap[8]);
 
     // Sets the backlight
     void setBacklight(bool v);
@@ -48,12 +83,42 @@ public:
     // Gets the backlight
     bool getBacklight() const;
 
-    // Locks the lock for external use
-    ScopedLocker lock();
+    // Applies edit to a copy of the latest frame and publishes it, edit may run more than once if another
+    // writer publishes in between, so it should only write to the frame, returns what the last run returned
+    template <typename Edit>
+    auto edit(Edit &&editFunction)
+    {
+        using Result = std::invoke_result_t<Edit &, Frame &>;
+        uint8_t mine = claimFrame();
+        uint32_t current;
+        while (true)
+        {
+            copyPublished(mine, current);
+            if constexpr (std::is_void_v<Result>)
+            {
+                editFunction(frames[mine]);
+                if (tryPublish(mine, current))
+                    return;
+            }
+            else
+            {
+                Result result = editFunction(frames[mine]);
+                if (tryPublish(mine, current))
+                    return result;
+            }
+        }
+    }
 
     // Returns true if col and row and final string length are within the range,
     // string is truncated if length is longer than cols
-    bool printf(uint32_t col, uint32_t row, const char* s, ...);
+    template <typename... Args>
+    bool format(uint32_t col, uint32_t row, Fmt::FormatStringFor<Args...> formatString, const Args &...args)
+    {
+        return edit([&](Frame &frame)
+        {
+            return bufFormat(frame.text, col, row, formatString, args...);
+        });
+    }
 
     // Returns true if col and row are within the range
     bool print(uint32_t col, uint32_t row, const char c);
@@ -64,21 +129,109 @@ public:
     // Returns true if col and row and final string length are within the range,
     // string is truncated if length is longer than cols
     // Display will be updated constantly before the timeout elapses
-    bool overlayPrintf(uint32_t col, uint32_t row, uint64_t timeoutPeriodMs, const char *s, ...);
+    template <typename... Args>
+    bool overlayFormat(uint32_t col, uint32_t row, uint64_t timeoutPeriodMs, Fmt::FormatStringFor<Args...> formatString, const Args &...args)
+    {
+        uint64_t timeoutMillis = millis() + timeoutPeriodMs;
+        return edit([&](Frame &frame)
+        {
+            frame.overlayTimeoutMillis = timeoutMillis;
+            return bufFormat(frame.overlay, col, row, formatString, args...);
+        });
+    }
 
     // Returns true if col and row are within the range
     // Display will be updated constantly before the timeout elapses
     bool overlayPrint(uint32_t col, uint32_t row, uint64_t timeoutPeriodMs, const char c);
 
 private:
+    enum class FrameState : uint8_t
+    {
+        Free,
+        Writing,
+        Published,
+    };
+
+    // The published frame, one being read and one being written on each core
+    static constexpr uint8_t frameCount = 4;
+    static constexpr uint8_t noFrame = 0xFF;
+
     LiquidCrystal_I2C lcd;
-    uint64_t lcdOverlayTimeoutMillis;
-    char lcdBufOverlay[bufRows][bufCols]; // '\0' in the overlay means transparent
-    char lcdBufNew[bufRows][bufCols]; // Spaces should be filled with ' '
-    char lcdBufOld[bufRows][bufCols]; // Spaces should be filled with ' '
+    Frame frames[frameCount];
+    std::atomic<FrameState> frameStates[frameCount];
+    // Publish count << 8 | frame index, the count makes a frame that was retired and published again look new
+    std::atomic<uint32_t> published;
+    // Frame pinned by the refresh, writers don't claim it
+    std::atomic<uint8_t> reading;
+    char lcdBufOld[bufRows][bufCols]; // What the lcd shows, spaces should be filled with ' '
     bool backlight;
-    Lock theLock;
+    // Where the next written char lands, cols if unknown
+    uint32_t cursorCol;
+    uint32_t cursorRow;
+    FrameStats frameStats;
+    Widgets::Widget *widgets;
+    // Set by clear() on any core, the widgets' boxes were wiped
+    std::atomic<bool> widgetsCleared;
+    I2cArbiter &arbiter;
+    // Measured bus time of one char or cursor move, sizes the chunks for the arbiter
+    uint32_t microsPerCell;
+    bool framePending;
+
+    // Clean cells between two changed ones that are rewritten instead of moving the cursor over them,
+    // a cursor move costs as much as one char
+    static constexpr uint32_t maxRewrittenGap = 1;
+    // Chars sent while holding the bus once
+    static constexpr uint32_t maxChunkCells = 8;
+    static constexpr uint32_t refreshMillis = 100;
+    // Delay before finishing a frame that was cut short
+    static constexpr uint32_t pendingRetryMillis = 2;
+
+    // Lets each widget that is due poll its value and draw if it changed
+    void refreshWidgets();
+
+    // Clears the overlay only if its timeout is still timeoutMillis,
+    // an overlay published since with a new timeout is kept
+    void overlayClearIfTimeout(uint64_t timeoutMillis);
+
+    static void bufOverlayClear(Frame &frame);
+
+    static uint8_t indexOf(uint32_t publishedValue)
+    {
+        return publishedValue & 0xFF;
+    }
+
+    // Takes a free frame that isn't being read, spins while all are busy
+    uint8_t claimFrame();
+
+    // Copies the published frame into frames[mine] and sets current to it
+    void copyPublished(uint8_t mine, uint32_t &current);
+
+    // Publishes frames[mine] and retires current if current is still the published frame
+    bool tryPublish(uint8_t mine, uint32_t &current);
+
+    // Pins the published frame for reading until unpinFrame()
+    const Frame &pinFrame();
+    void unpinFrame();
+
+    // Returns true if the trailing null chars and magic numbers of the frame and lcdBufOld aren't overridden,
+    // when corruption is detected also writes "buffer" "corrupt" to the end of lcdBufOld,
+    // execution should not continue after the corruption
+    bool checkBufIntegrity(const Frame &frame);
+
+    // Composes the row with the overlay and sends the runs that differ from lcdBufOld,
+    // returns false if it stopped to leave the bus to a sensor
+    bool updateRow(const Frame &source, uint32_t row, bool overlayShown);
+
+    // Formats straight into the row, the terminating null is never written
+    template <typename... Args>
+    bool bufFormat(char buf[bufRows][bufCols], uint32_t col, uint32_t row, Fmt::FormatStringFor<Args...> formatString, const Args &...args)
+    {
+        if (row >= rows || col >= cols)
+            return false;
+        Fmt::Writer w(buf[row] + col, cols - col);
+        Fmt::formatTo(w, formatString, args...);
+        return !w.isTruncated();
+    }
 
-    bool bufPrintf(char buf[bufRows][bufCols], uint32_t col, uint32_t row, const char* s, va_list args);
     bool bufPrint(char buf[bufRows][bufCols], uint32_t col, uint32_t row, const char c);
 };
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include <Arduino.h>
+#include <cstring>
+#include "display.h"
+#include "widgets.h"
+#include "Utils/Format.h"
+#include "Utils/Utils.h"
+
+namespace Widgets
+{
+    Widget::Widget(uint8_t col, uint8_t row, uint8_t width, uint32_t refreshMillis) :
+        col(col),
+        row(row),
+        width(width),
+        refreshMillis(refreshMillis),
+        lastPollMillis(0),
+        invalid(true),
+        next(nullptr)
+    {
+    }
+
+    bool Widget::refresh(Display &display, uint32_t nowMillis)
+    {
+        bool changed = false;
+        if (nowMillis - lastPollMillis >= refreshMillis)
+        {
+            lastPollMillis = nowMillis;
+            changed = poll(nowMillis);
+        }
+        // An invalid widget redraws the shown value, polling early would skew rates
+        if (!changed && !invalid)
+            return false;
+        invalid = false;
+        draw(display);
+        return true;
+    }
+
+    void Widget::invalidate()
+    {
+        invalid = true;
+    }
+
+    void Widget::drawText(Display &display, std::string_view text)
+    {
+        if (row >= Display::rows)
+            return;
+        display.edit([&](Display::Frame &frame)
+        {
+            for (uint32_t i = 0; i < width && col + i < Display::cols; i++)
+                frame.text[row][col + i] = i < text.size() ? text[i] : ' ';
+        });
+    }
+
+    Label::Label(uint8_t col, uint8_t row, uint8_t width, Source<const char *> source, uint32_t refreshMillis) :
+        Widget(col, row, width, refreshMillis),
+        source(source),
+        shown(nullptr)
+    {
+    }
+
+    bool Label::poll(uint32_t)
+    {
+        const char *text = source();
+        if (text == shown)
+            return false;
+        shown = text;
+        return true;
+    }
+
+    void Label::draw(Display &display)
+    {
+        drawText(display, shown ? shown : "");
+    }
+
+    Counter::Counter(uint8_t col, uint8_t row, uint8_t width, Source<uint32_t> source, uint32_t refreshMillis,
+        Show show, const char *prefix, const char *suffix) :
+        Widget(col, row, width, refreshMillis),
+        source(source),
+        show(show),
+        prefix(prefix),
+        suffix(suffix),
+        lastCount(0),
+        lastCountMillis(0),
+        shown(0)
+    {
+    }
+
+    bool Counter::poll(uint32_t nowMillis)
+    {
+        uint32_t count = source();
+        uint32_t value = count;
+        if (show == Show::PerSecond)
+        {
+            uint32_t elapsed = nowMillis - lastCountMillis;
+            value = elapsed ? (uint64_t)(count - lastCount) * 1000 / elapsed : 0;
+            lastCount = count;
+            lastCountMillis = nowMillis;
+        }
+        if (value == shown)
+            return false;
+        shown = value;
+        return true;
+    }
+
+    void Counter::draw(Display &display)
+    {
+        char metric[8];
+        Utils::formatMetric(metric, sizeof(metric), shown);
+        drawText(display, Fmt::format<Display::cols>("{}{}{}", prefix, metric, suffix));
+    }
+
+    Timer::Timer(uint8_t col, uint8_t row, uint8_t width, Source<uint32_t> millisSource) :
+        Widget(col, row, width, 250),
+        millisSource(millisSource),
+        shownSecs(0)
+    {
+    }
+
+    bool Timer::poll(uint32_t nowMillis)
+    {
+        uint32_t secs = (millisSource ? millisSource() : nowMillis) / 1000;
+        if (secs == shownSecs)
+            return false;
+        shownSecs = secs;
+        return true;
+    }
+
+    void Timer::draw(Display &display)
+    {
+        drawText(display, Fmt::format<Display::cols>("{}:{:02}:{:02}", shownSecs / 3600, shownSecs / 60 % 60, shownSecs % 60));
+    }
+
+    BarMeter::BarMeter(uint8_t col, uint8_t row, uint8_t width, Source<uint32_t> source, uint32_t max, uint32_t refreshMillis) :
+        Widget(col, row, width, refreshMillis),
+        source(source),
+        max(max),
+        shownSteps(0)
+    {
+    }
+
+    bool BarMeter::poll(uint32_t)
+    {
+        uint32_t totalSteps = width * stepsPerCol;
+        uint32_t steps = min((uint64_t)source() * totalSteps / max, (uint64_t)totalSteps);
+        if (steps == shownSteps)
+            return false;
+        shownSteps = steps;
+        return true;
+    }
+
+    void BarMeter::draw(Display &display)
+    {
+        defineChars(display);
+        char bar[Display::cols];
+        for (uint32_t i = 0; i < width && i < sizeof(bar); i++)
+        {
+            uint32_t lit = min(shownSteps - min(shownSteps, i * stepsPerCol), (uint32_t)stepsPerCol);
+            bar[i] = lit ? (char)(firstChar + lit - 1) : ' ';
+        }
+        drawText(display, std::string_view(bar, min((uint32_t)width, Display::cols)));
+    }
+
+    void BarMeter::defineChars(Display &display)
+    {
+        static bool defined = false;
+        if (defined)
+            return;
+        for (uint8_t lit = 1; lit <= stepsPerCol; lit++)
+        {
+            // Lit cols from the left, every pixel row the same
+            uint8_t pattern = (uint8_t)(0x1F << (stepsPerCol - lit)) & 0x1F;
+            uint8_t rows[8];
+            memset(rows, pattern, sizeof(rows));
+            display.createChar(firstChar + lit - 1, rows);
+        }
+        defined = true;
+    }
+}
\ No newline at end of file
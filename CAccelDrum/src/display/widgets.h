@@ -0,0 +1,135 @@
+#pragma once
+#include <Arduino.h>
+#include <string_view>
+
+class Display;
+
+// Retained widgets over Display, each owns a box of one row and redraws it only when the value it shows changes,
+// values are pulled from a source function every refreshMillis by the display task, so sources must be safe
+// to call from the ui core
+//
+// static Widgets::Counter sent(0, 1, 6, [] { return packetsSent.load(); }, 500);
+// display.addWidget(sent);
+namespace Widgets
+{
+    template <typename T>
+    using Source = T (*)();
+
+    class Widget
+    {
+    public:
+        Widget(uint8_t col, uint8_t row, uint8_t width, uint32_t refreshMillis);
+
+        Widget(const Widget &) = delete;
+        Widget &operator=(const Widget &) = delete;
+
+        // Polls the source if refreshMillis elapsed and draws if the shown value changed,
+        // returns true if it drew
+        bool refresh(Display &display, uint32_t nowMillis);
+
+        // Draws on the next refresh even if the value didn't change, after the display was cleared
+        void invalidate();
+
+    protected:
+        // Reads the source, returns true if the text it would draw differs from the drawn one
+        virtual bool poll(uint32_t nowMillis) = 0;
+
+        virtual void draw(Display &display) = 0;
+
+        // Writes text to the box, cut or padded with spaces to the width
+        void drawText(Display &display, std::string_view text);
+
+        const uint8_t col;
+        const uint8_t row;
+        const uint8_t width;
+
+    private:
+        const uint32_t refreshMillis;
+        uint32_t lastPollMillis;
+        bool invalid;
+        Widget *next;
+
+        friend Display;
+    };
+
+    // Text picked by the source, compared by pointer so it should return literals
+    class Label : public Widget
+    {
+    public:
+        Label(uint8_t col, uint8_t row, uint8_t width, Source<const char *> source, uint32_t refreshMillis = 100);
+
+    protected:
+        bool poll(uint32_t nowMillis) override;
+        void draw(Display &display) override;
+
+    private:
+        Source<const char *> source;
+        const char *shown;
+    };
+
+    // A count like 12.3k, or its rate per second
+    class Counter : public Widget
+    {
+    public:
+        enum class Show : uint8_t
+        {
+            Total,
+            PerSecond, // Averaged over refreshMillis
+        };
+
+        Counter(uint8_t col, uint8_t row, uint8_t width, Source<uint32_t> source, uint32_t refreshMillis,
+            Show show = Show::Total, const char *prefix = "", const char *suffix = "");
+
+    protected:
+        bool poll(uint32_t nowMillis) override;
+        void draw(Display &display) override;
+
+    private:
+        Source<uint32_t> source;
+        Show show;
+        const char *prefix;
+        const char *suffix;
+        uint32_t lastCount;
+        uint32_t lastCountMillis;
+        uint32_t shown;
+    };
+
+    // Elapsed time as h:mm:ss, 7 cols until 10 hours, the time since boot without a source
+    class Timer : public Widget
+    {
+    public:
+        Timer(uint8_t col, uint8_t row, uint8_t width, Source<uint32_t> millisSource = nullptr);
+
+    protected:
+        bool poll(uint32_t nowMillis) override;
+        void draw(Display &display) override;
+
+    private:
+        Source<uint32_t> millisSource;
+        uint32_t shownSecs;
+    };
+
+    // Horizontal bar of value / max with a resolution of 5 steps per col, built from custom chars 1 to 5,
+    // redrawn only when the number of lit steps changes
+    class BarMeter : public Widget
+    {
+    public:
+        BarMeter(uint8_t col, uint8_t row, uint8_t width, Source<uint32_t> source, uint32_t max, uint32_t refreshMillis);
+
+    protected:
+        bool poll(uint32_t nowMillis) override;
+        void draw(Display &display) override;
+
+    private:
+        // Slot 0 isn't used, its char code is the null the buffers can't hold
+        static constexpr uint8_t firstChar = 1;
+        static constexpr uint8_t stepsPerCol = 5;
+
+        Source<uint32_t> source;
+        uint32_t max;
+        uint32_t shownSteps;
+
+        // Loads the partial blocks into the lcd once
+        static void defineChars(Display &display);
+    };
+}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <cstring>
 #include <cstdio>
 #include <limits>
+#include <atomic>
 #include <I2Cdev.h>
 #include <MPU6050.h>
 #if I2CDEV_IMPLEMENTATION == I2CDEV_ARDUINO_WIRE
@@ -12,10 +13,20 @@
 #include <DeepSleepScheduler.h>
 #include <LiquidCrystal_I2C.h>
 #include "main.h"
-#include "Display/Display.h"
+#include "display/display.h"
 #include "Serial/SerialManager.h"
-#include "Utils/Utils.h"
+#include "Serial/Handshake.h"
+#include "Serial/PacketDispatcher.h"
+#include "Serial/Subscriptions.h"
+#include "Utils/BootGraph.h"
+#include "Utils/BootProfile.h"
+#include "Utils/Format.h"
+#include "Utils/I2cArbiter.h"
+#include "Utils/Log.h"
+#include "Utils/SensorConfig.h"
+#include "Utils/Telemetry.h"
 #include "Utils/PacketUtils.h"
+#include "Utils/CoroutineScheduler.h"
 
 // class default I2C address is 0x68
 // specific I2C addresses may be passed as a parameter here
@@ -32,13 +43,48 @@ MPU6050 mpus[4] =
     MPU6050(0x69, &Wire1),
 };
 
+Scheduler uiScheduler;
 bool blinkState = false;
 uint64_t lastBlinkMillis = 0;
 Bounce2::Button btn1;
 Bounce2::Button btn2;
-uint64_t lastPollMillis = 0;
+// Set by the button interrupt, cleared once updateBtns() sees both buttons settled
+std::atomic<bool> btnsPolling(false);
+volatile uint32_t lastBtnEdgeMillis = 0;
+// The display task starts refreshing once the lcd is up
+static void initLcd()
+{
+    display.init();
+    display.setBacklight(true);
+    uiScheduler.post(&display);
+}
+
+static void initSensor(uint8_t i)
+{
+    SensorConfig::initialize(i);
+    mpus[i].setXGyroOffset(220);
+    mpus[i].setYGyroOffset(76);
+    mpus[i].setZGyroOffset(-85);
+    mpus[i].setZAccelOffset(1788); // 1688 factory default for my test chip
+    display.print(i * 2, 1, 'i');
+}
+
+static void calibrateAccel(uint8_t i)
+{
+    mpus[i].CalibrateAccel(6);
+}
+
+static void calibrateGyro(uint8_t i)
+{
+    mpus[i].CalibrateGyro(6);
+    display.print(i * 2, 1, 'v');
+}
+
+static const BootGraph::Steps bootSteps = {initLcd, initSensor, calibrateAccel, calibrateGyro};
 
 void setup() {
+    BootProfile::begin(BootPhase::Boot);
+    BootProfile::begin(BootPhase::Setup);
     pinMode(ledPinDebug, OUTPUT);
     analogWrite(ledPinDebug, debugLedBrightness);
 
@@ -51,76 +97,71 @@ void setup() {
     #elif I2CDEV_IMPLEMENTATION == I2CDEV_BUILTIN_FASTWIRE // TODO: Remove this
         Fastwire::setup(400, true);
     #endif
-    
-    display.init();
-    display.setBacklight(true);
+
+    BootGraph::startLcd(bootSteps);
+    BootProfile::begin(BootPhase::Serial);
     serial.init();
+    BootProfile::end(BootPhase::Serial);
 
-    display.clear();
-    display.printf(0, 0, "Init mpu");
-    display.update();
-    for (MPU6050 &mpu : mpus)
-        mpu.initialize(ACCEL_FS::A8G, GYRO_FS::G1000DPS);
+    pinMode(LED_BUILTIN, OUTPUT);
+    BootProfile::end(BootPhase::Setup);
+}
 
-    display.clear();
-    display.printf(0, 0, "Mpu set offset");
-    display.update();
-    for (MPU6050 &mpu : mpus)
-    {
-        mpu.setXGyroOffset(220);
-        mpu.setYGyroOffset(76);
-        mpu.setZGyroOffset(-85);
-        mpu.setZAccelOffset(1788); // 1688 factory default for my test chip
-    }
+static void startTasks();
 
+// Runs as a coroutine on the sampling core so serial keeps being served during the calibration
+static Co::Task boot()
+{
     display.clear();
-    display.printf(0, 0, "Mpu calibrate");
-    display.printf(0, 1, "?-?-?-?");
-    display.update();
-    static auto calibrate = [](uint8_t i)
-    {
-        mpus[i].CalibrateAccel(6);
-        mpus[i].CalibrateGyro(6);
-        {
-            auto lock = display.lock();
-            display.print(i * 2, 1, 'v');
-            display.update();
-        }
-    };
-    static volatile bool otherHalfDone = false;
-    auto doOtherHalf = [](void *data) {
-        calibrate(2);
-        calibrate(3);
-        otherHalfDone = true;
-        vTaskDelete(nullptr);
-    };
-    TaskHandle_t task;
-    xTaskCreatePinnedToCore(doOtherHalf, "Mpu calibration", 2048, nullptr, 10, &task, 0);
-    calibrate(0);
-    calibrate(1);
-    while (!otherHalfDone)
-        ;
-    
-    display.printf(0, 0, "Set pins");
-    display.update();
-    pinMode(LED_BUILTIN, OUTPUT);
+    display.format(0, 0, "Boot");
+    display.format(0, 1, "?-?-?-?");
+    co_await BootGraph::bringUpSensors(bootSteps);
+
+    BootProfile::begin(BootPhase::Pins);
     btn1.attach(buttonPin1, INPUT); // Internal pullup isn't strong enough to not trigger interrupt
-    btn1.interval(5);
+    btn1.interval(buttonDebounceMillis);
     btn1.setPressedState(LOW);
     btn2.attach(buttonPin2, INPUT);
-    btn2.interval(5);
+    btn2.interval(buttonDebounceMillis);
     btn2.setPressedState(LOW);
+    attachInterrupt(buttonPin1, onBtnEdge, CHANGE);
+    attachInterrupt(buttonPin2, onBtnEdge, CHANGE);
     analogWrite(ledPinDebug, 0);
+    BootProfile::end(BootPhase::Pins);
+
+    startTasks();
+    BootProfile::end(BootPhase::Boot);
+    display.clear();
+    PacketUtils::send(PacketType::BootProfile, BootProfile::makePacket());
+    LOG_INFO("Boot done in {} ms, {} coroutine frames used at most", millis(), Co::frameArena.getHighWaterMark());
 }
 
 uint64_t lastSendMicros[4];
-uint32_t batchesSent = 0;
+std::atomic<uint32_t> batchesSent(0);
+static TaskHandle dmpTask;
+
+static void sendTaskStats();
+static void sendLinkStats();
+
+static void sendSensorConfig(ConfigurePacket::Val value)
+{
+    ConfigurePacket packet = {ConfigurePacket::Type::SensorConfig, value};
+    PacketUtils::getConfigureDataAs<ConfigurePacket::SensorConfigs>(packet.data) = SensorConfig::get();
+    PacketUtils::send(PacketType::Configure, packet);
+}
 
+// Sends every subscribed stream that is due, then sleeps until the next deadline of any of them
 void processDmpPacket()
 {
-    display.clear();
+    uint32_t startMicros = micros();
 
-    if (millis() - lastPollMillis <= 1500)
+    // Only between sample sets, so a set is never read with two configs
+    if (SensorConfig::applyPending())
+        sendSensorConfig(ConfigurePacket::Val::SensorConfigResult);
+
+    uint32_t due = Subscriptions::takeDue(startMicros);
+    uint8_t sensorMask = due & 0b1111; // StreamId::RawSensor0 to 3
+    if (sensorMask)
     {
         RawAccelPacket packet = {0};
 
@@ -129,9 +170,13 @@ void processDmpPacket()
             uint64_t micro = micros();
             int16_t ax, ay, az;
             int16_t gx, gy, gz;
-            mpus[i].getMotion6(&ax, &ay, &az, &gx, &gy, &gz);
-            float ares = mpus[i].get_acce_resolution();
-            float gres = mpus[i].get_gyro_resolution();
+            {
+                // Taken ahead of any lcd chunk waiting for the bus
+                I2cArbiter::SensorGuard guard(i < 2 ? wireArbiter : wire1Arbiter);
+                mpus[i].getMotion6(&ax, &ay, &az, &gx, &gy, &gz);
+            }
+            float ares = SensorConfig::getAccelResolution(i);
+            float gres = SensorConfig::getGyroResolution(i);
             RawAccelPacket::Pack pack =
             {
                 .deltaMicros = (uint32_t)min(micro - lastSendMicros[i], (uint64_t)std::numeric_limits<uint32_t>::max()),
@@ -143,40 +188,53 @@ void processDmpPacket()
                 .gz = gz * gres,
             };
             packet.packs[i] = pack;
+            packet.accelRanges[i] = SensorConfig::get(i).accelRange;
+            packet.gyroRanges[i] = SensorConfig::get(i).gyroRange;
             lastSendMicros[i] = micro;
         };
+        packet.sensorMask = sensorMask;
+        packet.configGeneration = SensorConfig::getGeneration();
         for (uint8_t i = 0; i < 4; i++)
-            getData(i);
+            if (sensorMask & (1 << i))
+                getData(i);
         PacketUtils::send(PacketType::RawAccel, packet);
         batchesSent++;
-
-        display.print(display.cols - 1, 1, '*');
-        
-        scheduler.scheduleDelayed(processDmpPacket, 10);
     }
-    else
+    if (due & (1 << (uint8_t)StreamId::TaskStats))
+        sendTaskStats();
+    if (due & (1 << (uint8_t)StreamId::Telemetry))
     {
-        scheduler.scheduleDelayed(processDmpPacket, 100);
+        PacketUtils::send(PacketType::Telemetry, Telemetry::makePacket(batchesSent));
+        sendLinkStats();
     }
 
-    uint32_t secs = millis() / 1000;
-    char numSentMetric[10];
-    Utils::formatMetric(numSentMetric, 10, batchesSent);
-    display.printf(0, 1, "%u:%u:%u %s", secs / 3600, secs / 60 % 60, secs % 60, numSentMetric);
-    return;
+    // An absolute deadline, a period counted from this run's start would move with its jitter,
+    // a stream that is already due runs right away without counting as an overrun
+    uint64_t nowMicros = scheduler.getMicros();
+    uint64_t nextMicros = nowMicros + Subscriptions::untilNextDue((uint32_t)nowMicros, idleSamplePeriodMicros);
+    scheduler.setNextRun(dmpTask, nextMicros);
+    // The display fits its chunks before the next run, which may start reading again
+    wireArbiter.expectSensorAt((uint32_t)nextMicros);
+    wire1Arbiter.expectSensorAt((uint32_t)nextMicros);
+}
+
+void IRAM_ATTR onBtnEdge()
+{
+    lastBtnEdgeMillis = millis();
+    if (!btnsPolling.exchange(true, std::memory_order_acq_rel))
+        uiScheduler.post(updateBtns);
 }
 
 void updateBtns()
 {
-    scheduler.schedule(updateBtns);
     btn1.update();
     btn2.update();
     if (btn1.pressed())
     {
         bool bl = display.toggleBacklight();
         display.overlayClear();
-        display.overlayPrintf(0, 0, 1000, bl ? "Backlight on" : "Backlight off");
-        PacketUtils::printlnToPackets(bl ? "Backlight on" : "Backlight off");
+        display.overlayFormat(0, 0, 1000, "{}", bl ? "Backlight on" : "Backlight off");
+        LOG_INFO("Backlight {}", bl ? "on" : "off");
     }
     if (btn2.pressed())
     {
@@ -188,33 +246,101 @@ void updateBtns()
         serial.sendNative(packet);
 
         display.overlayClear();
-        display.overlayPrintf(0, 0, 1000, "Garbage crc");
-        display.overlayPrintf(display.cols - strlen("packet sent"), 1, 1000, "packet sent");
+        display.overlayFormat(0, 0, 1000, "Garbage crc");
+        display.overlayFormat(display.cols - strlen("packet sent"), 1, 1000, "packet sent");
 
-        lastPollMillis = millis();
     }
+
+    // Keep polling through the bounce so bounce2 sees the stable state, then wait for the next edge
+    btnsPolling.store(false, std::memory_order_release);
+    if (millis() - lastBtnEdgeMillis < buttonSettleMillis &&
+        !btnsPolling.exchange(true, std::memory_order_acq_rel))
+        Scheduler::forCurrentCore().scheduleDelayed(updateBtns, buttonDebounceMillis);
 }
 
 void blinkLed()
 {
     if (blinkState)
     {
-        scheduler.scheduleDelayed(blinkLed, 1000);
+        Scheduler::forCurrentCore().scheduleDelayed(blinkLed, 1000);
         digitalWrite(LED_BUILTIN, blinkState = false);
     }
     else
     {
-        scheduler.schedule(blinkLed);
+        Scheduler::forCurrentCore().scheduleDelayed(blinkLed, blinkOnMillis);
         digitalWrite(LED_BUILTIN, blinkState = true);
     }
 }
 
-static void handleConfigurePacket(ConfigurePacket& packet)
+static void sendTaskStats()
+{
+    // Both cores' tasks in one dump, the other core's table is read unlocked so a torn read only skews one entry
+    uint32_t count = 0;
+    for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++)
+        if (Scheduler *s = Scheduler::forCore(core))
+            count += s->getTaskStatsCount();
+    uint32_t cyclesPerMicro = scheduler.getCyclesPerMicro();
+    uint32_t index = 0;
+    for (BaseType_t core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        Scheduler *s = Scheduler::forCore(core);
+        for (uint32_t i = 0; s && i < s->getTaskStatsCount(); i++, index++)
+        {
+            TaskStats stats;
+            if (!s->getTaskStats(i, stats))
+                break;
+            TaskStatsPacket packet = {
+                .index = (uint8_t)index,
+                .count = (uint8_t)count,
+                .core = (uint8_t)core,
+                .coreBusyPermille = (uint16_t)s->getUtilizationPermille(),
+                .coreIdlePermille = (uint16_t)s->getIdlePermille(),
+                .runCount = stats.runCount,
+                .minRunMicros = stats.runCount ? stats.minRunCycles / cyclesPerMicro : 0,
+                .avgRunMicros = stats.runCount ? (uint32_t)(stats.totalRunCycles / stats.runCount / cyclesPerMicro) : 0,
+                .maxRunMicros = stats.maxRunCycles / cyclesPerMicro,
+                .avgJitterMicros = stats.runCount ? (uint32_t)(stats.totalJitterMicros / stats.runCount) : 0,
+                .maxJitterMicros = stats.maxJitterMicros,
+                .overrunCount = stats.overrunCount};
+            strncpy(packet.name.data(), stats.name ? stats.name : "?", packet.name.size());
+            std::copy(std::begin(stats.runHistogram), std::end(stats.runHistogram), packet.runHistogram.begin());
+            std::copy(std::begin(stats.jitterHistogram), std::end(stats.jitterHistogram), packet.jitterHistogram.begin());
+            PacketUtils::send(PacketType::TaskStats, packet);
+        }
+    }
+    for (I2cArbiter *bus : {&wireArbiter, &wire1Arbiter})
+    {
+        I2cArbiter::Stats stats = bus->getStats();
+        LOG_INFO("{} busy {} permille, {} sensor waits mean {} us p99 <{} us max {} us, {} lcd chunks deferred",
+            bus->getName(), stats.busyPermille, stats.sensorWaitCount, stats.sensorWaitMeanMicros,
+            stats.sensorWaitP99Micros, stats.sensorWaitMaxMicros, stats.deferredChunks);
+    }
+}
+
+static void handleConfigurePacket(PacketView<ConfigurePacket> view)
 {
+    const ConfigurePacket &packet = *view;
     switch (packet.type)
     {
-        case ConfigurePacket::Type::PollForData:
-            lastPollMillis = millis();
+        case ConfigurePacket::Type::Subscribe:
+            if (packet.value == ConfigurePacket::Val::SubscribeSet)
+            {
+                const auto &requested = PacketUtils::getConfigureDataAs<ConfigurePacket::Subscriptions>(packet.data);
+                ConfigurePacket reply = {ConfigurePacket::Type::Subscribe, ConfigurePacket::Val::SubscribeResult};
+                auto &granted = PacketUtils::getConfigureDataAs<ConfigurePacket::Subscriptions>(reply.data);
+                granted = requested;
+                granted.count = min(requested.count, (uint8_t)requested.entries.size());
+                uint32_t now = micros();
+                for (uint8_t i = 0; i < granted.count; i++)
+                {
+                    ConfigurePacket::Subscription &entry = granted.entries[i];
+                    // A host with other packet layouts would read garbage
+                    entry.rateHz = Handshake::isPeerIncompatible()
+                        ? 0
+                        : Subscriptions::subscribe((StreamId)entry.stream, entry.rateHz, entry.leaseMillis, now);
+                }
+                PacketUtils::send(PacketType::Configure, reply);
+            }
             break;
         case ConfigurePacket::Type::Backlight:
             switch (packet.value)
@@ -280,56 +406,155 @@ static void handleConfigurePacket(ConfigurePacket& packet)
             PacketUtils::send(PacketType::Configure, packet);
             break;
         }
+        case ConfigurePacket::Type::BootProfile:
+            if (packet.value == ConfigurePacket::Val::BootProfileGet)
+                PacketUtils::send(PacketType::BootProfile, BootProfile::makePacket());
+            break;
+        case ConfigurePacket::Type::SensorConfig:
+            switch (packet.value)
+            {
+                case ConfigurePacket::Val::SensorConfigGet:
+                    sendSensorConfig(ConfigurePacket::Val::SensorConfigResult);
+                    break;
+                case ConfigurePacket::Val::SensorConfigSet:
+                    // The result is sent by the sampling task once the config is applied
+                    if (!SensorConfig::request(PacketUtils::getConfigureDataAs<ConfigurePacket::SensorConfigs>(packet.data)))
+                        PacketUtils::sendConfigureAck(
+                            ConfigurePacket::Type::SensorConfig,
+                            ConfigurePacket::Val::SensorConfigRejected);
+                    break;
+            }
+            break;
+        case ConfigurePacket::Type::TaskStats:
+            switch (packet.value)
+            {
+                case ConfigurePacket::Val::TaskStatsGet:
+                    sendTaskStats();
+                    break;
+                case ConfigurePacket::Val::TaskStatsReset:
+                    scheduler.resetTaskStats();
+                    // Reset on its own core so it doesn't race a run being recorded
+                    uiScheduler.post([] { uiScheduler.resetTaskStats(); });
+                    wireArbiter.resetStats();
+                    wire1Arbiter.resetStats();
+                    PacketUtils::sendConfigureAck(
+                        ConfigurePacket::Type::TaskStats,
+                        ConfigurePacket::Val::TaskStatsAck);
+                    break;
+            }
+            break;
     }
 }
 
+static void handleHelloPacket(PacketView<HelloPacket> view)
+{
+    Handshake::receiveHello(*view);
+}
+
+static PacketDispatcher<
+    PacketRoute<PacketType::Configure, handleConfigurePacket>,
+    PacketRoute<PacketType::Hello, handleHelloPacket>>
+    packetDispatcher;
+
+static void sendLinkStats()
+{
+    LinkStatsPacket packet = Telemetry::makeLinkStats();
+    packet.rxUnknown = packetDispatcher.getUnknownCount();
+    packet.rxUnregistered = packetDispatcher.getUnregisteredCount();
+    PacketUtils::send(PacketType::LinkStats, packet);
+}
+
 void receivePackets()
 {
-    scheduler.schedule(receivePackets);
-    SerialPacket packet;
-    if (serial.tryDequeueInbound(packet))
+    uint32_t handled = serial.drainInbound([](const SerialPacket &packet)
+    {
+        packetDispatcher.dispatch(packet);
+    });
+    if (handled)
     {
         display.overlayClear();
-        std::string s = Utils::stringSprintf("|%d|", serial.getPacketCount());
-        display.overlayPrintf(display.cols - s.length(), 0, 1000, s.c_str());
-        switch ((PacketType)packet.type)
-        {
-            case PacketType::Configure:
-            {
-                ConfigurePacket con = PacketUtils::innerAs<ConfigurePacket>(packet);
-                handleConfigurePacket(con);
-                break;
-            }
-        }
+        Fmt::FixedString<Display::cols> s = Fmt::format<Display::cols>("|{}|", serial.getPacketCount());
+        display.overlayFormat(display.cols - s.size(), 0, 1000, "{}", s.view());
     }
+    // Budget ran out, continue after the other tasks had their turn
+    if (serial.peekInbound())
+        scheduler.schedule(receivePackets);
 }
 
 class TaskTimeoutCallback : public Runnable
 {
+    // Called from the watchdog interrupt, the chip aborts and restarts once this returns
     void run() override
     {
-        while (1)
-            ;
+        Scheduler *timedOut = Scheduler::getTimedOutScheduler();
+        const char *name = timedOut ? timedOut->getCurrentTaskName() : nullptr;
+        ets_printf("Task timeout in %s\n", name ? name : "unnamed task");
     }
 };
 
 static TaskTimeoutCallback timeoutCallback;
 
+// Run screen, 16x2
+// "100Hz D0      ##" sample rate, sensor packets dropped per second, sampling core load
+// "0:12:34  12.3k *" uptime, batches sent, any stream subscribed by the host
+static Widgets::Counter sampleRateWidget(0, 0, 5, [] { return batchesSent.load(); }, 1000,
+    Widgets::Counter::Show::PerSecond, "", "Hz");
+static Widgets::Counter dropRateWidget(6, 0, 8, [] { return serial.getTxStats(TxClass::Sensor).dropped; }, 1000,
+    Widgets::Counter::Show::PerSecond, "D");
+static Widgets::BarMeter loadWidget(14, 0, 2, [] { return (uint32_t)scheduler.getUtilizationPermille(); }, 1000, 1000);
+static Widgets::Timer uptimeWidget(0, 1, 8);
+static Widgets::Counter batchesWidget(9, 1, 6, [] { return batchesSent.load(); }, 500);
+static Widgets::Label polledWidget(15, 1, 1, [] { return Subscriptions::isAnyActive() ? "*" : " "; });
+static Widgets::Widget *runScreen[] = {&sampleRateWidget, &dropRateWidget, &loadWidget,
+    &uptimeWidget, &batchesWidget, &polledWidget};
+
+// Called by boot() once the mpus are ready
+static void startTasks()
+{
+    // Sets its own period to the next stream deadline, those are anchored so the rates don't drift
+    dmpTask = scheduler.schedulePeriodic(processDmpPacket, idleSamplePeriodMicros);
+    uiScheduler.schedule(blinkLed);
+    // The widget list belongs to the display's core
+    uiScheduler.post([]
+    {
+        for (Widgets::Widget *w : runScreen)
+            display.addWidget(*w);
+    });
+}
+
 void loop() {
-    display.clear();
-    display.printf(0, 0, "Set sched");
-    display.update();
     scheduler.setTaskTimeout(TIMEOUT_2S);
     scheduler.setSupervisionCallback(&timeoutCallback);
-    scheduler.schedule(updateBtns);
-    scheduler.schedule(processDmpPacket);
-    scheduler.schedule(blinkLed);
+    // Light sleep would halt the other core as well
+    scheduler.acquireNoSleepLock();
+    scheduler.setTaskName(processDmpPacket, "sampling");
+    scheduler.setTaskName(receivePackets, "receive");
+    scheduler.setTaskName(&serial, "serial");
+    scheduler.setTaskName(&Co::statsRunnable, "coroutines");
+    serial.setInboundHandler(receivePackets);
     scheduler.schedule(receivePackets);
-    scheduler.schedule(&display);
     scheduler.schedule(&serial);
-    display.clear();
-    display.printf(0, 0, "Sched run");
-    display.update();
+
+    uiScheduler.setTaskTimeout(TIMEOUT_2S);
+    uiScheduler.acquireNoSleepLock();
+    uiScheduler.setTaskName(updateBtns, "buttons");
+    uiScheduler.setTaskName(blinkLed, "blink");
+    uiScheduler.setTaskName(&display, "display");
+    uiScheduler.setTaskName(&Co::statsRunnable, "coroutines");
+
+    // Runs until it waits for the first hello, then lives on in its frame
+    Co::Task handshake = Handshake::serve();
+    if (!handshake.isValid())
+        LOG_ERROR("Handshake coroutine frame didn't fit, hellos are answered inline");
+    handshake.detach();
+    if (!Co::spawn(scheduler, boot()))
+    {
+        display.clear();
+        display.format(0, 0, "Boot alloc fail");
+        LOG_ERROR("Boot coroutine frame of {} bytes didn't fit", Co::frameArena.getLargestRequest());
+    }
+    // Started last, the display belongs to core 0 from here on
+    uiScheduler.executeOnCore(0, uiSchedulerStackSize, 1);
     scheduler.execute(); // Does not return
 }
 
@@ -11,10 +11,22 @@ constexpr uint32_t debugLedBrightness = 128;
 // constexpr uint32_t interruptPin = 15;
 constexpr uint32_t wire1Scl = 17;
 constexpr uint32_t wire1Sda = 16;
+// Longest sleep of the sampling task while nothing is subscribed, bounds how late a new subscription starts
+constexpr uint32_t idleSamplePeriodMicros = 100'000;
+// Buttons are polled from their first edge until they've been quiet for buttonSettleMillis
+constexpr uint32_t buttonDebounceMillis = 5;
+constexpr uint32_t buttonSettleMillis = buttonDebounceMillis * 2;
+constexpr uint32_t blinkOnMillis = 50;
+constexpr uint32_t uiSchedulerStackSize = 4096;
+constexpr uint32_t lcdInitStackSize = 3072;
 extern MPU6050 mpus[4];
+class Scheduler;
+// Runs the display, buttons and led on core 0, away from sampling and serial on core 1
+extern Scheduler uiScheduler;
 extern Bounce2::Button btn1;
 extern Bounce2::Button btn2;
 
+void onBtnEdge();
 void updateBtns();
 void processDmpPacket();
 void receivePackets();
@@ -0,0 +1,271 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include "esp32-hal-timer.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+// Host stand-in for the parts of the Arduino core, FreeRTOS and ESP-IDF the tested sources use,
+// time is the host's steady clock and every FreeRTOS task is a thread
+
+typedef uint8_t byte;
+using std::max;
+using std::min;
+
+#define ARDUINO 10800
+#define IRAM_ATTR
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define LOW 0x0
+#define HIGH 0x1
+#define CHANGE 0x03
+#define LED_BUILTIN 2
+#define PROGMEM
+#define pgm_read_byte_near(address) (*(const uint8_t *)(address))
+
+inline unsigned long micros()
+{
+    return (unsigned long)esp_timer_get_time();
+}
+
+inline unsigned long millis()
+{
+    return (unsigned long)(esp_timer_get_time() / 1000);
+}
+
+inline void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void delayMicroseconds(unsigned int us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+inline void yield()
+{
+    std::this_thread::yield();
+}
+
+// Only masks the calling core on the esp32 too, the sources never rely on it across cores
+inline void noInterrupts()
+{
+}
+
+inline void interrupts()
+{
+}
+
+inline void pinMode(uint8_t, uint8_t)
+{
+}
+
+inline void digitalWrite(uint8_t, uint8_t)
+{
+}
+
+inline int digitalRead(uint8_t)
+{
+    return HIGH;
+}
+
+inline void analogWrite(uint8_t, int)
+{
+}
+
+inline uint32_t getCpuFrequencyMhz()
+{
+    return 240;
+}
+
+class EspClass
+{
+public:
+    uint32_t getCycleCount()
+    {
+        return (uint32_t)(esp_timer_get_time() * getCpuFrequencyMhz());
+    }
+
+    uint32_t getCpuFreqMHz()
+    {
+        return getCpuFrequencyMhz();
+    }
+};
+
+inline EspClass ESP;
+
+// FreeRTOS
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFF
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portNUM_PROCESSORS 2
+#define portYIELD_FROM_ISR()
+
+namespace Native
+{
+    struct Task
+    {
+        std::mutex mutex;
+        std::condition_variable notified;
+        uint32_t notifications = 0;
+    };
+
+    // Thrown by vTaskDelete(NULL) to unwind the calling task's thread
+    struct TaskDeleted
+    {
+    };
+
+    // A thread that isn't a task started by xTaskCreatePinnedToCore() runs on core 1, like loopTask
+    inline thread_local BaseType_t coreId = 1;
+    inline thread_local Task *currentTask = nullptr;
+}
+
+typedef Native::Task *TaskHandle_t;
+
+inline BaseType_t xPortGetCoreID()
+{
+    return Native::coreId;
+}
+
+inline bool xPortInIsrContext()
+{
+    return false;
+}
+
+// Tasks are never freed, a task may still be notified after it was deleted
+inline TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    if (!Native::currentTask)
+        Native::currentTask = new Native::Task();
+    return Native::currentTask;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *, uint32_t, void *arg,
+                                          UBaseType_t, TaskHandle_t *created, BaseType_t core)
+{
+    TaskHandle_t task = new Native::Task();
+    if (created)
+        *created = task;
+    std::thread([=]
+    {
+        Native::coreId = core;
+        Native::currentTask = task;
+        try
+        {
+            function(arg);
+        }
+        catch (Native::TaskDeleted &)
+        {
+        }
+    }).detach();
+    return pdPASS;
+}
+
+inline void vTaskDelete(TaskHandle_t task)
+{
+    if (!task || task == Native::currentTask)
+        throw Native::TaskDeleted();
+}
+
+inline void vTaskDelay(TickType_t ticks)
+{
+    delay(ticks * portTICK_PERIOD_MS);
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+    Native::Task &task = *xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task.mutex);
+    auto isNotified = [&] { return task.notifications > 0; };
+    if (ticks == portMAX_DELAY)
+        task.notified.wait(lock, isNotified);
+    else
+        task.notified.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), isNotified);
+    uint32_t count = task.notifications;
+    if (count > 0)
+        task.notifications = clearOnExit ? 0 : count - 1;
+    return count;
+}
+
+inline void xTaskNotifyGive(TaskHandle_t task)
+{
+    {
+        std::lock_guard<std::mutex> lock(task->mutex);
+        task->notifications++;
+    }
+    task->notified.notify_one();
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+    xTaskNotifyGive(task);
+    if (higherPriorityTaskWoken)
+        *higherPriorityTaskWoken = pdFALSE;
+}
+
+typedef std::timed_mutex *SemaphoreHandle_t;
+
+// Only mutexes, given back by the task that took them
+inline SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new std::timed_mutex();
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        semaphore->lock();
+        return pdTRUE;
+    }
+    if (ticks == 0)
+        return semaphore->try_lock() ? pdTRUE : pdFALSE;
+    return semaphore->try_lock_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS)) ? pdTRUE : pdFALSE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->unlock();
+    return pdTRUE;
+}
+
+// A spinlock like on the esp32, not recursive
+struct portMUX_TYPE
+{
+    std::atomic<bool> locked{false};
+};
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+
+inline void portENTER_CRITICAL(portMUX_TYPE *mux)
+{
+    while (mux->locked.exchange(true, std::memory_order_acquire))
+        std::this_thread::yield();
+}
+
+inline void portEXIT_CRITICAL(portMUX_TYPE *mux)
+{
+    mux->locked.store(false, std::memory_order_release);
+}
+
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+#include <Arduino.h>
+
+// Only declared by main.h, which the harnesses get through the display
+namespace Bounce2
+{
+    class Button
+    {
+    };
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// An HD44780 behind the PCF8574 backpack, decodes the expander's port writes on a fake bus,
+// every byte of a transaction is one port state and En latches the data lines when it falls
+class FakeLcd
+{
+public:
+    static constexpr uint8_t rs = 0x01;
+    static constexpr uint8_t en = 0x04;
+
+    explicit FakeLcd(TwoWire &wire, uint8_t address = 0x27) : address(address)
+    {
+        memset(ddram, ' ', sizeof(ddram));
+        wire.setObserver(onTransaction, this);
+    }
+
+    // The chars shown on a row of a 16x2 lcd
+    std::string getRow(uint8_t row) const
+    {
+        return std::string(ddram + (row ? 0x40 : 0x00), 16);
+    }
+
+    uint32_t getChars() const
+    {
+        return chars;
+    }
+
+    uint32_t getCommands() const
+    {
+        return commands;
+    }
+
+    // The transactions sent to the lcd since the last call, as a logic analyzer on the bus would show them
+    std::vector<std::vector<uint8_t>> takeTransactions()
+    {
+        return std::exchange(transactions, {});
+    }
+
+    // Values whose latch was followed by the next En rise within one byte (22.5 us at 400 kHz),
+    // before a char or a short command is done
+    uint32_t getLatchGapViolations() const
+    {
+        return latchGapViolations;
+    }
+
+private:
+    uint8_t address;
+    char ddram[0x80];
+    uint8_t addressCounter = 0;
+    bool cgram = false;
+    bool fourBit = false;
+    bool highNibbleLatched = false;
+    uint8_t highNibble = 0;
+    uint8_t lastPort = 0;
+    uint32_t bytesSinceLatch = 2;
+    uint32_t chars = 0;
+    uint32_t commands = 0;
+    uint32_t latchGapViolations = 0;
+    std::vector<std::vector<uint8_t>> transactions;
+
+    static void onTransaction(void *context, uint8_t address, const uint8_t *data, size_t length)
+    {
+        FakeLcd &lcd = *(FakeLcd *)context;
+        if (address != lcd.address)
+            return;
+        lcd.transactions.emplace_back(data, data + length);
+        lcd.bytesSinceLatch++; // The address byte
+        for (size_t i = 0; i < length; i++)
+            lcd.onPort(data[i]);
+    }
+
+    void onPort(uint8_t port)
+    {
+        bytesSinceLatch++;
+        if (!(lastPort & en) && (port & en) && !highNibbleLatched && bytesSinceLatch < 2)
+            latchGapViolations++;
+        if ((lastPort & en) && !(port & en))
+            latch(lastPort);
+        lastPort = port;
+    }
+
+    void latch(uint8_t port)
+    {
+        uint8_t nibble = port & 0xF0;
+        if (!fourBit)
+        {
+            // Only D7 to D4 are wired, the low half of an 8 bit transfer reads as 0
+            execute(nibble, port & rs);
+            return;
+        }
+        if (!highNibbleLatched)
+        {
+            highNibble = nibble;
+            highNibbleLatched = true;
+            return;
+        }
+        highNibbleLatched = false;
+        execute(highNibble | nibble >> 4, port & rs);
+    }
+
+    void execute(uint8_t value, bool data)
+    {
+        bytesSinceLatch = 0;
+        if (data)
+        {
+            chars++;
+            if (!cgram)
+                ddram[addressCounter++ & 0x7F] = value;
+            return;
+        }
+        commands++;
+        if (value & 0x80)
+        {
+            addressCounter = value & 0x7F;
+            cgram = false;
+        }
+        else if (value & 0x40)
+            cgram = true;
+        else if (value & 0x20)
+            fourBit = !(value & 0x10);
+        else if (value == 0x01)
+        {
+            memset(ddram, ' ', sizeof(ddram));
+            addressCounter = 0;
+        }
+        else if (value == 0x02)
+            addressCounter = 0;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,7 @@
+#pragma once
+#include <Arduino.h>
+
+// Only declared by main.h, which the harnesses get through the display
+class MPU6050
+{
+};
\ No newline at end of file
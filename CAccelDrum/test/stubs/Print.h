@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Only the writing half of the Arduino Print the lcd driver derives from
+class Print
+{
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t) = 0;
+
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t n = 0;
+        while (size--)
+            n += write(*buffer++);
+        return n;
+    }
+
+    size_t write(const char *str)
+    {
+        return write((const uint8_t *)str, strlen(str));
+    }
+
+    size_t print(const char *str)
+    {
+        return write(str);
+    }
+
+    size_t print(char c)
+    {
+        return write((uint8_t)c);
+    }
+};
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+#include <Arduino.h>
+#include <mutex>
+#include <vector>
+
+#define I2C_BUFFER_LENGTH 128
+
+// A bus that records what is put on it instead of driving one, a device model can watch each finished transaction,
+// transactions are locked like on the esp32
+class TwoWire
+{
+public:
+    using Observer = void (*)(void *context, uint8_t address, const uint8_t *data, size_t length);
+
+    bool begin(int = -1, int = -1, uint32_t = 0)
+    {
+        return true;
+    }
+
+    bool setClock(uint32_t)
+    {
+        return true;
+    }
+
+    void beginTransmission(uint8_t address)
+    {
+        mutex.lock();
+        this->address = address;
+        buffer.clear();
+    }
+
+    // Drops what doesn't fit the esp32's buffer like the real one
+    size_t write(uint8_t data)
+    {
+        if (buffer.size() >= I2C_BUFFER_LENGTH)
+            return 0;
+        buffer.push_back(data);
+        return 1;
+    }
+
+    size_t write(const uint8_t *data, size_t size)
+    {
+        size_t n = 0;
+        while (n < size && write(data[n]))
+            n++;
+        return n;
+    }
+
+    size_t write(int data)
+    {
+        return write((uint8_t)data);
+    }
+
+    uint8_t endTransmission(bool = true)
+    {
+        transactions++;
+        bytes += 1 + buffer.size();
+        if (observer)
+            observer(observerContext, address, buffer.data(), buffer.size());
+        mutex.unlock();
+        return 0;
+    }
+
+    void setObserver(Observer observer, void *context)
+    {
+        this->observer = observer;
+        observerContext = context;
+    }
+
+    uint32_t getTransactions() const
+    {
+        return transactions;
+    }
+
+    // Address bytes included
+    uint64_t getBytes() const
+    {
+        return bytes;
+    }
+
+private:
+    std::recursive_mutex mutex;
+    uint8_t address = 0;
+    std::vector<uint8_t> buffer;
+    Observer observer = nullptr;
+    void *observerContext = nullptr;
+    uint32_t transactions = 0;
+    uint64_t bytes = 0;
+};
+
+inline TwoWire Wire;
+inline TwoWire Wire1;
\ No newline at end of file
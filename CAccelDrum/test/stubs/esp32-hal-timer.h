@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+
+// The task watchdog of the scheduler is never armed on the host
+struct hw_timer_t;
+
+inline hw_timer_t *timerBegin(uint32_t)
+{
+    return nullptr;
+}
+
+inline void timerAttachInterruptArg(hw_timer_t *, void (*)(void *), void *)
+{
+}
+
+inline void timerAlarm(hw_timer_t *, uint64_t, bool, uint64_t)
+{
+}
+
+inline void timerDetachInterrupt(hw_timer_t *)
+{
+}
+
+inline void timerEnd(hw_timer_t *)
+{
+}
+
+inline void timerWrite(hw_timer_t *, uint64_t)
+{
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_ERR_TIMEOUT 0x107
+
+// Aborts like on the esp32, where it also prints a backtrace
+inline void espErrorCheck(esp_err_t err, const char *expression)
+{
+    if (err == ESP_OK)
+        return;
+    fprintf(stderr, "ESP_ERROR_CHECK failed: 0x%x, %s\n", err, expression);
+    abort();
+}
+
+#define ESP_ERROR_CHECK(x) espErrorCheck((x), #x)
\ No newline at end of file
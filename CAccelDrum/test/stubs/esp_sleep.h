@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+// The host never sleeps, the scheduler only sleeps when asked to
+#define ESP_SLEEP_WAKEUP_TIMER 4
+
+inline void esp_sleep_enable_timer_wakeup(uint64_t)
+{
+}
+
+inline void esp_sleep_disable_wakeup_source(int)
+{
+}
+
+inline void esp_light_sleep_start()
+{
+}
+
+inline void esp_deep_sleep_start()
+{
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+
+// Microseconds since the first call, like the time since boot
+inline int64_t esp_timer_get_time()
+{
+    static const std::chrono::steady_clock::time_point boot = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot).count();
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdarg>
+#include <cstdio>
+
+inline int ets_printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int written = vprintf(format, args);
+    va_end(args);
+    return written;
+}
\ No newline at end of file
@@ -0,0 +1,2 @@
+#pragma once
+// Nothing of it is used on the host, included by the scheduler
\ No newline at end of file
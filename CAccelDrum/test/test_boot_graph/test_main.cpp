@@ -0,0 +1,168 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <DeepSleepScheduler.h>
+#include <atomic>
+#include <cstdlib>
+#include "Utils/BootGraph.cpp"
+#include "Utils/BootProfile.cpp"
+
+// The boot graph on both schedulers with the lcd and the mpus replaced by sleeps as long as theirs,
+// scaled down, the phases of independent parts have to overlap in the boot profile
+
+Scheduler uiScheduler;
+
+static constexpr uint32_t lcdMillis = 300; // Two delays in LiquidCrystal_I2C::begin(), 1050 ms
+static constexpr uint32_t initSensorMillis = 15;
+static constexpr uint32_t calibrateMillis = 50; // Per half, 6 loops of CalibrateAccel() or CalibrateGyro()
+
+static std::atomic<bool> sensorsDone(false);
+static std::atomic<uint32_t> sensorSteps[4];
+static std::atomic<BaseType_t> sensorCores[4];
+
+static void initLcd()
+{
+    delay(lcdMillis);
+}
+
+static void initSensor(uint8_t i)
+{
+    sensorCores[i].store(xPortGetCoreID());
+    delay(initSensorMillis);
+    sensorSteps[i]++;
+}
+
+static void calibrateAccel(uint8_t i)
+{
+    delay(calibrateMillis);
+    sensorSteps[i]++;
+}
+
+static void calibrateGyro(uint8_t i)
+{
+    delay(calibrateMillis);
+    sensorSteps[i]++;
+}
+
+static const BootGraph::Steps steps = {initLcd, initSensor, calibrateAccel, calibrateGyro};
+
+static Co::Task boot()
+{
+    co_await BootGraph::bringUpSensors(steps);
+    sensorsDone.store(true);
+}
+
+static bool waitFor(bool (*condition)(), uint32_t timeoutMillis = 5000)
+{
+    unsigned long start = millis();
+    while (!condition())
+    {
+        if (millis() - start > timeoutMillis)
+            return false;
+        delay(1);
+    }
+    return true;
+}
+
+static bool areSensorsDone()
+{
+    return sensorsDone.load();
+}
+
+static const BootProfilePacket::Phase &findPhase(const BootProfilePacket &packet, BootPhase phase)
+{
+    for (size_t i = 0; i < packet.count; i++)
+        if (packet.phases[i].phase == (uint8_t)phase)
+            return packet.phases[i];
+    TEST_FAIL_MESSAGE("phase missing");
+    return packet.phases[0];
+}
+
+static bool isLcdDone()
+{
+    BootProfilePacket packet = BootProfile::makePacket();
+    for (size_t i = 0; i < packet.count; i++)
+        if (packet.phases[i].phase == (uint8_t)BootPhase::Lcd)
+            return packet.phases[i].endMicros != 0;
+    return false;
+}
+
+static uint32_t durationMicros(const BootProfilePacket::Phase &phase)
+{
+    return phase.endMicros - phase.startMicros;
+}
+
+static bool overlap(const BootProfilePacket::Phase &a, const BootProfilePacket::Phase &b)
+{
+    return a.startMicros < b.endMicros && b.startMicros < a.endMicros;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void testPhasesRunInParallel()
+{
+    unsigned long start = micros();
+    BootGraph::startLcd(steps);
+    TEST_ASSERT_TRUE(Co::spawn(scheduler, boot()));
+    TEST_ASSERT_TRUE(waitFor(areSensorsDone));
+    TEST_ASSERT_TRUE(waitFor(isLcdDone));
+    uint32_t wallMicros = micros() - start;
+
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT32(3, sensorSteps[i].load());
+        // The mpus on Wire on the sampling core, the ones on Wire1 on the ui core
+        TEST_ASSERT_EQUAL_INT(i < 2 ? 1 : 0, sensorCores[i].load());
+    }
+
+    BootProfilePacket packet = BootProfile::makePacket();
+    const BootProfilePacket::Phase &lcd = findPhase(packet, BootPhase::Lcd);
+    const BootProfilePacket::Phase &sensorsWire = findPhase(packet, BootPhase::SensorsWire);
+    const BootProfilePacket::Phase &sensorsWire1 = findPhase(packet, BootPhase::SensorsWire1);
+    const BootProfilePacket::Phase &calibrateWire = findPhase(packet, BootPhase::CalibrateWire);
+    const BootProfilePacket::Phase &calibrateWire1 = findPhase(packet, BootPhase::CalibrateWire1);
+    TEST_ASSERT_EQUAL_UINT8(0, lcd.core);
+    TEST_ASSERT_EQUAL_UINT8(1, calibrateWire.core);
+    TEST_ASSERT_EQUAL_UINT8(0, calibrateWire1.core);
+
+    uint32_t phasesMicros = 0;
+    for (const BootProfilePacket::Phase *phase : {&lcd, &sensorsWire, &sensorsWire1, &calibrateWire, &calibrateWire1})
+    {
+        TEST_ASSERT_NOT_EQUAL(0, phase->endMicros);
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(phase->startMicros, phase->endMicros);
+        phasesMicros += durationMicros(*phase);
+    }
+    TEST_ASSERT_TRUE(overlap(sensorsWire, sensorsWire1));
+    TEST_ASSERT_TRUE(overlap(calibrateWire, calibrateWire1));
+    TEST_ASSERT_TRUE(overlap(lcd, calibrateWire));
+    TEST_ASSERT_TRUE(overlap(lcd, calibrateWire1));
+
+    char line[96];
+    snprintf(line, sizeof(line), "boot took %u ms, its phases %u ms one after another",
+             (unsigned)(wallMicros / 1000), (unsigned)(phasesMicros / 1000));
+    TEST_MESSAGE(line);
+    // The lcd is the longest, everything else fits in its sleep
+    TEST_ASSERT_LESS_THAN_UINT32(phasesMicros / 2, wallMicros);
+}
+
+int main(int, char **)
+{
+    scheduler.setTaskTimeout(NO_SUPERVISION);
+    scheduler.acquireNoSleepLock();
+    scheduler.executeOnCore(1, 4096, 1);
+    uiScheduler.setTaskTimeout(NO_SUPERVISION);
+    uiScheduler.acquireNoSleepLock();
+    uiScheduler.executeOnCore(0, 4096, 1);
+
+    UNITY_BEGIN();
+    RUN_TEST(testPhasesRunInParallel);
+    int failures = UNITY_END();
+    // The scheduler threads never return, leave without running the destructors they still use
+    fflush(stdout);
+    std::_Exit(failures);
+}
\ No newline at end of file
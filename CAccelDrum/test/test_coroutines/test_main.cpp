@@ -0,0 +1,209 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <DeepSleepScheduler.h>
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#define COROUTINE_FRAME_COUNT 4
+#include "Utils/CoroutineScheduler.h"
+
+// Both schedulers run on their own thread standing in for their core like on the esp32,
+// the test thread only hands work over through post() and waits for the coroutines to report back
+
+Scheduler uiScheduler;
+
+// Only touched by the coroutines until done is set, read by the test thread afterwards
+static std::string trace;
+static std::atomic<bool> done(false);
+
+static void note(const char *step)
+{
+    trace += step;
+    trace += ' ';
+}
+
+static void noteCore()
+{
+    note(xPortGetCoreID() == 0 ? "core0" : "core1");
+}
+
+static void finish()
+{
+    done.store(true, std::memory_order_release);
+}
+
+static bool waitFor(bool (*condition)(), uint32_t timeoutMillis = 2000)
+{
+    unsigned long start = millis();
+    while (!condition())
+    {
+        if (millis() - start > timeoutMillis)
+            return false;
+        delay(1);
+    }
+    return true;
+}
+
+static bool isDone()
+{
+    return done.load(std::memory_order_acquire);
+}
+
+static bool isArenaEmpty()
+{
+    return Co::frameArena.getUsedCount() == 0;
+}
+
+static Co::Task leaf(const char *start, const char *end, uint32_t millis)
+{
+    note(start);
+    co_await Co::delay(millis);
+    note(end);
+}
+
+static unsigned long nestedMillis[2];
+
+static Co::Task nested()
+{
+    nestedMillis[0] = millis();
+    note("root");
+    co_await leaf("a", "a-done", 5);
+    Co::Task b = leaf("b", "b-done", 10);
+    b.start();
+    co_await Co::delay(1);
+    note("root-between");
+    co_await b;
+    co_await Co::yieldNow();
+    note("root-done");
+    nestedMillis[1] = millis();
+    finish();
+}
+
+static Co::Event event;
+static Co::Mailbox<int> mailbox;
+
+static Co::Task waiter()
+{
+    note("waiting");
+    co_await event;
+    noteCore();
+    int value = co_await mailbox;
+    note(value == 7 ? "got7" : "got?");
+    noteCore();
+    finish();
+}
+
+static Co::Task hopper()
+{
+    noteCore();
+    bool moved = co_await Co::resumeOn(uiScheduler);
+    note(moved ? "moved" : "stayed");
+    noteCore();
+    co_await Co::delay(1); // Scheduled on the ui core's queue now
+    noteCore();
+    co_await Co::resumeOn(scheduler);
+    noteCore();
+    finish();
+}
+
+void setUp()
+{
+    trace.clear();
+    done.store(false);
+}
+
+void tearDown()
+{
+    // A detached task frees its frame right after finish() on the other thread
+    TEST_ASSERT_TRUE_MESSAGE(waitFor(isArenaEmpty), "coroutine frames leaked");
+}
+
+static void testNestedAwaitsRunInOrder()
+{
+    TEST_ASSERT_TRUE(Co::spawn(scheduler, nested()));
+    TEST_ASSERT_TRUE(waitFor(isDone));
+    TEST_ASSERT_EQUAL_STRING("root a a-done b root-between b-done root-done ", trace.c_str());
+    // a waits 5 ms, b runs alongside root and waits 10 more
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(15, nestedMillis[1] - nestedMillis[0]);
+}
+
+static void testEventAndMailboxResumeOnTheWaitersCore()
+{
+    event.reset();
+    TEST_ASSERT_TRUE(Co::spawn(scheduler, waiter()));
+    delay(20);
+    TEST_ASSERT_FALSE(isDone());
+
+    // Set from the core the waiter runs on, as their threading rules ask
+    TEST_ASSERT_TRUE(scheduler.post([]
+    {
+        event.set();
+    }));
+    TEST_ASSERT_TRUE(scheduler.post([]
+    {
+        mailbox.put(7);
+    }));
+    TEST_ASSERT_TRUE(waitFor(isDone));
+    TEST_ASSERT_EQUAL_STRING("waiting core1 got7 core1 ", trace.c_str());
+    TEST_ASSERT_FALSE(mailbox.hasValue());
+    TEST_ASSERT_EQUAL_UINT32(0, mailbox.getOverwrittenCount());
+}
+
+static void testResumeOnMovesBetweenCores()
+{
+    TEST_ASSERT_TRUE(Co::spawn(scheduler, hopper()));
+    TEST_ASSERT_TRUE(waitFor(isDone));
+    TEST_ASSERT_EQUAL_STRING("core1 moved core0 core0 core1 ", trace.c_str());
+}
+
+static void testMailboxKeepsTheLatestValue()
+{
+    Co::Mailbox<int> box;
+    box.put(1);
+    box.put(2);
+    TEST_ASSERT_TRUE(box.hasValue());
+    TEST_ASSERT_FALSE(box.isAwaited());
+    TEST_ASSERT_EQUAL_UINT32(1, box.getOverwrittenCount());
+}
+
+static void testFullArenaRefusesFrames()
+{
+    uint32_t failedBefore = Co::frameArena.getFailedCount();
+    {
+        Co::Task tasks[Co::frameArena.blockCount + 2];
+        for (Co::Task &task : tasks)
+            task = leaf("never", "never", 0);
+        for (uint32_t i = 0; i < Co::frameArena.blockCount; i++)
+            TEST_ASSERT_TRUE(tasks[i].isValid());
+        TEST_ASSERT_FALSE(tasks[Co::frameArena.blockCount].isValid());
+        TEST_ASSERT_TRUE(tasks[Co::frameArena.blockCount + 1].isDone());
+        TEST_ASSERT_FALSE(Co::spawn(scheduler, leaf("never", "never", 0)));
+        TEST_ASSERT_EQUAL_UINT32(Co::frameArena.blockCount, Co::frameArena.getUsedCount());
+    }
+    // Unstarted tasks are destroyed with their owner, their bodies never ran
+    TEST_ASSERT_EQUAL_UINT32(0, Co::frameArena.getUsedCount());
+    TEST_ASSERT_EQUAL_UINT32(3, Co::frameArena.getFailedCount() - failedBefore);
+    TEST_ASSERT_EQUAL_STRING("", trace.c_str());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(Co::frameArena.blockSize, Co::frameArena.getLargestRequest());
+}
+
+int main(int, char **)
+{
+    scheduler.setTaskTimeout(NO_SUPERVISION);
+    scheduler.acquireNoSleepLock();
+    scheduler.executeOnCore(1, 4096, 1);
+    uiScheduler.setTaskTimeout(NO_SUPERVISION);
+    uiScheduler.acquireNoSleepLock();
+    uiScheduler.executeOnCore(0, 4096, 1);
+
+    UNITY_BEGIN();
+    RUN_TEST(testNestedAwaitsRunInOrder);
+    RUN_TEST(testEventAndMailboxResumeOnTheWaitersCore);
+    RUN_TEST(testResumeOnMovesBetweenCores);
+    RUN_TEST(testMailboxKeepsTheLatestValue);
+    RUN_TEST(testFullArenaRefusesFrames);
+    int failures = UNITY_END();
+    // The scheduler threads never return, leave without running the destructors they still use
+    fflush(stdout);
+    std::_Exit(failures);
+}
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <DeepSleepScheduler.h>
+#include <FakeLcd.h>
+// Built in here instead of with the rest of src, which needs the sensors and serial
+#include "display/display.cpp"
+#include "display/widgets.cpp"
+#include "Utils/I2cArbiter.cpp"
+#include "Utils/Utils.cpp"
+
+// Counts the I2C bytes of each frame on a fake bus and checks what the lcd behind it shows
+
+static FakeLcd fakeLcd(Wire);
+
+// Address and 1 + 5 bytes per value, see LiquidCrystal_I2C::sendBatch()
+static constexpr uint32_t cursorBytes = 1 + 1 + 5;
+
+static constexpr uint32_t charBytes(uint32_t count)
+{
+    return 1 + 1 + 5 * count;
+}
+
+// Both rows sent whole each frame, what the display did before it tracked the changed cells
+static constexpr uint32_t fullReprintBytes = Display::rows * (cursorBytes + charBytes(Display::cols));
+
+// Runs one refresh, returns the bytes it put on the bus
+static uint32_t refresh()
+{
+    uint64_t before = Wire.getBytes();
+    TEST_ASSERT_TRUE(display.update());
+    return (uint32_t)(Wire.getBytes() - before);
+}
+
+static void assertShows(const char *row0, const char *row1)
+{
+    TEST_ASSERT_EQUAL_STRING(row0, fakeLcd.getRow(0).c_str());
+    TEST_ASSERT_EQUAL_STRING(row1, fakeLcd.getRow(1).c_str());
+}
+
+void setUp()
+{
+    display.clear();
+    refresh();
+}
+
+void tearDown()
+{
+}
+
+static void testFrameStatsCountTheBusBytes()
+{
+    Display::FrameStats before = display.getFrameStats();
+    display.format(0, 0, "Boot");
+    uint32_t bytes = refresh();
+    assertShows("Boot            ", "                ");
+    TEST_ASSERT_EQUAL_UINT32(cursorBytes + charBytes(4), bytes);
+
+    Display::FrameStats after = display.getFrameStats();
+    TEST_ASSERT_EQUAL_UINT32(before.frames + 1, after.frames);
+    TEST_ASSERT_EQUAL_UINT32(bytes, after.lastFrameBytes);
+    TEST_ASSERT_EQUAL_UINT64(before.totalBytes + bytes, after.totalBytes);
+}
+
+static void testUnchangedFrameSendsNothing()
+{
+    display.format(0, 1, "same");
+    refresh();
+    Display::FrameStats before = display.getFrameStats();
+    display.format(0, 1, "same");
+    TEST_ASSERT_EQUAL_UINT32(0, refresh());
+    TEST_ASSERT_EQUAL_UINT32(before.frames, display.getFrameStats().frames);
+}
+
+static void testOnlyChangedCellsAreSent()
+{
+    display.format(0, 1, "0:0:1 12.3k");
+    refresh();
+    display.format(0, 1, "0:0:2 12.3k");
+    TEST_ASSERT_EQUAL_UINT32(cursorBytes + charBytes(1), refresh());
+    // Cells one clean cell apart go out as one run, rewriting the gap is as cheap as moving the cursor
+    display.format(0, 1, "0:0:2 13.4k");
+    TEST_ASSERT_EQUAL_UINT32(cursorBytes + charBytes(3), refresh());
+    // Further apart each run moves the cursor
+    display.format(0, 1, "0:0:3 13.5k");
+    TEST_ASSERT_EQUAL_UINT32(2 * (cursorBytes + charBytes(1)), refresh());
+    assertShows("                ", "0:0:3 13.5k     ");
+}
+
+// A minute of the run screen refreshed every 100 ms, the clock and send count tick each second
+// and an overlay is replaced every 800 ms
+static void testRunScreenAgainstFullReprint()
+{
+    uint64_t bytes = 0;
+    uint32_t frames = 0;
+    char numSentMetric[10];
+    for (uint32_t tick = 0; tick < 600; tick++)
+    {
+        uint32_t secs = tick / 10;
+        Utils::formatMetric(numSentMetric, sizeof(numSentMetric), tick * 10, 1);
+        display.format(0, 1, "{}:{}:{} {}", secs / 3600, secs / 60 % 60, secs % 60, numSentMetric);
+        if (tick % 8 == 0)
+        {
+            display.overlayClear();
+            display.overlayFormat(12, 0, 60'000, "|{}|", tick / 8 % 100);
+        }
+        bytes += refresh();
+        frames++;
+    }
+    assertShows("            |74|", "0:0:59 6.0k     ");
+
+    char line[96];
+    snprintf(line, sizeof(line), "%.1f bytes per frame, %u for a full reprint",
+             (double)bytes / frames, (unsigned)fullReprintBytes);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_LESS_THAN_UINT32(fullReprintBytes / 4, (uint32_t)(bytes / frames));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(fullReprintBytes, display.getFrameStats().maxFrameBytes);
+}
+
+int main(int, char **)
+{
+    display.init();
+    UNITY_BEGIN();
+    RUN_TEST(testFrameStatsCountTheBusBytes);
+    RUN_TEST(testUnchangedFrameSendsNothing);
+    RUN_TEST(testOnlyChangedCellsAreSent);
+    RUN_TEST(testRunScreenAgainstFullReprint);
+    return UNITY_END();
+}
\ No newline at end of file
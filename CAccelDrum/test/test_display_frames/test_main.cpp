@@ -0,0 +1,195 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <DeepSleepScheduler.h>
+#include <FakeLcd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+// Built in here instead of with the rest of src, which needs the sensors and serial
+#include "display/display.cpp"
+#include "display/widgets.cpp"
+#include "Utils/I2cArbiter.cpp"
+#include "Utils/Utils.cpp"
+
+// Writers on several threads publish frames while the refresh sends them to the fake lcd,
+// the lcd may only ever show frames as they were published
+
+static FakeLcd fakeLcd(Wire);
+
+static constexpr uint32_t writers = 3;
+static constexpr uint32_t stressMillis = 2000;
+
+static std::atomic<bool> stop(false);
+
+static bool isUniform(const std::string &row0, const std::string &row1)
+{
+    for (char c : row0 + row1)
+        if (c != row0[0])
+            return false;
+    return true;
+}
+
+void setUp()
+{
+    stop.store(false);
+    display.clear();
+    display.update();
+}
+
+void tearDown()
+{
+}
+
+// Every frame is filled with one char, so a frame mixed from two publishes shows up on the lcd
+static void testRefreshOnlyShowsWholeFrames()
+{
+    static std::atomic<uint64_t> edits(0);
+    std::vector<std::thread> threads;
+    for (uint32_t w = 0; w < writers; w++)
+        threads.emplace_back([w]
+        {
+            for (uint32_t k = 0; !stop.load(); k++)
+            {
+                char c = "aA0"[w] + k % 10;
+                display.edit([c](Display::Frame &frame)
+                {
+                    for (uint32_t j = 0; j < Display::rows; j++)
+                        memset(frame.text[j], c, Display::cols);
+                });
+                edits++;
+            }
+        });
+
+    uint32_t frames = 0;
+    uint32_t torn = 0;
+    unsigned long start = millis();
+    while (millis() - start < stressMillis)
+    {
+        TEST_ASSERT_TRUE(display.update());
+        frames++;
+        torn += !isUniform(fakeLcd.getRow(0), fakeLcd.getRow(1));
+    }
+    stop.store(true);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    char line[96];
+    snprintf(line, sizeof(line), "%u frames shown while %llu were published",
+             (unsigned)frames, (unsigned long long)edits.load());
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_GREATER_THAN_UINT32(writers, display.getFrameStats().frames);
+}
+
+// Each edit increments a counter in the frame, an edit that lost its race and wasn't redone would drop one
+static void testConcurrentEditsAreNotLost()
+{
+    static constexpr uint32_t incrementsPerWriter = 5'000;
+    static std::atomic<uint32_t> finished(0);
+    std::vector<std::thread> threads;
+    for (uint32_t w = 0; w < writers; w++)
+        threads.emplace_back([]
+        {
+            for (uint32_t i = 0; i < incrementsPerWriter; i++)
+                display.edit([](Display::Frame &frame)
+                {
+                    uint32_t count = 0;
+                    sscanf(frame.text[0], "%8u", &count);
+                    // Lets the other writers in between even on a single cpu
+                    delayMicroseconds(1);
+                    Fmt::formatTo(frame.text[0], 9, "{:08}", count + 1);
+                    frame.text[0][8] = ' ';
+                });
+            finished++;
+        });
+    // Refreshed meanwhile, pinning frames the writers then have to avoid
+    while (finished.load() < writers)
+    {
+        display.update();
+        std::this_thread::yield();
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    display.update();
+    char expected[9];
+    Fmt::formatTo(expected, "{:08}", writers * incrementsPerWriter);
+    TEST_ASSERT_EQUAL_STRING(expected, fakeLcd.getRow(0).substr(0, 8).c_str());
+}
+
+// After the stress every frame but the published one can still be held by an edit at once,
+// a frame that was never freed again leaves one of them waiting
+static void testNoFrameIsLeaked()
+{
+    static constexpr uint32_t holders = 3; // All the frames but the published one
+    static std::atomic<uint32_t> holding(0);
+    static std::atomic<bool> release(false);
+    std::vector<std::thread> threads;
+    for (uint32_t h = 0; h < holders; h++)
+        threads.emplace_back([]
+        {
+            display.edit([](Display::Frame &)
+            {
+                holding++;
+                while (!release.load())
+                    std::this_thread::yield();
+            });
+        });
+    unsigned long start = millis();
+    while (holding.load() < holders && millis() - start < 1000)
+        std::this_thread::yield();
+    uint32_t held = holding.load();
+    release.store(true);
+    for (std::thread &thread : threads)
+    {
+        // One waiting for a leaked frame never returns
+        if (held == holders)
+            thread.join();
+        else
+            thread.detach();
+    }
+    TEST_ASSERT_EQUAL_UINT32(holders, held);
+}
+
+// Interleaves two edits by hand, the first one copies the frame, then the second one publishes
+// before the first one does, so the first one has to be redone on top of the second one
+static void testLosingEditIsRedone()
+{
+    static std::atomic<bool> copied(false);
+    static std::atomic<bool> overtaken(false);
+    static std::atomic<uint32_t> runs(0);
+    std::thread first([]
+    {
+        display.edit([](Display::Frame &frame)
+        {
+            runs++;
+            copied.store(true);
+            while (!overtaken.load())
+                std::this_thread::yield();
+            frame.text[0][0]++;
+        });
+    });
+    while (!copied.load())
+        std::this_thread::yield();
+    display.edit([](Display::Frame &frame)
+    {
+        frame.text[0][0] = 'a';
+    });
+    overtaken.store(true);
+    first.join();
+
+    TEST_ASSERT_EQUAL_UINT32(2, runs.load());
+    TEST_ASSERT_TRUE(display.update());
+    TEST_ASSERT_EQUAL_CHAR('b', fakeLcd.getRow(0)[0]);
+}
+
+int main(int, char **)
+{
+    display.init();
+    UNITY_BEGIN();
+    RUN_TEST(testLosingEditIsRedone);
+    RUN_TEST(testRefreshOnlyShowsWholeFrames);
+    RUN_TEST(testConcurrentEditsAreNotLost);
+    RUN_TEST(testNoFrameIsLeaked);
+    return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <unity.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include "Utils/Format.h"
+
+// Every heap allocation in the process is counted, formatting has to get by without any
+
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *p = malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+// What the text paths did before Format.h, sized with one snprintf and formatted into a heap string by another
+template <typename... Args>
+static std::string stringSprintf(const char *format, Args... args)
+{
+    int length = snprintf(nullptr, 0, format, args...);
+    char *buf = new char[length + 1];
+    snprintf(buf, length + 1, format, args...);
+    std::string str(buf);
+    delete[] buf;
+    return str;
+}
+
+static constexpr uint32_t iterations = 200'000;
+static volatile size_t sink;
+
+struct Measurement
+{
+    double nanos;
+    size_t allocations;
+};
+
+template <typename Operation>
+static Measurement measure(Operation operation)
+{
+    size_t allocationsBefore = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < iterations; i++)
+        sink = sink + operation(i);
+    double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return {nanos / iterations, allocations - allocationsBefore};
+}
+
+static void report(const char *name, const Measurement &old, const Measurement &fmt)
+{
+    char line[128];
+    snprintf(line, sizeof(line), "%s: printf %.0f ns %.1f allocs, Fmt %.0f ns %.1f allocs",
+             name, old.nanos, (double)old.allocations / iterations, fmt.nanos, (double)fmt.allocations / iterations);
+    TEST_MESSAGE(line);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void testFormatsLikeTheSpec()
+{
+    char b[64];
+    Fmt::formatTo(b, "{}:{}:{} {}", 1u, 2, -3, "x");
+    TEST_ASSERT_EQUAL_STRING("1:2:-3 x", b);
+    Fmt::formatTo(b, "{:5}|{:05}|{:x}|{:X}|{:04x}", -12, -12, 255, 255u, 10);
+    TEST_ASSERT_EQUAL_STRING("  -12|-0012|ff|FF|000a", b);
+    Fmt::formatTo(b, "{:.1}|{}|{:.0}|{:8.3}|{:.3}", 1.25f, -0.001, 2.5, 3.14159, -1.0015);
+    TEST_ASSERT_EQUAL_STRING("1.3|0.00|3|   3.142|-1.002", b);
+    Fmt::formatTo(b, "{}|{:d}|{:c}|{:d}|{:s}", true, false, 65, 'a', true);
+    TEST_ASSERT_EQUAL_STRING("true|0|A|97|true", b);
+    Fmt::formatTo(b, "{{{}}} {}", 7, Fmt::Fixed{12.345f, 1});
+    TEST_ASSERT_EQUAL_STRING("{7} 12.3", b);
+    Fmt::formatTo(b, "{:6s}|{:.2}", std::string_view("ab"), "xyz");
+    TEST_ASSERT_EQUAL_STRING("    ab|xy", b);
+    Fmt::formatTo(b, "{} {}", INT64_MIN, UINT64_MAX);
+    TEST_ASSERT_EQUAL_STRING("-9223372036854775808 18446744073709551615", b);
+    Fmt::formatTo(b, "{} {} {} {:.2}", NAN, INFINITY, -INFINITY, 0.999);
+    TEST_ASSERT_EQUAL_STRING("nan inf -inf 1.00", b);
+}
+
+static void testTruncatesAndStreams()
+{
+    char small[6];
+    TEST_ASSERT_EQUAL_UINT32(9, Fmt::formatTo(small, "hello {}", 123));
+    TEST_ASSERT_EQUAL_STRING("hello", small);
+    auto truncated = Fmt::format<3>("|{}|", 1234);
+    TEST_ASSERT_EQUAL_STRING("|12", truncated.c_str());
+    TEST_ASSERT_TRUE(truncated.isTruncated());
+
+    // Flushed in full chunks like the text packets, the last part goes out on finish()
+    static std::string out;
+    static int parts;
+    out.clear();
+    parts = 0;
+    char chunk[4];
+    Fmt::Writer w(chunk, sizeof(chunk), [](void *, const char *data, size_t length, bool)
+    {
+        out.append(data, length);
+        parts++;
+    });
+    Fmt::formatTo(w, "abc{}def", 12345);
+    w.finish();
+    TEST_ASSERT_EQUAL_STRING("abc12345def", out.c_str());
+    TEST_ASSERT_EQUAL_INT(3, parts);
+    TEST_ASSERT_EQUAL_UINT32(11, w.getTotal());
+}
+
+// The lines the firmware formats most, against the printf calls they replaced
+static void testBenchmarkAgainstPrintf()
+{
+    char b[32];
+    Measurement clockPrintf = measure([&](uint32_t i)
+    {
+        return snprintf(b, 17, "%u:%u:%u %s", i / 3600, i / 60 % 60, i % 60, "12.3k");
+    });
+    Measurement clockFmt = measure([&](uint32_t i)
+    {
+        return Fmt::formatTo(b, 17, "{}:{}:{} {}", i / 3600, i / 60 % 60, i % 60, "12.3k");
+    });
+    report("clock line", clockPrintf, clockFmt);
+
+    Measurement metricPrintf = measure([&](uint32_t i)
+    {
+        return snprintf(b, 10, "%.*fk", 1, i / 1000.0f);
+    });
+    Measurement metricFmt = measure([&](uint32_t i)
+    {
+        return Fmt::formatTo(b, 10, "{}k", Fmt::Fixed{i / 1000.0f, 1});
+    });
+    report("metric", metricPrintf, metricFmt);
+
+    char packet[123];
+    Measurement textPrintf = measure([&](uint32_t i)
+    {
+        std::string s = stringSprintf("Task %s ran %u times in %u us", "serial", i, i * 3);
+        return s.copy(packet, sizeof(packet));
+    });
+    Measurement textFmt = measure([&](uint32_t i)
+    {
+        Fmt::Writer w(packet, sizeof(packet));
+        Fmt::formatTo(w, "Task {} ran {} times in {} us", "serial", i, i * 3);
+        return w.getTotal();
+    });
+    report("text packet", textPrintf, textFmt);
+
+    TEST_ASSERT_EQUAL_UINT32(0, clockFmt.allocations);
+    TEST_ASSERT_EQUAL_UINT32(0, metricFmt.allocations);
+    TEST_ASSERT_EQUAL_UINT32(0, textFmt.allocations);
+    // Only reported, the host's printf says little about the newlib one on the esp32
+    TEST_ASSERT_EQUAL_UINT32(2 * iterations, textPrintf.allocations);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(testFormatsLikeTheSpec);
+    RUN_TEST(testTruncatesAndStreams);
+    RUN_TEST(testBenchmarkAgainstPrintf);
+    return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <Wire.h>
+#include <LiquidCrystal_I2C.h>
+#include <FakeLcd.h>
+#include <cstring>
+
+// The expander bytes LiquidCrystal_I2C puts on the bus for chars and commands,
+// and what an HD44780 behind the expander makes of them
+
+static FakeLcd fakeLcd(Wire1);
+static LiquidCrystal_I2C lcd(0x27, 16, 2, Wire1);
+
+static constexpr uint8_t backlight = LCD_BACKLIGHT;
+
+// The four expander bytes that clock one value in, followed by the spare byte
+static std::vector<uint8_t> nibbles(uint8_t value, uint8_t mode)
+{
+    uint8_t high = (value & 0xF0) | mode | backlight;
+    uint8_t low = (value << 4 & 0xF0) | mode | backlight;
+    return {(uint8_t)(high | En), high, (uint8_t)(low | En), low, low};
+}
+
+static size_t totalBytes(const std::vector<std::vector<uint8_t>> &transactions)
+{
+    size_t bytes = 0;
+    for (const std::vector<uint8_t> &transaction : transactions)
+        bytes += transaction.size();
+    return bytes;
+}
+
+void setUp()
+{
+    fakeLcd.takeTransactions();
+}
+
+void tearDown()
+{
+    TEST_ASSERT_EQUAL_UINT32(0, fakeLcd.getLatchGapViolations());
+}
+
+static void testCharIsOneTransaction()
+{
+    lcd.setCursor(0, 0);
+    fakeLcd.takeTransactions();
+    lcd.write((uint8_t)'A');
+    std::vector<std::vector<uint8_t>> transactions = fakeLcd.takeTransactions();
+    TEST_ASSERT_EQUAL_UINT32(1, transactions.size());
+    // Rs and the data lines are set up before the first En rise
+    const uint8_t expected[] = {0x49, 0x4D, 0x49, 0x1D, 0x19, 0x19};
+    TEST_ASSERT_EQUAL_UINT32(sizeof(expected), transactions[0].size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, transactions[0].data(), sizeof(expected));
+    TEST_ASSERT_EQUAL_CHAR('A', fakeLcd.getRow(0)[0]);
+}
+
+static void testCommandKeepsRsLow()
+{
+    lcd.setCursor(3, 1);
+    std::vector<std::vector<uint8_t>> transactions = fakeLcd.takeTransactions();
+    TEST_ASSERT_EQUAL_UINT32(1, transactions.size());
+    std::vector<uint8_t> expected = nibbles(0x80 | 0x43, 0);
+    expected.insert(expected.begin(), expected[1]);
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), transactions[0].size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected.data(), transactions[0].data(), expected.size());
+}
+
+static void testStringIsOneTransaction()
+{
+    lcd.setCursor(0, 1);
+    fakeLcd.takeTransactions();
+    lcd.write((const uint8_t *)"Hello", 5);
+    std::vector<std::vector<uint8_t>> transactions = fakeLcd.takeTransactions();
+    TEST_ASSERT_EQUAL_UINT32(1, transactions.size());
+    TEST_ASSERT_EQUAL_UINT32(1 + 5 * 5, transactions[0].size());
+    for (size_t i = 0; i < 5; i++)
+    {
+        std::vector<uint8_t> expected = nibbles("Hello"[i], Rs);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected.data(), transactions[0].data() + 1 + i * 5, expected.size());
+    }
+    TEST_ASSERT_EQUAL_STRING("Hello", fakeLcd.getRow(1).substr(0, 5).c_str());
+}
+
+static void testLongWriteSplitsAtTheBatchSize()
+{
+    char chars[40];
+    memset(chars, 'x', sizeof(chars));
+    lcd.setCursor(0, 0);
+    fakeLcd.takeTransactions();
+    uint32_t charsBefore = fakeLcd.getChars();
+    lcd.write((const uint8_t *)chars, sizeof(chars));
+    std::vector<std::vector<uint8_t>> transactions = fakeLcd.takeTransactions();
+    TEST_ASSERT_GREATER_THAN_UINT32(1, transactions.size());
+    for (const std::vector<uint8_t> &transaction : transactions)
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(LCD_I2C_BATCH_SIZE, transaction.size());
+    // The setup byte is only sent once
+    TEST_ASSERT_EQUAL_UINT32(1 + 5 * sizeof(chars), totalBytes(transactions));
+    TEST_ASSERT_EQUAL_UINT32(sizeof(chars), fakeLcd.getChars() - charsBefore);
+    TEST_ASSERT_EQUAL_STRING("xxxxxxxxxxxxxxxx", fakeLcd.getRow(0).c_str());
+}
+
+// A whole row against the two write4bits per value the library used before, three transactions each
+static void testRowAgainstPerNibbleTransactions()
+{
+    lcd.setCursor(0, 1);
+    lcd.print("Row update 12345");
+    std::vector<std::vector<uint8_t>> transactions = fakeLcd.takeTransactions();
+    TEST_ASSERT_EQUAL_STRING("Row update 12345", fakeLcd.getRow(1).c_str());
+
+    size_t bytes = totalBytes(transactions) + transactions.size();
+    size_t oldTransactions = 17 * 2 * 3;
+    size_t oldBytes = oldTransactions * 2;
+    char line[128];
+    snprintf(line, sizeof(line), "row: %u transactions, %u bytes, before %u transactions, %u bytes",
+             (unsigned)transactions.size(), (unsigned)bytes, (unsigned)oldTransactions, (unsigned)oldBytes);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_UINT32(2, transactions.size());
+    TEST_ASSERT_LESS_THAN_UINT32(oldBytes, bytes);
+}
+
+int main(int, char **)
+{
+    lcd.begin(16, 2);
+    lcd.backlight();
+    UNITY_BEGIN();
+    RUN_TEST(testCharIsOneTransaction);
+    RUN_TEST(testCommandKeepsRsLow);
+    RUN_TEST(testStringIsOneTransaction);
+    RUN_TEST(testLongWriteSplitsAtTheBatchSize);
+    RUN_TEST(testRowAgainstPerNibbleTransactions);
+    return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include <unity.h>
+#include <array>
+#include <thread>
+#include <vector>
+#include "Utils/LockFreeQueue.h"
+
+// As large as a SerialPacket, every word carries the same value so a torn copy shows up
+struct Item
+{
+    uint32_t producer;
+    uint32_t seq;
+    std::array<uint32_t, 34> check;
+
+    static Item make(uint32_t producer, uint32_t seq)
+    {
+        Item item{producer, seq, {}};
+        item.check.fill(producer * 7919 ^ seq);
+        return item;
+    }
+
+    bool isWhole() const
+    {
+        for (uint32_t word : check)
+            if (word != (producer * 7919 ^ seq))
+                return false;
+        return true;
+    }
+};
+
+static constexpr uint32_t producers = 4;
+static constexpr uint32_t itemsPerProducer = 50'000;
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void testMpscKeepsEveryProducersOrder()
+{
+    static MpscQueue<Item, 16> queue;
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; p++)
+        threads.emplace_back([p]
+        {
+            for (uint32_t i = 0; i < itemsPerProducer;)
+                if (queue.tryPush(Item::make(p, i)))
+                    i++;
+                else
+                    std::this_thread::yield();
+        });
+
+    std::array<uint32_t, producers> next{};
+    uint32_t received = 0;
+    uint32_t torn = 0;
+    uint32_t outOfOrder = 0;
+    while (received < producers * itemsPerProducer)
+    {
+        Item *item = queue.front();
+        if (!item)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        torn += !item->isWhole();
+        outOfOrder += item->seq != next[item->producer];
+        next[item->producer] = item->seq + 1;
+        queue.pop();
+        received++;
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+    TEST_ASSERT_TRUE(queue.isEmpty());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(decltype(queue)::capacity, queue.getHighWaterMark());
+}
+
+static void testSpscHandsOverInOrder()
+{
+    static SpscQueue<Item, 8> queue;
+    std::thread producer([]
+    {
+        for (uint32_t i = 0; i < itemsPerProducer;)
+            if (queue.tryPush(Item::make(0, i)))
+                i++;
+            else
+                std::this_thread::yield();
+    });
+
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < itemsPerProducer;)
+    {
+        Item item;
+        if (!queue.tryPop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        mismatches += item.seq != i || !item.isWhole();
+        i++;
+    }
+    producer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+    TEST_ASSERT_TRUE(queue.isEmpty());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(decltype(queue)::capacity, queue.getHighWaterMark());
+}
+
+// A full queue refuses the push and counts it, the ring keeps working after wrapping around
+template <typename Queue>
+static void checkOverflowAndWrap()
+{
+    static Queue queue;
+    for (uint32_t round = 0; round < 3; round++)
+    {
+        for (uint32_t i = 0; i < Queue::capacity; i++)
+            TEST_ASSERT_TRUE(queue.tryPush(Item::make(round, i)));
+        TEST_ASSERT_FALSE(queue.tryPush(Item::make(round, Queue::capacity)));
+        for (uint32_t i = 0; i < Queue::capacity; i++)
+        {
+            Item item;
+            TEST_ASSERT_TRUE(queue.tryPop(item));
+            TEST_ASSERT_EQUAL_UINT32(round, item.producer);
+            TEST_ASSERT_EQUAL_UINT32(i, item.seq);
+        }
+        TEST_ASSERT_NULL(queue.front());
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, queue.getOverflowCount());
+    TEST_ASSERT_EQUAL_UINT32(Queue::capacity, queue.getHighWaterMark());
+}
+
+static void testMpscCountsOverflows()
+{
+    checkOverflowAndWrap<MpscQueue<Item, 4>>();
+}
+
+static void testSpscCountsOverflows()
+{
+    checkOverflowAndWrap<SpscQueue<Item, 4>>();
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(testMpscKeepsEveryProducersOrder);
+    RUN_TEST(testSpscHandsOverInOrder);
+    RUN_TEST(testMpscCountsOverflows);
+    RUN_TEST(testSpscCountsOverflows);
+    return UNITY_END();
+}
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include <unity.h>
+#include <Arduino.h>
+#include <DeepSleepScheduler.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+// The sorted singly linked list the scheduler used before the binary heap, reduced to its queue,
+// inserting walks to the first later task, removing a task walks to its predecessor
+class SortedList
+{
+public:
+    struct Task
+    {
+        uint64_t scheduledUptimeMicros;
+        Task *next;
+    };
+
+    void insert(Task *newTask)
+    {
+        newTask->next = nullptr;
+        if (first == nullptr || first->scheduledUptimeMicros > newTask->scheduledUptimeMicros)
+        {
+            newTask->next = first;
+            first = newTask;
+            return;
+        }
+        Task *previousTask = first;
+        while (previousTask->next != nullptr &&
+               previousTask->next->scheduledUptimeMicros <= newTask->scheduledUptimeMicros)
+            previousTask = previousTask->next;
+        newTask->next = previousTask->next;
+        previousTask->next = newTask;
+    }
+
+    bool remove(Task *task)
+    {
+        for (Task **link = &first; *link != nullptr; link = &(*link)->next)
+            if (*link == task)
+            {
+                *link = task->next;
+                return true;
+            }
+        return false;
+    }
+
+    bool reschedule(Task *task, uint64_t uptimeMicros)
+    {
+        if (!remove(task))
+            return false;
+        task->scheduledUptimeMicros = uptimeMicros;
+        insert(task);
+        return true;
+    }
+
+    bool isSorted() const
+    {
+        for (Task *task = first; task != nullptr && task->next != nullptr; task = task->next)
+            if (task->scheduledUptimeMicros > task->next->scheduledUptimeMicros)
+                return false;
+        return true;
+    }
+
+private:
+    Task *first = nullptr;
+};
+
+class NoOp : public Runnable
+{
+public:
+    void run() override
+    {
+    }
+};
+
+static constexpr uint32_t operations = 20'000;
+// Far enough ahead that nothing becomes due while measuring
+static constexpr unsigned long firstMillis = 1'000'000;
+static constexpr unsigned long spanMillis = 1'000'000;
+
+static NoOp runnables[1001];
+
+struct Result
+{
+    double heapNanos;
+    double listNanos;
+};
+
+template <typename Operation>
+static double nanosPerOperation(Operation operation)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < operations; i++)
+        operation(i);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / operations;
+}
+
+// Moves a random queued task to a random time, what every periodic or delayed task does when it's rescheduled
+static Result benchmarkReschedule(uint32_t taskCount)
+{
+    std::mt19937 random(taskCount);
+    std::vector<unsigned long> times(operations);
+    std::vector<uint32_t> picks(operations);
+    for (uint32_t i = 0; i < operations; i++)
+    {
+        times[i] = firstMillis + random() % spanMillis;
+        picks[i] = random() % taskCount;
+    }
+
+    std::vector<TaskHandle> handles;
+    std::vector<SortedList::Task> listTasks(taskCount);
+    SortedList list;
+    for (uint32_t i = 0; i < taskCount; i++)
+    {
+        unsigned long at = firstMillis + random() % spanMillis;
+        handles.push_back(scheduler.scheduleAt(&runnables[i], at));
+        listTasks[i].scheduledUptimeMicros = (uint64_t)at * 1000;
+        list.insert(&listTasks[i]);
+    }
+
+    uint32_t heapMisses = 0;
+    uint32_t listMisses = 0;
+    Result result;
+    result.heapNanos = nanosPerOperation([&](uint32_t i)
+    {
+        heapMisses += !scheduler.reschedule(handles[picks[i]], times[i]);
+    });
+    result.listNanos = nanosPerOperation([&](uint32_t i)
+    {
+        listMisses += !list.reschedule(&listTasks[picks[i]], (uint64_t)times[i] * 1000);
+    });
+
+    TEST_ASSERT_EQUAL_UINT32(0, heapMisses);
+    TEST_ASSERT_EQUAL_UINT32(0, listMisses);
+    TEST_ASSERT_TRUE(list.isSorted());
+    TEST_ASSERT_EQUAL_UINT32(taskCount, scheduler.getQueuedTaskCount());
+    for (TaskHandle &handle : handles)
+        TEST_ASSERT_TRUE(scheduler.cancel(handle));
+    return result;
+}
+
+// Schedules one more task into a queue of taskCount and cancels it again through its handle
+static Result benchmarkInsertCancel(uint32_t taskCount)
+{
+    std::mt19937 random(taskCount);
+    std::vector<unsigned long> times(operations);
+    for (unsigned long &time : times)
+        time = firstMillis + random() % spanMillis;
+
+    std::vector<TaskHandle> handles;
+    std::vector<SortedList::Task> listTasks(taskCount + 1);
+    SortedList list;
+    for (uint32_t i = 0; i < taskCount; i++)
+    {
+        unsigned long at = firstMillis + random() % spanMillis;
+        handles.push_back(scheduler.scheduleAt(&runnables[i], at));
+        listTasks[i].scheduledUptimeMicros = (uint64_t)at * 1000;
+        list.insert(&listTasks[i]);
+    }
+
+    uint32_t heapMisses = 0;
+    uint32_t listMisses = 0;
+    Result result;
+    result.heapNanos = nanosPerOperation([&](uint32_t i)
+    {
+        heapMisses += !scheduler.cancel(scheduler.scheduleAt(&runnables[taskCount], times[i]));
+    });
+    result.listNanos = nanosPerOperation([&](uint32_t i)
+    {
+        SortedList::Task &task = listTasks[taskCount];
+        task.scheduledUptimeMicros = (uint64_t)times[i] * 1000;
+        list.insert(&task);
+        listMisses += !list.remove(&task);
+    });
+
+    TEST_ASSERT_EQUAL_UINT32(0, heapMisses);
+    TEST_ASSERT_EQUAL_UINT32(0, listMisses);
+    for (TaskHandle &handle : handles)
+        TEST_ASSERT_TRUE(scheduler.cancel(handle));
+    return result;
+}
+
+static void report(const char *name, uint32_t taskCount, const Result &result)
+{
+    char line[96];
+    snprintf(line, sizeof(line), "%s of %u tasks: heap %.0f ns, list %.0f ns",
+             name, (unsigned)taskCount, result.heapNanos, result.listNanos);
+    TEST_MESSAGE(line);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getQueuedTaskCount());
+}
+
+static void testRescheduleScalesWithLogN()
+{
+    Result largest{};
+    for (uint32_t taskCount : {10, 100, 1000})
+    {
+        largest = benchmarkReschedule(taskCount);
+        report("reschedule", taskCount, largest);
+    }
+    // The list walks about half of the 1000 tasks twice, the heap about 10 levels
+    TEST_ASSERT_TRUE_MESSAGE(largest.heapNanos < largest.listNanos, "heap slower than the list at 1000 tasks");
+}
+
+static void testInsertCancelScalesWithLogN()
+{
+    Result largest{};
+    for (uint32_t taskCount : {10, 100, 1000})
+    {
+        largest = benchmarkInsertCancel(taskCount);
+        report("insert and cancel", taskCount, largest);
+    }
+    TEST_ASSERT_TRUE_MESSAGE(largest.heapNanos < largest.listNanos, "heap slower than the list at 1000 tasks");
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(testRescheduleScalesWithLogN);
+    RUN_TEST(testInsertCancelScalesWithLogN);
+    return UNITY_END();
+}
\ No newline at end of file